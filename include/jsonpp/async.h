@@ -0,0 +1,273 @@
+#pragma once
+
+#include <string>
+#include <limits>
+#ifdef _MSC_VER
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+#include <jsonpp/var.h>
+#include <jsonpp/reader.h>
+#include <jsonpp/parser.h>
+
+namespace json
+{
+	/*
+	 * a parser for input that arrives in pieces, which does a bounded amount
+	 * of work per call so an event loop can interleave a large document with
+	 * other work. feed() hands over what arrived, resume() builds as much of
+	 * the document as the input and its budget allow and tells whether it
+	 * needs input, ran out of budget or is done; finish() says no more input
+	 * will come. The tokens are those of basic_reader, which only ever gets
+	 * to see complete tokens, and they are built by the same code as
+	 * basic_parser's, so the result is what parse() gives for all of the
+	 * input at once. A token that has not ended yet is kept until it has,
+	 * what was read is dropped from the buffer as the parse goes on.
+	 *
+	 *	json::async_parser parser;
+	 *	parser.feed( data, size );	// whenever data arrives
+	 *	while ( parser.resume( 10000 ) == json::async_parser::Suspended ) yield();
+	 */
+	template < template< class > class CopyBehaviour, class Char, class Options = parse_options::passthrough >
+	class basic_async_parser
+	{
+		public:
+
+			typedef std::basic_string< Char > string_type;
+
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			typedef basic_reader< Char, const Char* > reader_type;
+
+			enum State
+			{
+				/* all input given so far is used, feed more or finish */
+				NeedInput,
+				/* the budget of this resume is used up */
+				Suspended,
+				/* the document is complete, see result() */
+				Complete
+			};
+
+			explicit basic_async_parser( Options options = Options(), const parse_limits &limits = parse_limits() ) :
+				_options( options ),
+				_limits( limits ),
+				_parser(),
+				_reader(),
+				_document(),
+				_input(),
+				_read( 0 ),
+				_scanned( 0 ),
+				_complete( 0 ),
+				_lexeme( Between ),
+				_quote( 0 ),
+				_finished( false ),
+				_state( NeedInput )
+			{
+				restart();
+			}
+
+			/* keep numbers as their source text, see basic_var::raw_number */
+			void raw_numbers( bool keep )
+			{
+				_parser.raw_numbers( keep );
+			}
+
+			/* appends input, nothing is parsed until resume() */
+			void feed( const Char *start, size_t count )
+			{
+				if ( _finished ) throw exception( "input fed after finish()" );
+
+				if ( _read && _read >= _input.size() / 2 )
+				{
+					_input.erase( 0, _read );
+					_scanned -= _read;
+					_complete -= _read;
+					_read = 0;
+				}
+
+				_input.append( start, count );
+				scan();
+			}
+
+			void feed( const string_type &input )
+			{
+				feed( input.data(), input.size() );
+			}
+
+			/* no more input will come, what is left is parsed as the end of the document */
+			void finish()
+			{
+				_finished = true;
+			}
+
+			/*
+			 * reads at most tokens tokens and characters characters, a token is
+			 * not cut short though. Returns Complete once the document is, from
+			 * then on result() holds it and resume() does nothing more.
+			 */
+			State resume( size_t tokens = std::numeric_limits< size_t >::max(), size_t characters = std::numeric_limits< size_t >::max() )
+			{
+				if ( _state == Complete ) return _state;
+
+				const Char *base = _input.data();
+				const Char *available = base + ( _finished ? _input.size() : _complete );
+				_reader->range( base + _read, available );
+
+				const size_t offset = _reader->offset();
+				_state = Suspended;
+
+				for ( size_t used = 0; ; ++used )
+				{
+					if ( !_finished && !_reader->done() && _reader->position() == available )
+					{
+						_state = NeedInput;
+						break;
+					}
+
+					if ( used >= tokens || _reader->offset() - offset >= characters ) break;
+
+					if ( _parser.consume( _document, *_reader, _reader->next(), _options ) )
+					{
+						_state = Complete;
+						break;
+					}
+				}
+
+				_read = static_cast< size_t >( _reader->position() - base );
+				return _state;
+			}
+
+			State state() const
+			{
+				return _state;
+			}
+
+			/* the document, complete once resume() returned Complete */
+			const var_type& result() const
+			{
+				return _document;
+			}
+
+			var_type& result()
+			{
+				return _document;
+			}
+
+			/* characters of the current document read so far */
+			size_t offset() const
+			{
+				return _reader->offset();
+			}
+
+			/*
+			 * starts on the next document, in what is left of the input after
+			 * the one that is complete, as with newline delimited JSON
+			 */
+			void restart()
+			{
+				_reader.reset( new reader_type( _input.data() + _read, _input.data() + _read, _limits ) );
+				_parser.begin( _document );
+				_state = NeedInput;
+			}
+
+		private:
+
+			enum Lexeme
+			{
+				Between,
+				Quoted,
+				QuotedEscape,
+				Unquoted,
+				UnquotedEscape
+			};
+
+			basic_async_parser( const basic_async_parser& );
+			basic_async_parser& operator = ( const basic_async_parser& );
+
+			/*
+			 * finds where the last complete token in the input ends, following
+			 * basic_reader's grammar: quoted strings end at their quote, unquoted
+			 * ones and numbers only at the ',', ':', '}' or ']' after them
+			 */
+			void scan()
+			{
+				for ( ; _scanned < _input.size(); ++_scanned )
+				{
+					const Char c = _input[ _scanned ];
+
+					switch ( _lexeme )
+					{
+						case Between:
+							switch ( c )
+							{
+								case '{': case '}': case '[': case ']':
+									_complete = _scanned + 1;
+									break;
+								case ',': case ':':
+								case ' ': case '\t': case '\r': case '\n':
+									break;
+								case '"': case '\'':
+									_lexeme = Quoted;
+									_quote = c;
+									break;
+								case '\\':
+									_lexeme = UnquotedEscape;
+									break;
+								default:
+									_lexeme = Unquoted;
+									break;
+							}
+							break;
+						case Quoted:
+							if ( c == '\\' ) _lexeme = QuotedEscape;
+							else if ( c == _quote )
+							{
+								_lexeme = Between;
+								_complete = _scanned + 1;
+							}
+							break;
+						case QuotedEscape:
+							_lexeme = Quoted;
+							break;
+						case Unquoted:
+							switch ( c )
+							{
+								case '}': case ']':
+									_lexeme = Between;
+									_complete = _scanned + 1;
+									break;
+								case ',': case ':':
+									_lexeme = Between;
+									_complete = _scanned;
+									break;
+								case '\\':
+									_lexeme = UnquotedEscape;
+									break;
+							}
+							break;
+						case UnquotedEscape:
+							_lexeme = Unquoted;
+							break;
+					}
+				}
+			}
+
+			Options _options;
+			parse_limits _limits;
+			basic_parser< CopyBehaviour, Char > _parser;
+			std::tr1::shared_ptr< reader_type > _reader;
+			var_type _document;
+			string_type _input;
+			size_t _read, _scanned, _complete;
+			Lexeme _lexeme;
+			Char _quote;
+			bool _finished;
+			State _state;
+	};
+
+	typedef basic_async_parser< CopyOnWrite, char > async_parser;
+	typedef basic_async_parser< CopyOnWrite, wchar_t > wasync_parser;
+}
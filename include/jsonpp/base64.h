@@ -1,6 +1,9 @@
 #pragma once
 
-#include <jsonpp/var.h>
+#include <vector>
+#include <string>
+
+#include <jsonpp/sink.h>
 
 namespace json
 {
@@ -38,32 +41,61 @@ namespace json
 
 			static string_type encode( const char *start, size_t count )
 			{
-				string_type result = block_encode( start, count );
+				string_type result;
+				result.reserve( encoded_size( count ) );
 
-				count %= 3;
+				string_sink< string_type > sink( result );
+				encode( start, count, sink );
 
-				if ( count )
+				return result;
+			}
+
+			/*
+			 * writes the base64 of [ start, start + count ) to sink, see sink.h, a
+			 * block at a time. Byte is any character type holding one byte each.
+			 */
+			template < class Byte, class Sink >
+			static void encode( const Byte *start, size_t count, Sink &sink )
+			{
+				const Byte *input = start;
+
+				Char block[ 256 ];
+				size_t used = 0;
+
+				for ( ; count >= 3; count -= 3, input += 3 )
 				{
-					char buf[] = { 0, 0, 0 };
+					const unsigned int triple = ( byte( input[ 0 ] ) << 16 ) | ( byte( input[ 1 ] ) << 8 ) | byte( input[ 2 ] );
 
-					for ( unsigned int i = 0; i < count; ++i )
+					block[ used ] = b64e( ( triple >> 18 ) & 0x3F );
+					block[ used + 1 ] = b64e( ( triple >> 12 ) & 0x3F );
+					block[ used + 2 ] = b64e( ( triple >> 6 ) & 0x3F );
+					block[ used + 3 ] = b64e( triple & 0x3F );
+					used += 4;
+
+					if ( used == sizeof( block ) / sizeof( Char ) )
 					{
-						buf[ i ] = *start;
-						++start;
+						sink.append( block, used );
+						used = 0;
 					}
+				}
 
-					start = buf;
-					result.append( block_encode( start, 3 ) );
+				if ( count )
+				{
+					const unsigned int triple = ( byte( input[ 0 ] ) << 16 ) | ( count == 2 ? byte( input[ 1 ] ) << 8 : 0 );
 
-					count = 3 - count;
-					while ( count )
-					{
-						result[ result.size() - count ] = '=';
-						--count;
-					}
+					block[ used ] = b64e( ( triple >> 18 ) & 0x3F );
+					block[ used + 1 ] = b64e( ( triple >> 12 ) & 0x3F );
+					block[ used + 2 ] = count == 2 ? b64e( ( triple >> 6 ) & 0x3F ) : '=';
+					block[ used + 3 ] = '=';
+					used += 4;
 				}
 
-				return result;
+				if ( used ) sink.append( block, used );
+			}
+
+			static size_t encoded_size( size_t count )
+			{
+				return ( count + 2 ) / 3 * 4;
 			}
 
 		private:
@@ -102,46 +134,6 @@ namespace json
 				return result;
 			}
 
-			static string_type block_encode( const char *&start, size_t count )
-			{
-				string_type result( count * 4 / 3, 0 );
-
-				typename string_type::iterator output = result.begin();
-
-				unsigned char buf = 0;
-				while ( count > 2 )
-				{
-					buf = ( *start >> 2 ) & 0x3F;
-					// 0 0 1 2 3 4 5 6
-					*output++ = b64e( buf );
-
-					buf = ( *start & 0x03 ) << 4;
-					// 0 0 7 8 _ _ _ _
-					++start;
-					buf |= ( *start >> 4 ) & 0x0F;
-					// 0 0 7 8 1 2 3 4
-					*output++ = b64e( buf );
-
-					buf = ( *start & 0x0F ) << 2;
-					// 0 0 5 6 7 8 _ _
-					++start;
-					buf |= ( *start >> 6 ) & 0x03;
-					// 0 0 5 6 7 8 1 2
-					*output++ = b64e( buf );
-
-					buf = *start & 0x3F;
-					// 0 0 3 4 5 6 7 8
-					*output++ = b64e( buf );
-					++start;
-
-					count -= 3;
-				}
-
-				result.erase( output, result.end() );
-
-				return result;
-			}
-
 			static std::vector< char > block_decode( typename string_type::const_iterator &start, const typename string_type::const_iterator &end )
 			{
 				std::vector< char > result( ( end - start ) * 3 / 4, 0 );
@@ -189,6 +181,12 @@ namespace json
 				return result;
 			}
 
+			template < class Byte >
+			static unsigned int byte( Byte c )
+			{
+				return static_cast< unsigned char >( c );
+			}
+
 			inline static char b64e( unsigned char c )
 			{
 				static const char *chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -1,45 +1,673 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <limits>
+#include <cmath>
+#ifdef _MSC_VER
+#include <memory>
+#include <type_traits>
+#else
+#include <tr1/memory>
+#include <tr1/type_traits>
+#endif
 
 #include <jsonpp/misc.h>
+#include <jsonpp/key.h>
+#include <jsonpp/register_type.h>
+#include <jsonpp/pool.h>
 
 namespace json
 {
 	template < template< class > class CopyBehaviour, class T >
 	struct basic_var;
 
+	/* parses the text of a fragment, defined in parser.h */
+	template < template< class > class CopyBehaviour, class T >
+	void parse_fragment( const std::basic_string< T > &text, basic_var< CopyBehaviour, T > &result );
+
+	/*
+	 * column wise layout of an array of objects that all have the same members
+	 * in the same order: the first record, whose member names every record
+	 * shares, and one Array per member holding that member of every record
+	 */
+	template < template< class > class CopyBehaviour, class T >
+	struct basic_columns
+	{
+		basic_columns() :
+			size( 0 ),
+			prototype(),
+			columns() { }
+
+		size_t size;
+		basic_var< CopyBehaviour, T > prototype;
+		std::vector< basic_var< CopyBehaviour, T > > columns;
+	};
+
+	/*
+	 * numbers of an array that holds nothing else, kept as int64 while they
+	 * are all integral and as double once one is not. A number that neither
+	 * represents exactly is refused and the array falls back to var elements.
+	 */
+	struct packed_numbers
+	{
+		packed_numbers() :
+			integers(),
+			doubles() { }
+
+		bool add( long double number )
+		{
+			if ( doubles.empty() && integral( number ) )
+			{
+				integers.push_back( static_cast< long long >( number ) );
+				return true;
+			}
+
+			const double value = static_cast< double >( number );
+			if ( static_cast< long double >( value ) != number ) return false;
+
+			if ( !integers.empty() )
+			{
+				const long long exact = 1LL << std::numeric_limits< double >::digits;
+
+				for ( std::vector< long long >::const_iterator i = integers.begin(); i != integers.end(); ++i )
+				{
+					if ( *i > exact || *i < -exact ) return false;
+				}
+
+				doubles.assign( integers.begin(), integers.end() );
+				std::vector< long long >().swap( integers );
+			}
+
+			doubles.push_back( value );
+			return true;
+		}
+
+		bool add( long long number )
+		{
+			if ( doubles.empty() )
+			{
+				integers.push_back( number );
+				return true;
+			}
+
+			const long long exact = 1LL << std::numeric_limits< double >::digits;
+			if ( number > exact || number < -exact ) return false;
+
+			doubles.push_back( static_cast< double >( number ) );
+			return true;
+		}
+
+		size_t size() const
+		{
+			return doubles.empty() ? integers.size() : doubles.size();
+		}
+
+		long double operator[]( size_t index ) const
+		{
+			return doubles.empty() ? static_cast< long double >( integers[ index ] ) : static_cast< long double >( doubles[ index ] );
+		}
+
+		/* -0 is left to the doubles so its sign survives */
+		static bool integral( long double number )
+		{
+			const long double limit = 9223372036854775808.0L;
+
+			return std::floor( number ) == number && -limit <= number && number < limit && ( number != 0 || 1 / number > 0 );
+		}
+
+		std::vector< long long > integers;
+		std::vector< double > doubles;
+	};
+
+	/*
+	 * the serialized text of a container for one markup and indent level:
+	 * pieces of text, each followed by the form of a container element when
+	 * there is one, so a container that changed is written again without
+	 * writing the elements that didn't
+	 */
+	template < class Char >
+	struct serialized_form
+	{
+		struct piece
+		{
+			piece() :
+				text(),
+				nested() { }
+
+			std::basic_string< Char > text;
+			std::tr1::shared_ptr< const serialized_form > nested;
+		};
+
+		serialized_form( unsigned int m, unsigned int l ) :
+			markup( m ),
+			level( l ),
+			pieces( 1 ) { }
+
+		unsigned int markup;
+		unsigned int level;
+		std::vector< piece > pieces;
+	};
+
+	/* versions of basic_var_data, unique for the life of the program */
+	inline long next_version()
+	{
+		static volatile long last = 0;
+		return atomic_increment( &last );
+	}
+
+	template < bool Signed > struct widest_integer { typedef long long type; };
+
+	template <> struct widest_integer< false > { typedef unsigned long long type; };
+
 	template < template< class > class CopyBehaviour, class T >
 	struct basic_var_data
 	{
+		/*
+		 * how a Number is held: _number always has the value as a long double,
+		 * integers also keep their exact value in _integer. Text is a number
+		 * kept as its source in _string, converted on every read, see number().
+		 */
+		enum NumberFormat
+		{
+			Floating,
+			Signed,
+			Unsigned,
+			Text
+		};
+
 		typedef std::basic_string< T > string_type;
 
-		typedef key_value< string_type, basic_var< CopyBehaviour, T > > value_type;
+		typedef basic_key< T > key_type;
 
-		typedef std::vector< value_type > array_type;
+		typedef key_value< key_type, basic_var< CopyBehaviour, T > > value_type;
+
+		typedef std::vector< value_type, typename behaviour_allocator< CopyBehaviour, value_type >::type > array_type;
+
+		typedef basic_columns< CopyBehaviour, T > columns_type;
 
 		basic_var_data() :
 			_string(),
 			_number( std::numeric_limits< long double >::quiet_NaN() ),
-			_array() { }
+			_integer( 0 ),
+			_format( Floating ),
+			_raw( false ),
+			_fragment( false ),
+			_binary( false ),
+			_lent( false ),
+			_array(),
+			_columns(),
+			_numbers(),
+			_expanded( 0 ),
+			_version( 0 ),
+			_caching( 0 ),
+			_hash( 0 ),
+			_hash_check( 0 ),
+			_hashed( false ),
+			_serialized(),
+			_form_check( 0 ) { }
 
 		basic_var_data( const string_type &s, long double n ) :
 			_string( s ),
 			_number( n ),
-			_array() { }
+			_integer( 0 ),
+			_format( Floating ),
+			_raw( false ),
+			_fragment( false ),
+			_binary( false ),
+			_lent( false ),
+			_array(),
+			_columns(),
+			_numbers(),
+			_expanded( 0 ),
+			_version( 0 ),
+			_caching( 0 ),
+			_hash( 0 ),
+			_hash_check( 0 ),
+			_hashed( false ),
+			_serialized(),
+			_form_check( 0 ) { }
 
 		basic_var_data( const string_type &s ) :
 			_string( s ),
 			_number( std::numeric_limits< long double >::quiet_NaN() ),
-			_array() { }
+			_integer( 0 ),
+			_format( Floating ),
+			_raw( false ),
+			_fragment( false ),
+			_binary( false ),
+			_lent( false ),
+			_array(),
+			_columns(),
+			_numbers(),
+			_expanded( 0 ),
+			_version( 0 ),
+			_caching( 0 ),
+			_hash( 0 ),
+			_hash_check( 0 ),
+			_hashed( false ),
+			_serialized(),
+			_form_check( 0 ) { }
 
 		basic_var_data( long double n ) :
 			_string(),
 			_number( n ),
-			_array() { }
+			_integer( 0 ),
+			_format( Floating ),
+			_raw( false ),
+			_fragment( false ),
+			_binary( false ),
+			_lent( false ),
+			_array(),
+			_columns(),
+			_numbers(),
+			_expanded( 0 ),
+			_version( 0 ),
+			_caching( 0 ),
+			_hash( 0 ),
+			_hash_check( 0 ),
+			_hashed( false ),
+			_serialized(),
+			_form_check( 0 ) { }
+
+		template < class N >
+		basic_var_data( N n, typename enable_if< std::tr1::is_integral< N >::value >::type* = 0 ) :
+			_string(),
+			_number( 0 ),
+			_integer( 0 ),
+			_format( Signed ),
+			_raw( false ),
+			_fragment( false ),
+			_binary( false ),
+			_lent( false ),
+			_array(),
+			_columns(),
+			_numbers(),
+			_expanded( 0 ),
+			_version( 0 ),
+			_caching( 0 ),
+			_hash( 0 ),
+			_hash_check( 0 ),
+			_hashed( false ),
+			_serialized(),
+			_form_check( 0 )
+		{
+			integer( static_cast< typename widest_integer< std::tr1::is_signed< N >::value >::type >( n ) );
+		}
+
+		/*
+		 * a copy only takes the value: the caches of rhs may be filled by other
+		 * threads meanwhile, and its elements are new, so none of them are lent
+		 */
+		basic_var_data( const basic_var_data &rhs ) :
+			_string( rhs._string ),
+			_number( rhs._number ),
+			_integer( rhs._integer ),
+			_format( rhs._format ),
+			_raw( rhs._raw ),
+			_fragment( rhs._fragment ),
+			_binary( rhs._binary ),
+			_lent( false ),
+			_array( rhs._array ),
+			_columns( rhs._columns ),
+			_numbers( rhs._numbers ),
+			_expanded( 0 ),
+			_version( 0 ),
+			_caching( 0 ),
+			_hash( 0 ),
+			_hash_check( 0 ),
+			_hashed( false ),
+			_serialized(),
+			_form_check( 0 ) { }
+
+		basic_var_data& operator = ( const basic_var_data &rhs )
+		{
+			if ( this == &rhs ) return *this;
+
+			_string = rhs._string;
+			_number = rhs._number;
+			_integer = rhs._integer;
+			_format = rhs._format;
+			_raw = rhs._raw;
+			_fragment = rhs._fragment;
+			_binary = rhs._binary;
+			_lent = false;
+			_array = rhs._array;
+			_columns = rhs._columns;
+			_numbers = rhs._numbers;
+			invalidate();
+
+			return *this;
+		}
+
+		~basic_var_data()
+		{
+			drop_expanded();
+		}
+
+		/* an Array or Object that keeps its source text, see elements() */
+		static basic_var_data fragment( const string_type &source )
+		{
+			basic_var_data result( source );
+			result._fragment = true;
+			return result;
+		}
+
+		/* a String of count bytes, kept one per character and written as base64 */
+		static basic_var_data bytes( const char *start, size_t count )
+		{
+			basic_var_data result( string_type( reinterpret_cast< const unsigned char* >( start ), reinterpret_cast< const unsigned char* >( start ) + count ) );
+			result._binary = true;
+			return result;
+		}
+
+		/* a number that keeps its source text, see number() */
+		static basic_var_data text( const string_type &source )
+		{
+			basic_var_data result( source );
+			result._format = Text;
+			result._raw = true;
+			return result;
+		}
+
+		void integer( long long n )
+		{
+			_number = static_cast< long double >( n );
+			_integer = static_cast< unsigned long long >( n );
+			_format = Signed;
+		}
+
+		void integer( unsigned long long n )
+		{
+			if ( n <= static_cast< unsigned long long >( std::numeric_limits< long long >::max() ) )
+			{
+				integer( static_cast< long long >( n ) );
+				return;
+			}
+
+			_number = static_cast< long double >( n );
+			_integer = n;
+			_format = Unsigned;
+		}
+
+		/* the value of a Number as number() reads it, never Text */
+		struct number_value
+		{
+			long double number;
+			unsigned long long integer;
+			NumberFormat format;
+		};
+
+		/*
+		 * reads a Text number from its source on every call, so sharing it
+		 * between threads is safe; integers that fit 64 bits stay exact
+		 */
+		number_value number() const
+		{
+			number_value result = { _number, _integer, _format };
+
+			if ( _format != Text ) return result;
+
+			bool negative = false;
+			unsigned long long magnitude = 0;
+			long long value = 0;
+
+			if ( parse_integer( _string.begin(), _string.end(), negative, magnitude ) && ( !negative || negate_integer( magnitude, value ) ) )
+			{
+				if ( !negative && magnitude > static_cast< unsigned long long >( std::numeric_limits< long long >::max() ) )
+				{
+					result.number = static_cast< long double >( magnitude );
+					result.integer = magnitude;
+					result.format = Unsigned;
+					return result;
+				}
+
+				if ( !negative ) value = static_cast< long long >( magnitude );
+
+				result.number = static_cast< long double >( value );
+				result.integer = static_cast< unsigned long long >( value );
+				result.format = Signed;
+				return result;
+			}
+
+			result.number = dec_string_to_number< string_type, long double >( _string.begin(), _string.end() );
+			result.format = Floating;
+			return result;
+		}
+
+		/* called on every write access, drops everything cached about the value */
+		void invalidate()
+		{
+			_version = 0;
+			_hashed = false;
+			if ( _serialized ) _serialized.reset();
+			drop_expanded();
+		}
+
+		/*
+		 * a number that no other data has, nor this one before its last write:
+		 * equal versions mean the same unchanged value. Given out on first use.
+		 */
+		long version() const
+		{
+			if ( const long result = atomic_load( &_version ) ) return result;
+
+			const long result = next_version();
+			return atomic_publish( &_version, result ) ? result : atomic_load( &_version );
+		}
+
+		/* hash and check stored by cache_hash(), false when there are none or another thread is storing them */
+		bool cached_hash( size_t &hash, size_t &check ) const
+		{
+			if ( !atomic_try_lock( &_caching ) ) return false;
+
+			const bool found = _hashed;
+			hash = _hash;
+			check = _hash_check;
+			atomic_unlock( &_caching );
+
+			return found;
+		}
+
+		/* check tells what the elements looked like, see basic_var::lent_check() */
+		void cache_hash( size_t hash, size_t check ) const
+		{
+			if ( !atomic_try_lock( &_caching ) ) return;
+
+			_hash = hash;
+			_hash_check = check;
+			_hashed = true;
+			atomic_unlock( &_caching );
+		}
+
+		std::tr1::shared_ptr< const serialized_form< T > > cached_form( size_t &check ) const
+		{
+			std::tr1::shared_ptr< const serialized_form< T > > result;
+			if ( !atomic_try_lock( &_caching ) ) return result;
+
+			result = _serialized;
+			check = _form_check;
+			atomic_unlock( &_caching );
+
+			return result;
+		}
+
+		void cache_form( const std::tr1::shared_ptr< const serialized_form< T > > &form, size_t check ) const
+		{
+			/* the form this replaces is released after unlocking */
+			std::tr1::shared_ptr< const serialized_form< T > > replaced( form );
+			if ( !atomic_try_lock( &_caching ) ) return;
+
+			_serialized.swap( replaced );
+			_form_check = check;
+			atomic_unlock( &_caching );
+		}
+
+		/* true while the elements only exist in a packed layout */
+		bool packed() const
+		{
+			return ( _columns || _numbers ) && _array.empty();
+		}
+
+		size_t size() const
+		{
+			if ( _fragment ) return elements().size();
+
+			if ( !packed() ) return _array.size();
+
+			return _columns ? _columns->size : _numbers->size();
+		}
+
+		/*
+		 * the elements for const readers: _array, or for a fragment or a packed
+		 * layout a list built on first use and kept until the next write. Threads
+		 * reading the same value may race to build it, the first one wins.
+		 */
+		const array_type& elements() const
+		{
+			if ( !_fragment && !packed() ) return _array;
+
+			if ( const array_type *list = atomic_load( &_expanded ) ) return *list;
+
+			array_type *list = new array_type();
+			expand( *list );
+
+			if ( !atomic_publish( &_expanded, list ) )
+			{
+				delete list;
+				list = atomic_load( &_expanded );
+			}
+
+			return *list;
+		}
+
+		/* turns a fragment or packed layout into plain elements for writing */
+		void unpack()
+		{
+			if ( !_fragment && !packed() ) return;
+
+			array_type array;
+			expand( array );
+			_array.swap( array );
+
+			if ( _fragment )
+			{
+				_string.clear();
+				_fragment = false;
+			}
+			_columns.reset();
+			_numbers.reset();
+		}
+
+		void clear_elements()
+		{
+			if ( _fragment )
+			{
+				_string.clear();
+				_fragment = false;
+			}
+			_array.clear();
+			_columns.reset();
+			_numbers.reset();
+			_lent = false;
+		}
+
+		/* like clear_elements, but keeps the storage of packed numbers that no one else uses */
+		void empty_elements()
+		{
+			if ( !_numbers || !_numbers.unique() )
+			{
+				clear_elements();
+				return;
+			}
+
+			_array.clear();
+			_columns.reset();
+			_lent = false;
+			_numbers->integers.clear();
+			_numbers->doubles.clear();
+		}
+
+		/* row of a columnar array as an Object, its members taken from the columns */
+		basic_var< CopyBehaviour, T > record( size_t row ) const
+		{
+			const basic_var< CopyBehaviour, T > &prototype = _columns->prototype;
+			basic_var< CopyBehaviour, T > result( Object );
+
+			typename std::vector< basic_var< CopyBehaviour, T > >::const_iterator column = _columns->columns.begin();
+			for ( typename array_type::const_iterator i = prototype.begin(); i != prototype.end(); ++i, ++column )
+			{
+				result.push_member( i->key, ( *column )[ static_cast< unsigned int >( row ) ] );
+			}
+
+			return result;
+		}
+
+		/* builds the elements of a fragment or a packed layout into array, leaving this as it is */
+		void expand( array_type &array ) const
+		{
+			if ( _fragment )
+			{
+				basic_var< CopyBehaviour, T > parsed;
+				parse_fragment( _string, parsed );
+
+				const basic_var< CopyBehaviour, T > &elements = parsed;
+				array.assign( elements.begin(), elements.end() );
+				return;
+			}
+
+			if ( _numbers )
+			{
+				array.reserve( _numbers->size() );
+
+				for ( size_t i = 0; i < _numbers->integers.size(); ++i )
+				{
+					array.push_back( value_type( basic_var< CopyBehaviour, T >( _numbers->integers[ i ] ) ) );
+				}
+
+				for ( size_t i = 0; i < _numbers->doubles.size(); ++i )
+				{
+					array.push_back( value_type( basic_var< CopyBehaviour, T >( _numbers->doubles[ i ] ) ) );
+				}
+
+				return;
+			}
+
+			array.reserve( _columns->size );
+
+			for ( size_t row = 0; row < _columns->size; ++row )
+			{
+				array.push_back( value_type( record( row ) ) );
+			}
+		}
+
+		void drop_expanded()
+		{
+			delete _expanded;
+			_expanded = 0;
+		}
 
 		string_type _string;
 		long double _number;
+		unsigned long long _integer;
+		NumberFormat _format;
+		bool _raw;
+		bool _fragment;
+		bool _binary;
+		/* elements were handed out for writing, a write through one of them doesn't drop the caches of this container */
+		bool _lent;
 		array_type _array;
+		std::tr1::shared_ptr< const columns_type > _columns;
+		std::tr1::shared_ptr< packed_numbers > _numbers;
+		/* the elements built for const readers of a fragment or packed layout, see elements() */
+		mutable array_type *volatile _expanded;
+
+		mutable volatile long _version;
+		/* held while the caches below are read or stored, const readers on several threads fill them */
+		mutable volatile long _caching;
+		mutable size_t _hash, _hash_check;
+		mutable bool _hashed;
+		mutable std::tr1::shared_ptr< const serialized_form< T > > _serialized;
+		mutable size_t _form_check;
 	};
 }
@@ -0,0 +1,356 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include <jsonpp/var.h>
+#include <jsonpp/sink.h>
+
+namespace json
+{
+	/* collects output in a fixed buffer and hands it to hasher.update( data, size ) in blocks */
+	template < class Hasher >
+	class hash_sink
+	{
+		public:
+
+			explicit hash_sink( Hasher &hasher ) :
+				_hasher( hasher ),
+				_used( 0 ) { }
+
+			~hash_sink()
+			{
+				flush();
+			}
+
+			void push_back( char c )
+			{
+				if ( _used == sizeof( _buffer ) ) flush();
+				_buffer[ _used++ ] = c;
+			}
+
+			void append( const char *start, size_t count )
+			{
+				if ( count > sizeof( _buffer ) - _used )
+				{
+					flush();
+					if ( count >= sizeof( _buffer ) )
+					{
+						_hasher.update( start, count );
+						return;
+					}
+				}
+
+				std::copy( start, start + count, _buffer + _used );
+				_used += count;
+			}
+
+			void flush()
+			{
+				if ( _used ) _hasher.update( _buffer, _used );
+				_used = 0;
+			}
+
+		private:
+
+			hash_sink( const hash_sink& );
+			hash_sink& operator = ( const hash_sink& );
+
+			Hasher &_hasher;
+			char _buffer[ 4096 ];
+			size_t _used;
+	};
+
+	/* 64 bit FNV-1a, plug in a cryptographic hash with the same interface for signing */
+	class fnv1a_hasher
+	{
+		public:
+
+			fnv1a_hasher() :
+				_hash( 14695981039346656037ULL ) { }
+
+			void update( const char *start, size_t count )
+			{
+				for ( const char *end = start + count; start != end; ++start )
+				{
+					_hash ^= static_cast< unsigned char >( *start );
+					_hash *= 1099511628211ULL;
+				}
+			}
+
+			unsigned long long value() const { return _hash; }
+
+		private:
+
+			unsigned long long _hash;
+	};
+
+	/*
+	 * RFC 8785 JSON canonicalization: members sorted by their UTF-16 code
+	 * units, numbers in the shortest form that round trips through a double,
+	 * formatted like ECMAScript's Number.prototype.toString, and only '"',
+	 * '\\' and control characters escaped. Strings are expected to hold UTF-8.
+	 */
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_canonical
+	{
+		public:
+
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			typedef typename var_type::value_type member_type;
+
+			typedef std::basic_string< Char > string_type;
+
+			template < class Sink >
+			static void write( const var_type &value, Sink &sink )
+			{
+				switch ( value.type )
+				{
+					case Null:
+					case Undefined:
+					case TypeCount:
+						literal( sink, "null" );
+						break;
+					case Bool:
+						literal( sink, value.toBool() ? "true" : "false" );
+						break;
+					case Number:
+						number( sink, static_cast< double >( value.toNumber() ) );
+						break;
+					case String:
+						string( sink, value.toString() );
+						break;
+					case Array:
+						sink.push_back( '[' );
+						for ( typename var_type::const_iterator i = value.begin(); i != value.end(); ++i )
+						{
+							if ( i != value.begin() ) sink.push_back( ',' );
+							write( i->value, sink );
+						}
+						sink.push_back( ']' );
+						break;
+					case Object:
+					{
+						std::vector< const member_type* > members;
+						members.reserve( value.size() );
+						for ( typename var_type::const_iterator i = value.begin(); i != value.end(); ++i ) members.push_back( &*i );
+						std::sort( members.begin(), members.end(), utf16_less );
+
+						sink.push_back( '{' );
+						for ( typename std::vector< const member_type* >::const_iterator i = members.begin(); i != members.end(); ++i )
+						{
+							if ( i != members.begin() ) sink.push_back( ',' );
+							string( sink, ( *i )->key.begin(), ( *i )->key.end() );
+							sink.push_back( ':' );
+							write( ( *i )->value, sink );
+						}
+						sink.push_back( '}' );
+						break;
+					}
+				}
+			}
+
+			template < class Sink >
+			static void number( Sink &sink, double value )
+			{
+				if ( value != value || value - value != 0 ) throw exception( "no canonical representation for" ) << value;
+
+				if ( value == 0 )
+				{
+					sink.push_back( '0' );
+					return;
+				}
+
+				char buffer[ 32 ];
+
+				if ( std::floor( value ) == value && std::fabs( value ) < 9007199254740992.0 )
+				{
+					literal( sink, buffer, std::sprintf( buffer, "%.0f", value ) );
+					return;
+				}
+
+				/* a precision that round trips stays round tripping when increased, so search for the smallest */
+				int low = 1, high = 17;
+				while ( low < high )
+				{
+					const int middle = ( low + high ) / 2;
+					std::sprintf( buffer, "%.*e", middle - 1, value );
+					if ( std::strtod( buffer, 0 ) == value )
+					{
+						high = middle;
+					}
+					else
+					{
+						low = middle + 1;
+					}
+				}
+				std::sprintf( buffer, "%.*e", low - 1, value );
+
+				const char *p = buffer;
+				if ( *p == '-' )
+				{
+					sink.push_back( '-' );
+					++p;
+				}
+
+				char digits[ 20 ];
+				int count = 0;
+				for ( ; *p != 'e'; ++p )
+				{
+					if ( *p != '.' ) digits[ count++ ] = *p;
+				}
+				while ( count > 1 && digits[ count - 1 ] == '0' ) --count;
+
+				/* value is 0.digits * 10^point */
+				const int point = std::atoi( p + 1 ) + 1;
+
+				if ( count <= point && point <= 21 )
+				{
+					literal( sink, digits, count );
+					for ( int i = count; i < point; ++i ) sink.push_back( '0' );
+				}
+				else if ( 0 < point && point <= 21 )
+				{
+					literal( sink, digits, point );
+					sink.push_back( '.' );
+					literal( sink, digits + point, count - point );
+				}
+				else if ( -6 < point && point <= 0 )
+				{
+					sink.push_back( '0' );
+					sink.push_back( '.' );
+					for ( int i = point; i < 0; ++i ) sink.push_back( '0' );
+					literal( sink, digits, count );
+				}
+				else
+				{
+					sink.push_back( digits[ 0 ] );
+					if ( count > 1 )
+					{
+						sink.push_back( '.' );
+						literal( sink, digits + 1, count - 1 );
+					}
+					sink.push_back( 'e' );
+					sink.push_back( point > 0 ? '+' : '-' );
+					literal( sink, buffer, std::sprintf( buffer, "%d", std::abs( point - 1 ) ) );
+				}
+			}
+
+			template < class Sink >
+			static void string( Sink &sink, const string_type &string )
+			{
+				basic_canonical::string( sink, string.data(), string.data() + string.size() );
+			}
+
+			template < class Sink >
+			static void string( Sink &sink, const Char *start, const Char *end )
+			{
+				static const char hex[] = "0123456789abcdef";
+
+				sink.push_back( '"' );
+
+				const Char *plain = start;
+				for ( const Char *i = start; i != end; ++i )
+				{
+					const Char c = *i;
+
+					if ( c != '"' && c != '\\' && ( c < 0 || c >= 0x20 ) ) continue;
+
+					if ( plain != i ) sink.append( plain, i - plain );
+					plain = i + 1;
+
+					sink.push_back( '\\' );
+					switch ( c )
+					{
+						case '"':
+						case '\\':
+							sink.push_back( c );
+							break;
+						case '\b':
+							sink.push_back( 'b' );
+							break;
+						case '\f':
+							sink.push_back( 'f' );
+							break;
+						case '\n':
+							sink.push_back( 'n' );
+							break;
+						case '\r':
+							sink.push_back( 'r' );
+							break;
+						case '\t':
+							sink.push_back( 't' );
+							break;
+						default:
+							literal( sink, "u00" );
+							sink.push_back( hex[ c >> 4 ] );
+							sink.push_back( hex[ c & 0xF ] );
+							break;
+					}
+				}
+
+				if ( plain != end ) sink.append( plain, end - plain );
+
+				sink.push_back( '"' );
+			}
+
+			/*
+			 * utf-8 byte order equals code point order, which only differs from utf-16
+			 * code unit order where a surrogate pair (lead byte 0xF0 and up) meets a
+			 * code point in U+E000..U+FFFF (lead byte 0xEE or 0xEF)
+			 */
+			static bool utf16_less( const member_type *lhs, const member_type *rhs )
+			{
+				const typename var_type::key_type &a = lhs->key, &b = rhs->key;
+
+				const std::pair< const Char*, const Char* > difference = std::mismatch( a.begin(), a.begin() + std::min( a.size(), b.size() ), b.begin() );
+
+				if ( difference.first == a.begin() + std::min( a.size(), b.size() ) ) return a.size() < b.size();
+
+				const unsigned int x = static_cast< unsigned char >( *difference.first ), y = static_cast< unsigned char >( *difference.second );
+
+				if ( x >= 0xF0 && ( y == 0xEE || y == 0xEF ) ) return true;
+				if ( y >= 0xF0 && ( x == 0xEE || x == 0xEF ) ) return false;
+
+				return x < y;
+			}
+
+		private:
+
+			template < class Sink >
+			static void literal( Sink &sink, const char *text )
+			{
+				while ( *text ) sink.push_back( *text++ );
+			}
+
+			template < class Sink >
+			static void literal( Sink &sink, const char *text, int count )
+			{
+				for ( int i = 0; i < count; ++i ) sink.push_back( text[ i ] );
+			}
+	};
+
+	template < template< class > class CopyBehaviour, class Char >
+	std::basic_string< Char > canonical( const basic_var< CopyBehaviour, Char > &value )
+	{
+		std::basic_string< Char > result;
+		string_sink< std::basic_string< Char > > sink( result );
+		basic_canonical< CopyBehaviour, Char >::write( value, sink );
+		return result;
+	}
+
+	/* feeds the canonical form to hasher without ever holding all of it in memory */
+	template < template< class > class CopyBehaviour, class Hasher >
+	Hasher& canonical_hash( const basic_var< CopyBehaviour, char > &value, Hasher &hasher )
+	{
+		hash_sink< Hasher > sink( hasher );
+		basic_canonical< CopyBehaviour, char >::write( value, sink );
+		sink.flush();
+		return hasher;
+	}
+}
@@ -0,0 +1,769 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <cstddef>
+#include <cerrno>
+#include <iterator>
+#include <exception>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#ifdef JSONPP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef JSONPP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <jsonpp/misc.h>
+#include <jsonpp/sink.h>
+
+/*
+ * gzip and zstd compressed input and output that is decoded while it is
+ * parsed and encoded while it is written, so neither the whole text nor the
+ * whole compressed file is ever held in memory. The codec runs on a thread
+ * of its own and hands blocks over through a block_pipe that holds a few of
+ * them at most, so the slower of codec and parser or writer sets the pace.
+ * The codecs are there when JSONPP_HAVE_ZLIB or JSONPP_HAVE_ZSTD is defined,
+ * bin/CMakeLists.txt does that when it finds the library. Reading:
+ *
+ *	json::decompressing_source< json::gzip_decoder > source( descriptor );
+ *	json::var value = json::basic_parser< json::CopyOnWrite, char >().parse( source.begin(), source.end(), json::parse_options::standard );
+ *
+ * and writing:
+ *
+ *	json::compressing_sink< json::zstd_encoder > sink( descriptor );
+ *	value.write( sink );
+ *	sink.close();
+ */
+namespace json
+{
+	/*
+	 * blocks handed from one thread to another. put waits while capacity
+	 * blocks are waiting, take waits while there are none. Without threads
+	 * (_MSC_VER) neither waits, take then returns false when it is empty.
+	 */
+	class block_pipe
+	{
+		public:
+
+			explicit block_pipe( size_t capacity = 4 ) :
+				_blocks(),
+				_capacity( capacity ? capacity : 1 ),
+				_closed( false ),
+				_cancelled( false ),
+				_error()
+#ifndef _MSC_VER
+				, _lock(),
+				_ready(),
+				_space()
+#endif
+			{
+#ifndef _MSC_VER
+				pthread_mutex_init( &_lock, 0 );
+				pthread_cond_init( &_ready, 0 );
+				pthread_cond_init( &_space, 0 );
+#endif
+			}
+
+			~block_pipe()
+			{
+#ifndef _MSC_VER
+				pthread_cond_destroy( &_space );
+				pthread_cond_destroy( &_ready );
+				pthread_mutex_destroy( &_lock );
+#endif
+			}
+
+			/* moves block into the pipe and leaves it empty, false when the taking side cancelled */
+			bool put( std::string &block )
+			{
+				guard locked( *this );
+
+#ifndef _MSC_VER
+				while ( _blocks.size() >= _capacity && !_cancelled ) pthread_cond_wait( &_space, &_lock );
+#endif
+				if ( _cancelled ) return false;
+
+				_blocks.push_back( std::string() );
+				_blocks.back().swap( block );
+				ready();
+				return true;
+			}
+
+			/* moves the next block into block, false when the pipe is closed and empty */
+			bool take( std::string &block )
+			{
+				guard locked( *this );
+
+#ifndef _MSC_VER
+				while ( _blocks.empty() && !_closed ) pthread_cond_wait( &_ready, &_lock );
+#endif
+				if ( _blocks.empty() ) return false;
+
+				block.swap( _blocks.front() );
+				_blocks.pop_front();
+				space();
+				return true;
+			}
+
+			/* no more blocks will be put, error tells the taking side why if something went wrong */
+			void close( const std::string &error = std::string() )
+			{
+				guard locked( *this );
+				_closed = true;
+				if ( _error.empty() ) _error = error;
+				ready();
+			}
+
+			/* no more blocks will be taken */
+			void cancel( const std::string &error = std::string() )
+			{
+				guard locked( *this );
+				_cancelled = true;
+				if ( _error.empty() ) _error = error;
+				space();
+			}
+
+			bool closed() const
+			{
+				guard locked( *this );
+				return _closed;
+			}
+
+			/* why the other side closed or cancelled, empty when it just finished */
+			std::string error() const
+			{
+				guard locked( *this );
+				return _error;
+			}
+
+		private:
+
+			block_pipe( const block_pipe& );
+			block_pipe& operator = ( const block_pipe& );
+
+			class guard
+			{
+				public:
+
+					explicit guard( const block_pipe &pipe ) :
+						_pipe( pipe )
+					{
+#ifndef _MSC_VER
+						pthread_mutex_lock( &_pipe._lock );
+#endif
+					}
+
+					~guard()
+					{
+#ifndef _MSC_VER
+						pthread_mutex_unlock( &_pipe._lock );
+#endif
+					}
+
+				private:
+
+					guard( const guard& );
+					guard& operator = ( const guard& );
+
+					const block_pipe &_pipe;
+			};
+
+			/* wakes the side waiting for a block */
+			void ready()
+			{
+#ifndef _MSC_VER
+				pthread_cond_broadcast( &_ready );
+#endif
+			}
+
+			/* wakes the side waiting for room */
+			void space()
+			{
+#ifndef _MSC_VER
+				pthread_cond_broadcast( &_space );
+#endif
+			}
+
+			std::deque< std::string > _blocks;
+			size_t _capacity;
+			bool _closed, _cancelled;
+			std::string _error;
+#ifndef _MSC_VER
+			mutable pthread_mutex_t _lock;
+			pthread_cond_t _ready, _space;
+#endif
+	};
+
+#ifdef JSONPP_HAVE_ZLIB
+	/* gzip or zlib streams, several gzip members in a row are read as one */
+	class gzip_decoder
+	{
+		public:
+
+			gzip_decoder() :
+				_stream(),
+				_done( false )
+			{
+				if ( inflateInit2( &_stream, 15 + 32 ) != Z_OK ) throw exception( "can't start inflating" );
+			}
+
+			~gzip_decoder()
+			{
+				inflateEnd( &_stream );
+			}
+
+			/* decodes [ start, start + count ) and appends what that gives to out */
+			void decode( const char *start, size_t count, std::string &out )
+			{
+				_stream.next_in = reinterpret_cast< Bytef* >( const_cast< char* >( start ) );
+				_stream.avail_in = static_cast< uInt >( count );
+
+				for ( bool full = false; _stream.avail_in || full; )
+				{
+					if ( _done )
+					{
+						if ( inflateReset( &_stream ) != Z_OK ) throw exception( "can't restart inflating" );
+						_done = false;
+					}
+
+					const size_t used = out.size();
+					out.resize( used + Block );
+					_stream.next_out = reinterpret_cast< Bytef* >( &out[ used ] );
+					_stream.avail_out = Block;
+
+					const int result = inflate( &_stream, Z_NO_FLUSH );
+					out.resize( used + Block - _stream.avail_out );
+					full = _stream.avail_out == 0;
+
+					if ( result == Z_STREAM_END ) _done = true;
+					else if ( result == Z_BUF_ERROR ) break;
+					else if ( result != Z_OK ) throw exception( "corrupt gzip input:" ) << ( _stream.msg ? _stream.msg : "" );
+				}
+			}
+
+			/* false when the input stopped inside a stream */
+			bool complete() const
+			{
+				return _done;
+			}
+
+		private:
+
+			enum { Block = 1 << 16 };
+
+			gzip_decoder( const gzip_decoder& );
+			gzip_decoder& operator = ( const gzip_decoder& );
+
+			z_stream _stream;
+			bool _done;
+	};
+
+	class gzip_encoder
+	{
+		public:
+
+			enum { Default = Z_DEFAULT_COMPRESSION };
+
+			explicit gzip_encoder( int level = Default ) :
+				_stream()
+			{
+				if ( deflateInit2( &_stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) throw exception( "can't start deflating at level" ) << level;
+			}
+
+			~gzip_encoder()
+			{
+				deflateEnd( &_stream );
+			}
+
+			void encode( const char *start, size_t count, std::string &out )
+			{
+				run( start, count, Z_NO_FLUSH, out );
+			}
+
+			/* appends the end of the stream to out */
+			void finish( std::string &out )
+			{
+				run( 0, 0, Z_FINISH, out );
+			}
+
+		private:
+
+			enum { Block = 1 << 16 };
+
+			gzip_encoder( const gzip_encoder& );
+			gzip_encoder& operator = ( const gzip_encoder& );
+
+			void run( const char *start, size_t count, int flush, std::string &out )
+			{
+				_stream.next_in = reinterpret_cast< Bytef* >( const_cast< char* >( start ) );
+				_stream.avail_in = static_cast< uInt >( count );
+
+				for ( ;; )
+				{
+					const size_t used = out.size();
+					out.resize( used + Block );
+					_stream.next_out = reinterpret_cast< Bytef* >( &out[ used ] );
+					_stream.avail_out = Block;
+
+					const int result = deflate( &_stream, flush );
+					out.resize( used + Block - _stream.avail_out );
+
+					if ( result == Z_STREAM_ERROR ) throw exception( "deflating failed" );
+					if ( flush == Z_FINISH ? result == Z_STREAM_END : !_stream.avail_in && _stream.avail_out ) return;
+				}
+			}
+
+			z_stream _stream;
+	};
+#endif
+
+#ifdef JSONPP_HAVE_ZSTD
+	/* zstd streams, several frames in a row are read as one */
+	class zstd_decoder
+	{
+		public:
+
+			zstd_decoder() :
+				_stream( ZSTD_createDStream() ),
+				_done( false )
+			{
+				if ( !_stream || ZSTD_isError( ZSTD_initDStream( _stream ) ) ) throw exception( "can't start zstd decompression" );
+			}
+
+			~zstd_decoder()
+			{
+				ZSTD_freeDStream( _stream );
+			}
+
+			void decode( const char *start, size_t count, std::string &out )
+			{
+				ZSTD_inBuffer input = { start, count, 0 };
+
+				for ( bool full = false; input.pos < input.size || full; )
+				{
+					const size_t used = out.size();
+					out.resize( used + Block );
+					ZSTD_outBuffer output = { &out[ used ], Block, 0 };
+
+					const size_t result = ZSTD_decompressStream( _stream, &output, &input );
+					out.resize( used + output.pos );
+					if ( ZSTD_isError( result ) ) throw exception( "corrupt zstd input:" ) << ZSTD_getErrorName( result );
+
+					_done = result == 0;
+					full = output.pos == output.size;
+				}
+			}
+
+			bool complete() const
+			{
+				return _done;
+			}
+
+		private:
+
+			enum { Block = 1 << 16 };
+
+			zstd_decoder( const zstd_decoder& );
+			zstd_decoder& operator = ( const zstd_decoder& );
+
+			ZSTD_DStream *_stream;
+			bool _done;
+	};
+
+	class zstd_encoder
+	{
+		public:
+
+			enum { Default = 3 };
+
+			explicit zstd_encoder( int level = Default ) :
+				_stream( ZSTD_createCStream() )
+			{
+				if ( !_stream || ZSTD_isError( ZSTD_initCStream( _stream, level ) ) ) throw exception( "can't start zstd compression at level" ) << level;
+			}
+
+			~zstd_encoder()
+			{
+				ZSTD_freeCStream( _stream );
+			}
+
+			void encode( const char *start, size_t count, std::string &out )
+			{
+				ZSTD_inBuffer input = { start, count, 0 };
+
+				while ( input.pos < input.size )
+				{
+					const size_t used = out.size();
+					out.resize( used + Block );
+					ZSTD_outBuffer output = { &out[ used ], Block, 0 };
+
+					const size_t result = ZSTD_compressStream( _stream, &output, &input );
+					out.resize( used + output.pos );
+					if ( ZSTD_isError( result ) ) throw exception( "zstd compression failed:" ) << ZSTD_getErrorName( result );
+				}
+			}
+
+			void finish( std::string &out )
+			{
+				for ( size_t left = 1; left; )
+				{
+					const size_t used = out.size();
+					out.resize( used + Block );
+					ZSTD_outBuffer output = { &out[ used ], Block, 0 };
+
+					left = ZSTD_endStream( _stream, &output );
+					out.resize( used + output.pos );
+					if ( ZSTD_isError( left ) ) throw exception( "zstd compression failed:" ) << ZSTD_getErrorName( left );
+				}
+			}
+
+		private:
+
+			enum { Block = 1 << 16 };
+
+			zstd_encoder( const zstd_encoder& );
+			zstd_encoder& operator = ( const zstd_encoder& );
+
+			ZSTD_CStream *_stream;
+	};
+#endif
+
+	/*
+	 * the decoded bytes read from descriptor as a single pass input range,
+	 * like std::istream_iterator: copies of an iterator share the position.
+	 * The descriptor is read and decoded on a thread of its own. Input that
+	 * fails to decode or stops inside a stream makes the iterators throw
+	 * json::exception once they get there.
+	 */
+	template < class Decoder >
+	class decompressing_source
+	{
+		public:
+
+			class iterator
+			{
+				public:
+
+					typedef std::input_iterator_tag iterator_category;
+					typedef char value_type;
+					typedef std::ptrdiff_t difference_type;
+					typedef const char* pointer;
+					typedef const char& reference;
+
+					iterator() :
+						_source( 0 ) { }
+
+					explicit iterator( decompressing_source &source ) :
+						_source( &source ) { }
+
+					const char& operator*() const
+					{
+						ended();
+						return *_source->_current;
+					}
+
+					iterator& operator++()
+					{
+						if ( !ended() ) ++_source->_current;
+						return *this;
+					}
+
+					bool operator==( const iterator &other ) const
+					{
+						return ended() == other.ended();
+					}
+
+					bool operator!=( const iterator &other ) const
+					{
+						return ended() != other.ended();
+					}
+
+				private:
+
+					bool ended() const
+					{
+						return !_source || ( _source->_current == _source->_stop && !_source->fetch() );
+					}
+
+					decompressing_source *_source;
+			};
+
+			explicit decompressing_source( int descriptor, size_t blocks = 4 ) :
+				_descriptor( descriptor ),
+				_pipe( blocks ),
+				_decoder(),
+				_pending(),
+				_block(),
+				_current( _block.c_str() ),
+				_stop( _current )
+#ifndef _MSC_VER
+				, _thread()
+#endif
+			{
+#ifndef _MSC_VER
+				if ( pthread_create( &_thread, 0, produce, this ) != 0 ) throw exception( "can't start a thread" );
+#endif
+			}
+
+			~decompressing_source()
+			{
+#ifndef _MSC_VER
+				_pipe.cancel();
+				pthread_join( _thread, 0 );
+#endif
+			}
+
+			iterator begin()
+			{
+				return iterator( *this );
+			}
+
+			iterator end()
+			{
+				return iterator();
+			}
+
+		private:
+
+			enum { Input = 1 << 16, Block = 1 << 16 };
+
+			decompressing_source( const decompressing_source& );
+			decompressing_source& operator = ( const decompressing_source& );
+
+			/* the next block into _block, false at the end of the input */
+			bool fetch()
+			{
+				for ( ;; )
+				{
+					const bool taken = _pipe.take( _block );
+					if ( !taken ) _block.clear();
+
+					_current = _block.c_str();
+					_stop = _current + _block.size();
+
+					if ( taken )
+					{
+						if ( _block.empty() ) continue;
+						return true;
+					}
+
+					const std::string error = _pipe.error();
+					if ( !error.empty() ) throw exception( error );
+#ifdef _MSC_VER
+					if ( !_pipe.closed() )
+					{
+						step_safely();
+						continue;
+					}
+#endif
+					return false;
+				}
+			}
+
+			/* reads and decodes one block of input, false once there is no more or nobody takes it */
+			bool step()
+			{
+				char input[ Input ];
+
+#ifdef _MSC_VER
+				const int count = ::_read( _descriptor, input, Input );
+#else
+				const ssize_t count = ::read( _descriptor, input, Input );
+#endif
+				if ( count < 0 )
+				{
+					if ( errno == EINTR ) return true;
+					throw exception( "read from descriptor" ) << _descriptor << "failed with errno" << errno;
+				}
+
+				if ( count == 0 )
+				{
+					if ( !_decoder.complete() ) throw exception( "compressed input ended early" );
+					if ( !_pending.empty() && !_pipe.put( _pending ) ) return false;
+					_pipe.close();
+					return false;
+				}
+
+				_decoder.decode( input, static_cast< size_t >( count ), _pending );
+				return _pending.size() < Block || _pipe.put( _pending );
+			}
+
+			void step_safely()
+			{
+				try
+				{
+					step();
+				}
+				catch ( const std::exception &e )
+				{
+					_pipe.close( e.what() );
+				}
+			}
+
+			static void* produce( void *argument )
+			{
+				decompressing_source &self = *static_cast< decompressing_source* >( argument );
+
+				try
+				{
+					while ( self.step() ) { }
+				}
+				catch ( const std::exception &e )
+				{
+					self._pipe.close( e.what() );
+				}
+
+				return 0;
+			}
+
+			int _descriptor;
+			block_pipe _pipe;
+			Decoder _decoder;
+			std::string _pending, _block;
+			const char *_current, *_stop;
+#ifndef _MSC_VER
+			pthread_t _thread;
+#endif
+	};
+
+	/*
+	 * a sink, see sink.h, that encodes what it gets and writes it to
+	 * descriptor, encoding on a thread of its own. close() ends the stream
+	 * and throws what went wrong, the destructor closes too but can't tell.
+	 */
+	template < class Encoder >
+	class compressing_sink : public buffered_sink< compressing_sink< Encoder >, char >
+	{
+		public:
+
+			explicit compressing_sink( int descriptor, int level = Encoder::Default, size_t blocks = 4 ) :
+				buffered_sink< compressing_sink< Encoder >, char >(),
+				_output( descriptor ),
+				_pipe( blocks ),
+				_encoder( level ),
+				_block(),
+				_closed( false )
+#ifndef _MSC_VER
+				, _thread()
+#endif
+			{
+#ifndef _MSC_VER
+				if ( pthread_create( &_thread, 0, consume, this ) != 0 ) throw exception( "can't start a thread" );
+#endif
+			}
+
+			~compressing_sink()
+			{
+				try
+				{
+					close();
+				}
+				catch ( const exception& )
+				{
+				}
+			}
+
+			void close()
+			{
+				if ( _closed ) return;
+
+				try
+				{
+					this->flush();
+				}
+				catch ( const exception& )
+				{
+					_closed = true;
+					finish();
+					throw;
+				}
+
+				_closed = true;
+				finish();
+
+				const std::string error = _pipe.error();
+				if ( !error.empty() ) throw exception( error );
+			}
+
+			/* called by buffered_sink with a block of text */
+			void write( const char *start, size_t count )
+			{
+				if ( _closed ) throw exception( "write to a closed compressing_sink" );
+
+				_block.assign( start, count );
+#ifndef _MSC_VER
+				if ( !_pipe.put( _block ) ) throw exception( _pipe.error() );
+#else
+				std::string out;
+				_encoder.encode( _block.data(), _block.size(), out );
+				_output.write( out.data(), out.size() );
+#endif
+			}
+
+		private:
+
+			compressing_sink( const compressing_sink& );
+			compressing_sink& operator = ( const compressing_sink& );
+
+			/* lets the encoding side write the end of the stream and waits for it */
+			void finish()
+			{
+#ifndef _MSC_VER
+				_pipe.close();
+				pthread_join( _thread, 0 );
+#else
+				try
+				{
+					std::string out;
+					_encoder.finish( out );
+					_output.write( out.data(), out.size() );
+				}
+				catch ( const std::exception &e )
+				{
+					_pipe.cancel( e.what() );
+				}
+#endif
+			}
+
+			static void* consume( void *argument )
+			{
+				compressing_sink &self = *static_cast< compressing_sink* >( argument );
+				std::string block, out;
+
+				try
+				{
+					while ( self._pipe.take( block ) )
+					{
+						out.clear();
+						self._encoder.encode( block.data(), block.size(), out );
+						self._output.write( out.data(), out.size() );
+					}
+
+					out.clear();
+					self._encoder.finish( out );
+					self._output.write( out.data(), out.size() );
+				}
+				catch ( const std::exception &e )
+				{
+					self._pipe.cancel( e.what() );
+				}
+
+				return 0;
+			}
+
+			descriptor_sink _output;
+			block_pipe _pipe;
+			Encoder _encoder;
+			std::string _block;
+			bool _closed;
+#ifndef _MSC_VER
+			pthread_t _thread;
+#endif
+	};
+}
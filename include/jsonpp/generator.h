@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdlib>
+#include <vector>
 
 #include <jsonpp/var.h>
 
@@ -22,52 +23,70 @@ namespace json
 		return result;
 	}
 
+	/* random tree, built from an explicit stack so treeDepth isn't limited by the call stack */
 	template < template< class > class CopyBehaviour, class T >
 	basic_var< CopyBehaviour, T > generate( unsigned int treeDepth, unsigned int stringLength, unsigned iterations )
 	{
-		basic_var< CopyBehaviour, T > v;
+		typedef basic_var< CopyBehaviour, T > var_type;
 
-		if ( treeDepth )
+		var_type root;
+
+		std::vector< std::pair< var_type*, unsigned int > > pending( 1, std::make_pair( &root, treeDepth ) );
+
+		while ( !pending.empty() )
 		{
-			if ( rand() & 1 )
+			var_type &v = *pending.back().first;
+			const unsigned int depth = pending.back().second;
+			pending.pop_back();
+
+			if ( depth )
 			{
-				// array
-				for ( unsigned int i = 0; i < iterations; ++i )
+				if ( rand() & 1 )
+				{
+					// array
+					for ( unsigned int i = 0; i < iterations; ++i )
+					{
+						v.push( var_type() );
+					}
+				}
+				else
+				{
+					// object
+					for ( unsigned int i = 0; i < iterations; ++i )
+					{
+						v[ generateString< T >( stringLength ) ];
+					}
+				}
+
+				/* children are filled in once all of them exist, adding one may move the others */
+				for ( typename var_type::iterator i = v.begin(); i != v.end(); ++i )
 				{
-					v.push( generate< CopyBehaviour, T >( treeDepth - 1, stringLength, iterations ) );
+					pending.push_back( std::make_pair( &i->value, depth - 1 ) );
 				}
 			}
 			else
 			{
-				// object
-				for ( unsigned int i = 0; i < iterations; ++i )
+				switch ( rand() % 5 )
 				{
-					v[ generateString< T >( stringLength ) ] = generate< CopyBehaviour, T >( treeDepth - 1, stringLength, iterations );
+					case 0: // Undefined
+						v = Undefined;
+						break;
+					case 1: // Null
+						v = Null;
+						break;
+					case 2: // Bool
+						v = bool( rand() & 1 );
+						break;
+					case 3: // Number
+						v = rand();
+						break;
+					case 4: // String
+						v = generateString< T >( stringLength );
+						break;
 				}
 			}
 		}
-		else
-		{
-			switch ( rand() % 5 )
-			{
-				case 0: // Undefined
-					v = Undefined;
-					break;
-				case 1: // Null
-					v = Null;
-					break;
-				case 2: // Bool
-					v = bool( rand() & 1 );
-					break;
-				case 3: // Number
-					v = rand();
-					break;
-				case 4: // String
-					v = generateString< T >( stringLength );
-					break;
-			}
-		}
 
-		return v;
+		return root;
 	}
 }
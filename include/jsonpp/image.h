@@ -0,0 +1,843 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstdio>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <jsonpp/var.h>
+
+namespace json
+{
+	/*
+	 * a document laid out as a flat, pointer free image that can be written to
+	 * a file or shared memory, mapped by any process and read in place through
+	 * basic_view without parsing. All fields are native endian and aligned to
+	 * 8 bytes, offsets count from the start of the image:
+	 *
+	 *   header  "JSONPPI1", byte order mark, sizeof( Char ), image size, root slot
+	 *   slot    type, extra, payload: 16 bytes that hold a value or point at it
+	 *   string  characters and a terminating 0, extra of its slot is the length
+	 *   array   count, then a slot per element
+	 *   object  count, buckets, then per member its slot, key offset, key
+	 *           length and key hash in insertion order, then buckets indices
+	 *           into the members for hashed lookup, none for small objects
+	 *
+	 * Numbers keep integers exact and store everything else as a double.
+	 */
+	namespace image_format
+	{
+		enum
+		{
+			Floating,
+			Signed,
+			Unsigned
+		};
+
+		struct slot
+		{
+			unsigned int type;
+			unsigned int extra;
+			unsigned long long payload;
+		};
+
+		struct header
+		{
+			char magic[ 8 ];
+			unsigned int order;
+			unsigned int character_size;
+			unsigned long long size;
+			slot root;
+		};
+
+		struct member
+		{
+			slot value;
+			unsigned long long key;
+			unsigned int length;
+			unsigned int hash;
+		};
+
+		const unsigned int ByteOrder = 0x01020304;
+
+		const unsigned int Empty = ~0u;
+
+		/* objects up to this size are searched in order */
+		const unsigned long long Scanned = 8;
+
+		inline const char* magic()
+		{
+			return "JSONPPI1";
+		}
+
+		/* 32 bit FNV-1a, the same in every process */
+		template < class Char >
+		unsigned int hash( const Char *start, size_t length )
+		{
+			unsigned int result = 2166136261u;
+			for ( const Char *end = start + length; start != end; ++start )
+			{
+				result ^= static_cast< unsigned int >( *start );
+				result *= 16777619u;
+			}
+			return result;
+		}
+	}
+
+	/* lays out value as an image, see image_format */
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_image_builder
+	{
+		public:
+
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			typedef std::basic_string< Char > string_type;
+
+			basic_image_builder() :
+				_bytes(),
+				_strings(),
+				_pending() { }
+
+			std::string build( const var_type &value )
+			{
+				_bytes.assign( sizeof( image_format::header ), 0 );
+				_strings.clear();
+
+				put( offsetof_root(), value );
+
+				while ( !_pending.empty() )
+				{
+					const pending next = _pending.front();
+					_pending.pop_front();
+
+					if ( next.value->type == Array ) put_array( next.slot, *next.value );
+					else put_object( next.slot, *next.value );
+				}
+
+				image_format::header header;
+				std::memcpy( &header, _bytes.data(), sizeof( header ) );
+				std::memcpy( header.magic, image_format::magic(), sizeof( header.magic ) );
+				header.order = image_format::ByteOrder;
+				header.character_size = sizeof( Char );
+				header.size = _bytes.size();
+				std::memcpy( &_bytes[ 0 ], &header, sizeof( header ) );
+
+				std::string result;
+				result.swap( _bytes );
+				return result;
+			}
+
+		private:
+
+			enum
+			{
+				Shared = 64
+			};
+
+			/* a container whose block is written once the blocks before it are */
+			struct pending
+			{
+				pending( size_t s, const var_type *v ) :
+					slot( s ),
+					value( v ) { }
+
+				size_t slot;
+				const var_type *value;
+			};
+
+			typedef std::tr1::unordered_map< string_type, size_t > string_offsets;
+
+			static size_t offsetof_root()
+			{
+				return sizeof( image_format::header ) - sizeof( image_format::slot );
+			}
+
+			size_t reserve( size_t bytes )
+			{
+				const size_t offset = ( _bytes.size() + 7 ) & ~static_cast< size_t >( 7 );
+				_bytes.resize( offset + bytes );
+				return offset;
+			}
+
+			template < class T >
+			void store( size_t offset, const T &value )
+			{
+				std::memcpy( &_bytes[ offset ], &value, sizeof( value ) );
+			}
+
+			/* short strings, keys included, are stored once however often they occur */
+			size_t string( const Char *start, size_t length )
+			{
+				const bool shared = length <= Shared;
+
+				if ( shared )
+				{
+					typename string_offsets::const_iterator found = _strings.find( string_type( start, length ) );
+					if ( found != _strings.end() ) return found->second;
+				}
+
+				const size_t offset = reserve( ( length + 1 ) * sizeof( Char ) );
+				if ( length ) std::memcpy( &_bytes[ offset ], start, length * sizeof( Char ) );
+
+				if ( shared ) _strings.insert( std::make_pair( string_type( start, length ), offset ) );
+				return offset;
+			}
+
+			static unsigned int length( size_t size )
+			{
+				if ( size >= image_format::Empty ) throw exception( "string too long for an image:" ) << size;
+				return static_cast< unsigned int >( size );
+			}
+
+			void put( size_t at, const var_type &value )
+			{
+				image_format::slot slot;
+				slot.type = value.type;
+				slot.extra = 0;
+				slot.payload = 0;
+
+				switch ( value.type )
+				{
+					case Bool:
+						slot.payload = value.toBool();
+						break;
+					case Number:
+						switch ( value.number_format() )
+						{
+							case var_type::basic_data::Signed:
+								slot.extra = image_format::Signed;
+								slot.payload = static_cast< unsigned long long >( value.toInteger() );
+								break;
+							case var_type::basic_data::Unsigned:
+								slot.extra = image_format::Unsigned;
+								slot.payload = value.toUnsigned();
+								break;
+							default:
+							{
+								const double number = static_cast< double >( value.toNumber() );
+								slot.extra = image_format::Floating;
+								std::memcpy( &slot.payload, &number, sizeof( number ) );
+								break;
+							}
+						}
+						break;
+					case String:
+					{
+						const string_type text = value.toString();
+						slot.extra = length( text.size() );
+						slot.payload = string( text.data(), text.size() );
+						break;
+					}
+					case Array:
+					case Object:
+						_pending.push_back( pending( at, &value ) );
+						break;
+					default:
+						break;
+				}
+
+				store( at, slot );
+			}
+
+			/* the payload of the slot at slot becomes offset */
+			void link( size_t slot, size_t offset )
+			{
+				const unsigned long long payload = offset;
+				store( slot + offsetof( image_format::slot, payload ), payload );
+			}
+
+			void put_array( size_t slot, const var_type &value )
+			{
+				const unsigned long long count = value.size();
+				const size_t block = reserve( sizeof( count ) + count * sizeof( image_format::slot ) );
+				store( block, count );
+				link( slot, block );
+
+				size_t at = block + sizeof( count );
+				for ( typename var_type::const_iterator i = value.begin(); i != value.end(); ++i, at += sizeof( image_format::slot ) )
+				{
+					put( at, i->value );
+				}
+			}
+
+			void put_object( size_t slot, const var_type &value )
+			{
+				const unsigned long long count = value.size();
+
+				unsigned long long buckets = 0;
+				if ( count > image_format::Scanned )
+				{
+					buckets = 1;
+					while ( buckets < count * 2 ) buckets *= 2;
+				}
+
+				const size_t members = sizeof( count ) + sizeof( buckets );
+				const size_t table = members + count * sizeof( image_format::member );
+				const size_t block = reserve( table + buckets * sizeof( unsigned int ) );
+				store( block, count );
+				store( block + sizeof( count ), buckets );
+				link( slot, block );
+
+				std::vector< unsigned int > indices( static_cast< size_t >( buckets ), image_format::Empty );
+
+				unsigned int index = 0;
+				for ( typename var_type::const_iterator i = value.begin(); i != value.end(); ++i, ++index )
+				{
+					const size_t at = block + members + index * sizeof( image_format::member );
+
+					image_format::member entry;
+					std::memset( &entry, 0, sizeof( entry ) );
+					entry.length = length( i->key.size() );
+					entry.hash = image_format::hash( i->key.data(), i->key.size() );
+					entry.key = string( i->key.data(), i->key.size() );
+					store( at, entry );
+
+					put( at + offsetof( image_format::member, value ), i->value );
+
+					if ( buckets )
+					{
+						size_t bucket = entry.hash & ( buckets - 1 );
+						while ( indices[ bucket ] != image_format::Empty ) bucket = ( bucket + 1 ) & ( buckets - 1 );
+						indices[ bucket ] = index;
+					}
+				}
+
+				if ( buckets ) std::memcpy( &_bytes[ block + table ], &indices[ 0 ], indices.size() * sizeof( unsigned int ) );
+			}
+
+			std::string _bytes;
+			string_offsets _strings;
+			std::deque< pending > _pending;
+	};
+
+	template < template< class > class CopyBehaviour, class Char >
+	std::string image( const basic_var< CopyBehaviour, Char > &value )
+	{
+		return basic_image_builder< CopyBehaviour, Char >().build( value );
+	}
+
+	/*
+	 * read only value inside an image, it points into the image, which has to
+	 * outlive it. Offsets are checked against the image size, so a damaged
+	 * image throws instead of reading outside it.
+	 */
+	template < class Char >
+	class basic_view
+	{
+		public:
+
+			typedef std::basic_string< Char > string_type;
+
+			struct entry;
+
+			class const_iterator;
+
+			basic_view() :
+				_image( 0 ),
+				_size( 0 ),
+				_slot( undefined() ) { }
+
+			/* the root of the image in [ data, data + size ), throws when it is not one */
+			static basic_view open( const void *data, size_t size )
+			{
+				image_format::header header;
+				if ( size < sizeof( header ) ) throw exception( "not a JSON image" );
+				std::memcpy( &header, data, sizeof( header ) );
+
+				if ( std::memcmp( header.magic, image_format::magic(), sizeof( header.magic ) ) != 0 ) throw exception( "not a JSON image" );
+				if ( header.order != image_format::ByteOrder ) throw exception( "JSON image has a different byte order" );
+				if ( header.character_size != sizeof( Char ) ) throw exception( "JSON image has a different character size" );
+				if ( header.size > size ) throw exception( "JSON image is truncated" );
+
+				return basic_view( static_cast< const char* >( data ), static_cast< size_t >( header.size ), header.root );
+			}
+
+			Types type() const
+			{
+				return static_cast< Types >( _slot.type );
+			}
+
+			size_t size() const
+			{
+				switch ( type() )
+				{
+					case String:
+						return _slot.extra;
+					case Array:
+					case Object:
+						return static_cast< size_t >( count() );
+					default:
+						return 0;
+				}
+			}
+
+			bool empty() const
+			{
+				return size() == 0;
+			}
+
+			const_iterator begin() const
+			{
+				return const_iterator( *this, 0 );
+			}
+
+			const_iterator end() const
+			{
+				return const_iterator( *this, size() );
+			}
+
+			/* Undefined for an index past the end or a view that is no array */
+			basic_view operator[]( size_t index ) const
+			{
+				if ( type() != Array || index >= count() ) return basic_view();
+
+				const size_t at = block( static_cast< size_t >( _slot.payload ) + sizeof( unsigned long long ) + index * sizeof( image_format::slot ), sizeof( image_format::slot ) );
+				return basic_view( _image, _size, *reinterpret_cast< const image_format::slot* >( _image + at ) );
+			}
+
+			basic_view operator[]( int index ) const
+			{
+				return operator[]( static_cast< size_t >( index ) );
+			}
+
+			/* Undefined for a missing member */
+			basic_view operator[]( const string_type &key ) const
+			{
+				return find( key.data(), key.size() );
+			}
+
+			basic_view operator[]( const Char *key ) const
+			{
+				return find( key, std::char_traits< Char >::length( key ) );
+			}
+
+			bool has_key( const string_type &key ) const
+			{
+				return find( key.data(), key.size() ).type() != Undefined;
+			}
+
+			/* the characters of a String, in place and 0 terminated */
+			const Char* data() const
+			{
+				if ( type() != String ) return 0;
+				return reinterpret_cast< const Char* >( _image + block( static_cast< size_t >( _slot.payload ), ( _slot.extra + 1 ) * sizeof( Char ) ) );
+			}
+
+			string_type toString() const
+			{
+				switch ( type() )
+				{
+					case Array:
+						return convert_string< Char >( "Array" );
+					case Object:
+						return convert_string< Char >( "Object" );
+					case String:
+						return string_type( data(), _slot.extra );
+					case Number:
+						switch ( _slot.extra )
+						{
+							case image_format::Signed:
+							{
+								const long long value = toInteger();
+								return integer_to_string< Char >( value < 0 ? 0 - _slot.payload : _slot.payload, value < 0 );
+							}
+							case image_format::Unsigned:
+								return integer_to_string< Char >( _slot.payload, false );
+							default:
+								return number_to_string< Char >( toNumber() );
+						}
+					case Bool:
+						return convert_string< Char >( _slot.payload ? "true" : "false" );
+					case Null:
+						return convert_string< Char >( "null" );
+					default:
+						return string_type();
+				}
+			}
+
+			long double toNumber() const
+			{
+				switch ( type() )
+				{
+					case Number:
+						switch ( _slot.extra )
+						{
+							case image_format::Signed:
+								return static_cast< long double >( toInteger() );
+							case image_format::Unsigned:
+								return static_cast< long double >( _slot.payload );
+							default:
+							{
+								double result;
+								std::memcpy( &result, &_slot.payload, sizeof( result ) );
+								return result;
+							}
+						}
+					case Bool:
+						return _slot.payload ? 1 : 0;
+					case String:
+						return dec_string_to_number< string_type, long double >( toString().begin(), toString().end() );
+					default:
+						return 0;
+				}
+			}
+
+			long long toInteger() const
+			{
+				if ( type() == Number && _slot.extra != image_format::Floating ) return static_cast< long long >( _slot.payload );
+				return static_cast< long long >( toNumber() );
+			}
+
+			unsigned long long toUnsigned() const
+			{
+				if ( type() == Number && _slot.extra != image_format::Floating ) return _slot.payload;
+				return static_cast< unsigned long long >( toNumber() );
+			}
+
+			bool toBool() const
+			{
+				switch ( type() )
+				{
+					case Bool:
+						return _slot.payload != 0;
+					case Number:
+						return toNumber() != 0;
+					case String:
+						return _slot.extra != 0;
+					case Array:
+					case Object:
+						return true;
+					default:
+						return false;
+				}
+			}
+
+			/* copies the value out of the image */
+			template < template< class > class CopyBehaviour >
+			basic_var< CopyBehaviour, Char > var() const
+			{
+				typedef basic_var< CopyBehaviour, Char > var_type;
+
+				var_type result;
+				std::vector< std::pair< basic_view, var_type* > > pending( 1, std::make_pair( *this, &result ) );
+
+				while ( !pending.empty() )
+				{
+					const basic_view view = pending.back().first;
+					var_type &target = *pending.back().second;
+					pending.pop_back();
+
+					switch ( view.type() )
+					{
+						case Array:
+							target = var_type( Array );
+							for ( const_iterator i = view.begin(); i != view.end(); ++i ) target.push( var_type() );
+							break;
+						case Object:
+							target = var_type( Object );
+							for ( const_iterator i = view.begin(); i != view.end(); ++i ) target.push_member( typename var_type::key_type( i->key.data(), i->key.size() ), var_type() );
+							break;
+						case Number:
+							switch ( view._slot.extra )
+							{
+								case image_format::Signed:
+									target = var_type( view.toInteger() );
+									break;
+								case image_format::Unsigned:
+									target = var_type( view.toUnsigned() );
+									break;
+								default:
+									target = var_type( view.toNumber() );
+									break;
+							}
+							continue;
+						case String:
+							target = var_type( view.toString() );
+							continue;
+						case Bool:
+							target = var_type( view.toBool() );
+							continue;
+						default:
+							target = var_type( view.type() );
+							continue;
+					}
+
+					typename var_type::iterator element = target.array().begin();
+					for ( const_iterator i = view.begin(); i != view.end(); ++i, ++element )
+					{
+						pending.push_back( std::make_pair( i->value, &element->value ) );
+					}
+				}
+
+				return result;
+			}
+
+		private:
+
+			basic_view( const char *image, size_t size, const image_format::slot &slot ) :
+				_image( image ),
+				_size( size ),
+				_slot( slot ) { }
+
+			static image_format::slot undefined()
+			{
+				image_format::slot result;
+				result.type = Undefined;
+				result.extra = 0;
+				result.payload = 0;
+				return result;
+			}
+
+			static image_format::slot string_slot( unsigned long long offset, unsigned int length )
+			{
+				image_format::slot result;
+				result.type = String;
+				result.extra = length;
+				result.payload = offset;
+				return result;
+			}
+
+			/* offset, after checking that bytes from there lie inside the image */
+			size_t block( size_t offset, size_t bytes ) const
+			{
+				if ( offset > _size || bytes > _size - offset ) throw exception( "JSON image is damaged at offset" ) << offset;
+				return offset;
+			}
+
+			unsigned long long count() const
+			{
+				const size_t at = block( static_cast< size_t >( _slot.payload ), sizeof( unsigned long long ) );
+				return *reinterpret_cast< const unsigned long long* >( _image + at );
+			}
+
+			unsigned long long buckets() const
+			{
+				const size_t at = block( static_cast< size_t >( _slot.payload ) + sizeof( unsigned long long ), sizeof( unsigned long long ) );
+				return *reinterpret_cast< const unsigned long long* >( _image + at );
+			}
+
+			const image_format::member& member( size_t index ) const
+			{
+				const size_t at = static_cast< size_t >( _slot.payload ) + 2 * sizeof( unsigned long long ) + index * sizeof( image_format::member );
+				return *reinterpret_cast< const image_format::member* >( _image + block( at, sizeof( image_format::member ) ) );
+			}
+
+			bool matches( const image_format::member &candidate, const Char *key, size_t length, unsigned int hash ) const
+			{
+				if ( candidate.hash != hash || candidate.length != length ) return false;
+
+				const Char *characters = reinterpret_cast< const Char* >( _image + block( static_cast< size_t >( candidate.key ), length * sizeof( Char ) ) );
+				return std::equal( key, key + length, characters );
+			}
+
+			basic_view find( const Char *key, size_t length ) const
+			{
+				if ( type() != Object ) return basic_view();
+
+				const unsigned int hash = image_format::hash( key, length );
+				const unsigned long long members = count(), table = buckets();
+
+				if ( !table )
+				{
+					for ( size_t i = 0; i < members; ++i )
+					{
+						const image_format::member &candidate = member( i );
+						if ( matches( candidate, key, length, hash ) ) return basic_view( _image, _size, candidate.value );
+					}
+					return basic_view();
+				}
+
+				const size_t indices = block( static_cast< size_t >( _slot.payload + 2 * sizeof( unsigned long long ) + members * sizeof( image_format::member ) ), static_cast< size_t >( table ) * sizeof( unsigned int ) );
+				const unsigned int *index = reinterpret_cast< const unsigned int* >( _image + indices );
+
+				for ( size_t bucket = hash & ( table - 1 ), probes = 0; index[ bucket ] != image_format::Empty && probes < table; bucket = ( bucket + 1 ) & ( table - 1 ), ++probes )
+				{
+					if ( index[ bucket ] >= members ) break;
+
+					const image_format::member &candidate = member( index[ bucket ] );
+					if ( matches( candidate, key, length, hash ) ) return basic_view( _image, _size, candidate.value );
+				}
+
+				return basic_view();
+			}
+
+			const char *_image;
+			size_t _size;
+			image_format::slot _slot;
+	};
+
+	/* a member of an object, or an element of an array with an Undefined key */
+	template < class Char >
+	struct basic_view< Char >::entry
+	{
+		entry() :
+			key(),
+			value() { }
+
+		basic_view key;
+		basic_view value;
+	};
+
+	template < class Char >
+	class basic_view< Char >::const_iterator
+	{
+		public:
+
+			const_iterator() :
+				_container(),
+				_index( 0 ),
+				_current() { }
+
+			const entry& operator * () const
+			{
+				return _current;
+			}
+
+			const entry* operator -> () const
+			{
+				return &_current;
+			}
+
+			const_iterator& operator ++ ()
+			{
+				++_index;
+				load();
+				return *this;
+			}
+
+			bool operator == ( const const_iterator &rhs ) const
+			{
+				return _index == rhs._index;
+			}
+
+			bool operator != ( const const_iterator &rhs ) const
+			{
+				return _index != rhs._index;
+			}
+
+		private:
+
+			friend class basic_view;
+
+			const_iterator( const basic_view &container, size_t index ) :
+				_container( container ),
+				_index( index ),
+				_current()
+			{
+				load();
+			}
+
+			void load()
+			{
+				if ( _index >= _container.size() ) return;
+
+				if ( _container.type() == Object )
+				{
+					const image_format::member &found = _container.member( _index );
+					_current.key = basic_view( _container._image, _container._size, string_slot( found.key, found.length ) );
+					_current.value = basic_view( _container._image, _container._size, found.value );
+				}
+				else
+				{
+					_current.value = _container[ _index ];
+				}
+			}
+
+			basic_view _container;
+			size_t _index;
+			entry _current;
+	};
+
+	typedef basic_view< char > view;
+	typedef basic_view< wchar_t > wview;
+
+	/* a file mapped read only, for images in a file or, through /dev/shm, in POSIX shared memory */
+	class mapped_file
+	{
+		public:
+
+			explicit mapped_file( const char *path ) :
+				_data( 0 ),
+				_size( 0 ),
+				_copy()
+			{
+#ifndef _MSC_VER
+				const int descriptor = ::open( path, O_RDONLY );
+				if ( descriptor < 0 ) throw exception( "can't open" ) << path;
+
+				struct stat status;
+				if ( ::fstat( descriptor, &status ) != 0 )
+				{
+					::close( descriptor );
+					throw exception( "can't stat" ) << path;
+				}
+
+				_size = static_cast< size_t >( status.st_size );
+				if ( _size )
+				{
+					void *mapped = ::mmap( 0, _size, PROT_READ, MAP_SHARED, descriptor, 0 );
+					if ( mapped == MAP_FAILED )
+					{
+						::close( descriptor );
+						throw exception( "can't map" ) << path;
+					}
+					_data = static_cast< const char* >( mapped );
+				}
+
+				::close( descriptor );
+#else
+				std::FILE *file = std::fopen( path, "rb" );
+				if ( !file ) throw exception( "can't open" ) << path;
+
+				char block[ 1 << 16 ];
+				for ( size_t count; ( count = std::fread( block, 1, sizeof( block ), file ) ) != 0; )
+				{
+					_copy.insert( _copy.end(), block, block + count );
+				}
+				std::fclose( file );
+
+				_size = _copy.size();
+				_data = _copy.empty() ? 0 : &_copy[ 0 ];
+#endif
+			}
+
+			~mapped_file()
+			{
+#ifndef _MSC_VER
+				if ( _data ) ::munmap( const_cast< char* >( _data ), _size );
+#endif
+			}
+
+			const char* data() const
+			{
+				return _data;
+			}
+
+			size_t size() const
+			{
+				return _size;
+			}
+
+		private:
+
+			mapped_file( const mapped_file& );
+			mapped_file& operator = ( const mapped_file& );
+
+			const char *_data;
+			size_t _size;
+			std::vector< char > _copy;
+	};
+}
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <jsonpp/var.h>
+#include <jsonpp/reader.h>
+#include <jsonpp/parser.h>
+#include <jsonpp/pointer.h>
+
+namespace json
+{
+	/* where a value lies in a file */
+	struct index_entry
+	{
+		index_entry() :
+			offset( 0 ),
+			length( 0 ) { }
+
+		index_entry( unsigned long long o, unsigned long long l ) :
+			offset( o ),
+			length( l ) { }
+
+		unsigned long long offset;
+		unsigned long long length;
+	};
+
+	/*
+	 * finds the extent of values by looking at brackets, braces and quotes
+	 * only. Nothing is decoded or checked, a value is validated once it is
+	 * parsed.
+	 */
+	namespace structural
+	{
+		inline bool space( char c )
+		{
+			return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+		}
+
+		inline const char* skip_space( const char *position, const char *end )
+		{
+			while ( position != end && space( *position ) ) ++position;
+			return position;
+		}
+
+		/* position is at the opening quote, returns the position after the closing one */
+		inline const char* skip_string( const char *position, const char *end )
+		{
+			for ( const char *search = position + 1; ; )
+			{
+				const char *quote = static_cast< const char* >( std::memchr( search, '"', end - search ) );
+				if ( !quote ) throw exception( "input ended inside a string" );
+
+				const char *escapes = quote;
+				while ( escapes - 1 > position && escapes[ -1 ] == '\\' ) --escapes;
+
+				if ( ( quote - escapes ) % 2 == 0 ) return quote + 1;
+
+				search = quote + 1;
+			}
+		}
+
+		/* position is at the first character of a value, returns the position after its last one */
+		inline const char* skip_value( const char *position, const char *end )
+		{
+			switch ( *position )
+			{
+				case '"':
+					return skip_string( position, end );
+				case '[':
+				case '{':
+					break;
+				default:
+					while ( position != end && !space( *position ) && *position != ',' && *position != ']' && *position != '}' ) ++position;
+					return position;
+			}
+
+			size_t depth = 0;
+			while ( position != end )
+			{
+				switch ( *position )
+				{
+					case '"':
+						position = skip_string( position, end );
+						continue;
+					case '[':
+					case '{':
+						++depth;
+						break;
+					case ']':
+					case '}':
+						if ( --depth == 0 ) return position + 1;
+						break;
+				}
+				++position;
+			}
+
+			throw exception( "input ended inside a value" );
+		}
+
+		/* the start of the value pointer points at, 0 when there is none */
+		inline const char* locate( const char *start, const char *end, const std::string &pointer )
+		{
+			const char *position = skip_space( start, end );
+
+			const std::vector< std::string > segments = split_pointer( pointer );
+			for ( std::vector< std::string >::const_iterator segment = segments.begin(); segment != segments.end(); ++segment )
+			{
+				if ( position == end ) return 0;
+
+				const char open = *position;
+				if ( open != '[' && open != '{' ) return 0;
+
+				size_t wanted = 0;
+				if ( open == '[' && !pointer_index( *segment, wanted ) ) return 0;
+
+				position = skip_space( position + 1, end );
+				for ( size_t index = 0; ; ++index )
+				{
+					if ( position == end || *position == ']' || *position == '}' ) return 0;
+
+					if ( open == '{' )
+					{
+						const char *key = position;
+						position = skip_string( key, end );
+
+						/* keys with escapes are rare, the reader decodes those */
+						bool found = false;
+						if ( std::find( key + 1, position - 1, '\\' ) != position - 1 )
+						{
+							basic_reader< char, const char* > reader( key, position );
+							reader.next();
+							found = std::string( reader.value() ) == *segment;
+						}
+						else
+						{
+							found = static_cast< size_t >( position - key - 2 ) == segment->size() && std::equal( segment->begin(), segment->end(), key + 1 );
+						}
+
+						position = skip_space( position, end );
+						if ( position == end || *position != ':' ) throw exception( "expected ':' at offset" ) << position - start;
+						position = skip_space( position + 1, end );
+
+						if ( found ) break;
+					}
+					else if ( index == wanted )
+					{
+						break;
+					}
+
+					position = skip_space( skip_value( position, end ), end );
+					if ( position != end && *position == ',' ) position = skip_space( position + 1, end );
+				}
+			}
+
+			return position == end ? 0 : position;
+		}
+
+		/* the elements of the array at position, offsets relative to start */
+		inline void elements( const char *start, const char *position, const char *end, std::vector< index_entry > &entries )
+		{
+			if ( position == end || *position != '[' ) throw exception( "no array at offset" ) << position - start;
+
+			position = skip_space( position + 1, end );
+			if ( position != end && *position == ']' ) return;
+
+			while ( position != end )
+			{
+				const char *value = position;
+				position = skip_value( value, end );
+				entries.push_back( index_entry( value - start, position - value ) );
+
+				position = skip_space( position, end );
+				if ( position == end ) break;
+				if ( *position == ']' ) return;
+				if ( *position != ',' ) throw exception( "expected ',' at offset" ) << position - start;
+				position = skip_space( position + 1, end );
+			}
+
+			throw exception( "input ended inside the array" );
+		}
+
+		/*
+		 * the non blank lines that start in [ begin, end ) of data, a line that
+		 * starts before begin belongs to the chunk before. Chunks of one file
+		 * can be scanned independently and their entries concatenated in order.
+		 */
+		inline void lines( const char *data, size_t size, size_t begin, size_t end, std::vector< index_entry > &entries )
+		{
+			size_t position = begin;
+
+			if ( position != 0 && position < size && data[ position - 1 ] != '\n' )
+			{
+				const char *newline = static_cast< const char* >( std::memchr( data + position, '\n', size - position ) );
+				position = newline ? newline - data + 1 : size;
+			}
+
+			while ( position < end && position < size )
+			{
+				const char *newline = static_cast< const char* >( std::memchr( data + position, '\n', size - position ) );
+				const size_t stop = newline ? newline - data : size;
+
+				const char *first = skip_space( data + position, data + stop );
+				if ( first != data + stop ) entries.push_back( index_entry( position, stop - position ) );
+
+				position = stop + 1;
+			}
+		}
+	}
+
+	/*
+	 * byte offsets of the elements of one array in a JSON file, or of the
+	 * lines of a newline delimited one, so single elements can be parsed
+	 * straight from a mapped file. A Lines index can be brought up to date
+	 * after the file grew; the line after the last newline is rescanned then,
+	 * it may have been written only partly. Saved as a sidecar file with the
+	 * layout: "JSONPPX1", layout, pointer length, bytes indexed, hash of the
+	 * first bytes of the file, entry count, the pointer padded to 8 bytes and
+	 * an offset and length per entry.
+	 */
+	class offset_index
+	{
+		public:
+
+			enum Layout
+			{
+				Elements,
+				Lines
+			};
+
+			explicit offset_index( Layout layout = Lines, const std::string &pointer = std::string() ) :
+				_layout( layout ),
+				_pointer( pointer ),
+				_indexed( 0 ),
+				_head( 0 ),
+				_entries() { }
+
+			/* the elements of the array that pointer points at in [ data, data + size ) */
+			static offset_index elements( const char *data, size_t size, const std::string &pointer = std::string() )
+			{
+				offset_index result( Elements, pointer );
+
+				const char *array = structural::locate( data, data + size, pointer );
+				if ( !array ) throw exception( "path not found" ) << pointer;
+
+				structural::elements( data, array, data + size, result._entries );
+				result._indexed = size;
+				result._head = head( data, size );
+
+				return result;
+			}
+
+			/* false when data is not the file this index was made for, or one it was appended to */
+			bool matches( const char *data, size_t size ) const
+			{
+				return size >= _indexed && ( _indexed == 0 || head( data, _indexed ) == _head );
+			}
+
+			/* where the scan of an update starts, see structural::lines to split it up */
+			size_t pending() const
+			{
+				return static_cast< size_t >( _indexed );
+			}
+
+			/* indexes what was appended to a Lines file since the last update */
+			void update( const char *data, size_t size )
+			{
+				std::vector< index_entry > found;
+				structural::lines( data, size, pending(), size, found );
+				commit( data, size, found );
+			}
+
+			/* adds the lines found in [ pending(), size ), by one or several structural::lines calls */
+			void commit( const char *data, size_t size, const std::vector< index_entry > &found )
+			{
+				if ( _layout != Lines ) throw exception( "only a Lines index can be updated" );
+				if ( !matches( data, size ) ) throw exception( "index does not belong to this file" );
+
+				while ( !_entries.empty() && _entries.back().offset >= _indexed ) _entries.pop_back();
+				_entries.insert( _entries.end(), found.begin(), found.end() );
+
+				size_t complete = size;
+				while ( complete > _indexed && data[ complete - 1 ] != '\n' ) --complete;
+
+				_indexed = complete;
+				_head = head( data, complete );
+			}
+
+			Layout layout() const
+			{
+				return _layout;
+			}
+
+			const std::string& pointer() const
+			{
+				return _pointer;
+			}
+
+			size_t size() const
+			{
+				return _entries.size();
+			}
+
+			const index_entry& operator[]( size_t index ) const
+			{
+				return _entries.at( index );
+			}
+
+			/* parses element index of data */
+			var element( const char *data, size_t index ) const
+			{
+				const index_entry &entry = operator[]( index );
+				const char *start = data + entry.offset;
+				return basic_parser< CopyOnWrite, char >().parse( start, start + entry.length, parse_options::passthrough() );
+			}
+
+			template < class Sink >
+			void save( Sink &sink ) const
+			{
+				sink.append( magic(), 8 );
+				put( sink, static_cast< unsigned int >( _layout ) );
+				put( sink, static_cast< unsigned int >( _pointer.size() ) );
+				put( sink, _indexed );
+				put( sink, _head );
+				put( sink, static_cast< unsigned long long >( _entries.size() ) );
+
+				sink.append( _pointer.data(), _pointer.size() );
+				for ( size_t i = _pointer.size(); i % 8; ++i ) sink.push_back( 0 );
+
+				for ( std::vector< index_entry >::const_iterator i = _entries.begin(); i != _entries.end(); ++i )
+				{
+					put( sink, i->offset );
+					put( sink, i->length );
+				}
+			}
+
+			static offset_index load( const char *data, size_t size )
+			{
+				const size_t header = 8 + 2 * sizeof( unsigned int ) + 3 * sizeof( unsigned long long );
+				if ( size < header || std::memcmp( data, magic(), 8 ) != 0 ) throw exception( "not a JSON offset index" );
+
+				const char *position = data + 8;
+				const unsigned int layout = get< unsigned int >( position );
+				const unsigned int length = get< unsigned int >( position );
+
+				offset_index result( layout == Lines ? Lines : Elements );
+				result._indexed = get< unsigned long long >( position );
+				result._head = get< unsigned long long >( position );
+				const unsigned long long count = get< unsigned long long >( position );
+
+				const size_t padded = ( length + 7 ) & ~7u;
+				if ( ( size - header ) < padded || ( size - header - padded ) / ( 2 * sizeof( unsigned long long ) ) < count ) throw exception( "JSON offset index is truncated" );
+
+				result._pointer.assign( position, length );
+				position += padded;
+
+				result._entries.resize( static_cast< size_t >( count ) );
+				for ( std::vector< index_entry >::iterator i = result._entries.begin(); i != result._entries.end(); ++i )
+				{
+					i->offset = get< unsigned long long >( position );
+					i->length = get< unsigned long long >( position );
+				}
+
+				return result;
+			}
+
+		private:
+
+			enum
+			{
+				Head = 4096
+			};
+
+			static const char* magic()
+			{
+				return "JSONPPX1";
+			}
+
+			/* 64 bit FNV-1a of the first bytes of data, tells files apart cheaply */
+			static unsigned long long head( const char *data, unsigned long long size )
+			{
+				unsigned long long result = 14695981039346656037ULL;
+				for ( const char *end = data + ( size < Head ? size : static_cast< unsigned long long >( Head ) ); data != end; ++data )
+				{
+					result ^= static_cast< unsigned char >( *data );
+					result *= 1099511628211ULL;
+				}
+				return result;
+			}
+
+			template < class Sink, class T >
+			static void put( Sink &sink, T value )
+			{
+				sink.append( reinterpret_cast< const char* >( &value ), sizeof( value ) );
+			}
+
+			template < class T >
+			static T get( const char *&position )
+			{
+				T result;
+				std::memcpy( &result, position, sizeof( result ) );
+				position += sizeof( result );
+				return result;
+			}
+
+			Layout _layout;
+			std::string _pointer;
+			unsigned long long _indexed;
+			unsigned long long _head;
+			std::vector< index_entry > _entries;
+	};
+}
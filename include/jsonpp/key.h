@@ -0,0 +1,408 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <functional>
+#else
+#include <tr1/functional>
+#endif
+
+namespace json
+{
+	inline long atomic_increment( volatile long *value )
+	{
+#ifdef _MSC_VER
+		return _InterlockedIncrement( value );
+#else
+		return __sync_add_and_fetch( value, 1 );
+#endif
+	}
+
+	inline long atomic_decrement( volatile long *value )
+	{
+#ifdef _MSC_VER
+		return _InterlockedDecrement( value );
+#else
+		return __sync_sub_and_fetch( value, 1 );
+#endif
+	}
+
+	/* reads a pointer that another thread may publish with atomic_publish */
+	template < class P >
+	inline P* atomic_load( P *const volatile *slot )
+	{
+#if defined( _MSC_VER )
+		return *slot;
+#elif defined( __ATOMIC_ACQUIRE )
+		return __atomic_load_n( slot, __ATOMIC_ACQUIRE );
+#else
+		P *result = *slot;
+		__sync_synchronize();
+		return result;
+#endif
+	}
+
+	inline long atomic_load( const volatile long *value )
+	{
+#if defined( _MSC_VER )
+		return *value;
+#elif defined( __ATOMIC_ACQUIRE )
+		return __atomic_load_n( value, __ATOMIC_ACQUIRE );
+#else
+		const long result = *value;
+		__sync_synchronize();
+		return result;
+#endif
+	}
+
+	/* stores value in an empty slot, false when another thread filled it first */
+	template < class P >
+	inline bool atomic_publish( P *volatile *slot, P *value )
+	{
+#ifdef _MSC_VER
+		return _InterlockedCompareExchangePointer( reinterpret_cast< void *volatile* >( slot ), value, 0 ) == 0;
+#else
+		return __sync_bool_compare_and_swap( slot, static_cast< P* >( 0 ), value );
+#endif
+	}
+
+	inline bool atomic_publish( volatile long *slot, long value )
+	{
+#ifdef _MSC_VER
+		return _InterlockedCompareExchange( slot, value, 0 ) == 0;
+#else
+		return __sync_bool_compare_and_swap( slot, 0L, value );
+#endif
+	}
+
+	/* takes lock without waiting for it, false when another thread holds it */
+	inline bool atomic_try_lock( volatile long *lock )
+	{
+#ifdef _MSC_VER
+		return _InterlockedExchange( lock, 1 ) == 0;
+#else
+		return __sync_lock_test_and_set( lock, 1L ) == 0;
+#endif
+	}
+
+	inline void atomic_unlock( volatile long *lock )
+	{
+#ifdef _MSC_VER
+		_InterlockedExchange( lock, 0 );
+#else
+		__sync_lock_release( lock );
+#endif
+	}
+
+	/*
+	 * immutable object key in two pointers worth of memory. Keys shorter than
+	 * Slots characters are stored inline and compared as a block of bytes;
+	 * longer keys live in a reference counted block, so a string_table can
+	 * hand out the same block for every occurrence of a key and those copies
+	 * compare equal by pointer.
+	 */
+	template < class Char >
+	class basic_key
+	{
+		public:
+
+			typedef std::basic_string< Char > string_type;
+
+			enum
+			{
+				Slots = 2 * sizeof( void* ) / sizeof( Char ),
+				Shared = Slots
+			};
+
+			basic_key()
+			{
+				std::memset( _characters, 0, sizeof( _characters ) );
+			}
+
+			basic_key( const string_type &string )
+			{
+				assign( string.data(), string.size() );
+			}
+
+			basic_key( const Char *start, size_t length )
+			{
+				assign( start, length );
+			}
+
+			basic_key( const basic_key &rhs )
+			{
+				std::memcpy( _characters, rhs._characters, sizeof( _characters ) );
+				if ( shared() ) atomic_increment( &block()->references );
+			}
+
+			~basic_key()
+			{
+				release();
+			}
+
+			basic_key& operator = ( const basic_key &rhs )
+			{
+				if ( this != &rhs )
+				{
+					if ( rhs.shared() ) atomic_increment( &rhs.block()->references );
+					release();
+					std::memcpy( _characters, rhs._characters, sizeof( _characters ) );
+				}
+
+				return *this;
+			}
+
+			size_t size() const
+			{
+				return shared() ? block()->string.size() : static_cast< size_t >( _characters[ Slots - 1 ] );
+			}
+
+			bool empty() const
+			{
+				return size() == 0;
+			}
+
+			const Char* data() const
+			{
+				return shared() ? block()->string.data() : _characters;
+			}
+
+			const Char* begin() const
+			{
+				return data();
+			}
+
+			const Char* end() const
+			{
+				return data() + size();
+			}
+
+			string_type str() const
+			{
+				return string_type( data(), size() );
+			}
+
+			operator string_type() const
+			{
+				return str();
+			}
+
+			size_t hash() const
+			{
+				return shared() ? block()->hash : hash_characters( _characters, size() );
+			}
+
+			bool operator == ( const basic_key &rhs ) const
+			{
+				if ( !shared() || !rhs.shared() ) return std::memcmp( _characters, rhs._characters, sizeof( _characters ) ) == 0;
+
+				const block_type *a = block(), *b = rhs.block();
+
+				return a == b || ( a->hash == b->hash && a->string == b->string );
+			}
+
+			bool operator == ( const string_type &rhs ) const
+			{
+				return size() == rhs.size() && std::equal( begin(), end(), rhs.begin() );
+			}
+
+			bool operator != ( const basic_key &rhs ) const
+			{
+				return !operator == ( rhs );
+			}
+
+			bool operator != ( const string_type &rhs ) const
+			{
+				return !operator == ( rhs );
+			}
+
+			bool operator < ( const basic_key &rhs ) const
+			{
+				return std::lexicographical_compare( begin(), end(), rhs.begin(), rhs.end() );
+			}
+
+			static size_t hash_characters( const Char *start, size_t length )
+			{
+				size_t result = 2166136261u;
+				for ( const Char *end = start + length; start != end; ++start )
+				{
+					result ^= static_cast< size_t >( *start );
+					result *= 16777619u;
+				}
+				return result;
+			}
+
+		private:
+
+			struct block_type
+			{
+				block_type( const Char *start, size_t length ) :
+					references( 1 ),
+					hash( hash_characters( start, length ) ),
+					string( start, length ) { }
+
+				volatile long references;
+				size_t hash;
+				string_type string;
+			};
+
+			bool shared() const
+			{
+				return static_cast< size_t >( _characters[ Slots - 1 ] ) == Shared;
+			}
+
+			block_type* block() const
+			{
+				block_type *result;
+				std::memcpy( &result, _characters, sizeof( result ) );
+				return result;
+			}
+
+			void assign( const Char *start, size_t length )
+			{
+				std::memset( _characters, 0, sizeof( _characters ) );
+
+				if ( length < Slots )
+				{
+					std::copy( start, start + length, _characters );
+					_characters[ Slots - 1 ] = static_cast< Char >( length );
+				}
+				else
+				{
+					block_type *shared = new block_type( start, length );
+					std::memcpy( _characters, &shared, sizeof( shared ) );
+					_characters[ Slots - 1 ] = static_cast< Char >( Shared );
+				}
+			}
+
+			void release()
+			{
+				if ( shared() && atomic_decrement( &block()->references ) == 0 ) delete block();
+			}
+
+			Char _characters[ Slots ];
+	};
+
+	/*
+	 * hands out one shared basic_key per distinct long key, short keys are
+	 * stored inline anyway. Once capacity distinct keys are known new keys are
+	 * no longer remembered, which bounds the memory a hostile document can pin.
+	 */
+	template < class Char >
+	class string_table
+	{
+		public:
+
+			typedef basic_key< Char > key_type;
+
+			explicit string_table( size_t capacity = 65536 ) :
+				_entries(),
+				_count( 0 ),
+				_capacity( capacity ) { }
+
+			key_type intern( const Char *start, size_t length )
+			{
+				if ( length < key_type::Slots ) return key_type( start, length );
+
+				const size_t hash = key_type::hash_characters( start, length );
+
+				if ( !_entries.empty() )
+				{
+					const size_t mask = _entries.size() - 1;
+					for ( size_t i = hash & mask; !_entries[ i ].empty(); i = ( i + 1 ) & mask )
+					{
+						const key_type &entry = _entries[ i ];
+						if ( entry.hash() == hash && entry.size() == length && std::equal( start, start + length, entry.data() ) ) return entry;
+					}
+				}
+
+				const key_type key( start, length );
+
+				if ( _count < _capacity )
+				{
+					if ( ( _count + 1 ) * 2 > _entries.size() ) grow();
+					insert( key );
+					++_count;
+				}
+
+				return key;
+			}
+
+			key_type intern( const std::basic_string< Char > &string )
+			{
+				return intern( string.data(), string.size() );
+			}
+
+			template < class I >
+			key_type intern( const I &start, const I &end )
+			{
+				return start == end ? key_type() : intern( &*start, end - start );
+			}
+
+			size_t size() const
+			{
+				return _count;
+			}
+
+			void clear()
+			{
+				_entries.clear();
+				_count = 0;
+			}
+
+		private:
+
+			void insert( const key_type &key )
+			{
+				const size_t mask = _entries.size() - 1;
+				size_t i = key.hash() & mask;
+				while ( !_entries[ i ].empty() ) i = ( i + 1 ) & mask;
+				_entries[ i ] = key;
+			}
+
+			void grow()
+			{
+				std::vector< key_type > entries( _entries.empty() ? 64 : _entries.size() * 2 );
+				entries.swap( _entries );
+
+				for ( typename std::vector< key_type >::const_iterator i = entries.begin(); i != entries.end(); ++i )
+				{
+					if ( !i->empty() ) insert( *i );
+				}
+			}
+
+			std::vector< key_type > _entries;
+			size_t _count, _capacity;
+	};
+}
+
+namespace std
+{
+	namespace tr1
+	{
+		template < class Char >
+		struct hash< json::basic_key< Char > >
+		{
+			size_t operator()( const json::basic_key< Char > &key ) const
+			{
+				return key.hash();
+			}
+		};
+	}
+
+#if __cplusplus >= 201103L
+	template < class Char >
+	struct hash< json::basic_key< Char > >
+	{
+		size_t operator()( const json::basic_key< Char > &key ) const
+		{
+			return key.hash();
+		}
+	};
+#endif
+}
@@ -3,6 +3,14 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <limits>
+#include <cstdlib>
+#ifdef _MSC_VER
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
 
 namespace json
 {
@@ -46,9 +54,22 @@ namespace json
 		Compact = 1 << 0,
 		HumanReadable = 1 << 1,
 		CountArrayValues = 1 << 2,
-		IndentFirstItem = 1 << 3
+		IndentFirstItem = 1 << 3,
+		/* keep the text of every container written and reuse it until it changes, see basic_var::write */
+		Cached = 1 << 4
+	};
+
+	enum Equality
+	{
+		OrderedKeys,
+		UnorderedKeys
 	};
 
+	inline size_t hash_combine( size_t seed, size_t value )
+	{
+		return seed ^ ( value + 0x9e3779b9 + ( seed << 6 ) + ( seed >> 2 ) );
+	}
+
 	template < class Char >
 	std::basic_string< Char > convert_string( const std::string &string )
 	{
@@ -66,6 +87,8 @@ namespace json
 
 		explicit key_value( const Key &k ) : key( k ), value() { }
 
+		key_value( const key_value &rhs ) : key( rhs.key ), value( rhs.value ) { }
+
 		key_value& operator = ( const key_value &rhs )
 		{
 			const_cast< Key& >( key ) = rhs.key;
@@ -73,7 +96,9 @@ namespace json
 			return *this;
 		}
 
-		bool operator == ( const Key &k ) const
+		/* templated so looking up a plain string doesn't build a Key first */
+		template < class K >
+		bool operator == ( const K &k ) const
 		{
 			return key == k;
 		}
@@ -112,7 +137,7 @@ namespace json
 					++i;
 				}
 
-				return true;
+				return !*str && i == end();
 			}
 
 			operator std::basic_string< T >() const
@@ -182,6 +207,20 @@ namespace json
 				return _p == _buffer.begin();
 			}
 
+			size_t size() const
+			{
+				return _p - _buffer.begin();
+			}
+
+			/* exchanges contents and storage, so a long lived owner can lend its capacity out */
+			void swap( Buffer &rhs )
+			{
+				const size_t used = size(), rhs_used = rhs.size();
+				_buffer.swap( rhs._buffer );
+				_p = _buffer.begin() + rhs_used;
+				rhs._p = rhs._buffer.begin() + used;
+			}
+
 		private:
 
 			std::vector< T > _buffer;
@@ -207,12 +246,71 @@ namespace json
 	}
 
 	template <>
-	inline long double dec_string_to_number< Buffer< char >, long double >( Buffer< char >::const_iterator start, const Buffer< char >::const_iterator & )
+	inline long double dec_string_to_number< Buffer< char >, long double >( Buffer< char >::const_iterator start, const Buffer< char >::const_iterator &end )
 	{
-		return strtold( &start[ 0 ], 0 );
+		const std::string terminated( start, end );
+		return strtold( terminated.c_str(), 0 );
 	}
 #endif
 
+	template < class Char >
+	std::basic_string< Char > number_to_string( long double number )
+	{
+		std::basic_stringstream< Char > stream;
+		stream.precision( std::numeric_limits< long double >::digits10 );
+		stream << number;
+		return stream.str();
+	}
+
+	/* digits of magnitude, most significant first, after an optional '-' */
+	template < class Char >
+	std::basic_string< Char > integer_to_string( unsigned long long magnitude, bool negative )
+	{
+		Char buffer[ 24 ];
+		Char *p = buffer + sizeof( buffer ) / sizeof( Char );
+
+		do
+		{
+			*--p = static_cast< Char >( '0' + magnitude % 10 );
+			magnitude /= 10;
+		}
+		while ( magnitude );
+
+		if ( negative ) *--p = '-';
+
+		return std::basic_string< Char >( p, buffer + sizeof( buffer ) / sizeof( Char ) );
+	}
+
+	/* accepts -?[0-9]+ only, false when the magnitude does not fit 64 bits */
+	template < class I >
+	bool parse_integer( I start, const I &end, bool &negative, unsigned long long &magnitude )
+	{
+		negative = start != end && *start == '-';
+		if ( negative ) ++start;
+		if ( start == end ) return false;
+
+		magnitude = 0;
+		for ( ; start != end; ++start )
+		{
+			if ( *start < '0' || *start > '9' ) return false;
+
+			const unsigned int digit = *start - '0';
+			if ( magnitude > ( ~0ULL - digit ) / 10 ) return false;
+			magnitude = magnitude * 10 + digit;
+		}
+
+		return true;
+	}
+
+	/* -magnitude as a long long, false when it does not fit and for -0, which only a floating point number keeps */
+	inline bool negate_integer( unsigned long long magnitude, long long &result )
+	{
+		if ( magnitude == 0 || magnitude - 1 > static_cast< unsigned long long >( std::numeric_limits< long long >::max() ) ) return false;
+
+		result = -static_cast< long long >( magnitude - 1 ) - 1;
+		return true;
+	}
+
 	template < class Q, class Number >
 	Number hex_string_to_number( typename Q::const_iterator start, const typename Q::const_iterator &end )
 	{
@@ -244,6 +342,7 @@ namespace json
 
 			T* operator ->()
 			{
+				_t.invalidate();
 				return &_t;
 			}
 
@@ -252,6 +351,11 @@ namespace json
 				return &_t;
 			}
 
+			bool unique() const
+			{
+				return true;
+			}
+
 		private:
 
 			T _t;
@@ -271,6 +375,7 @@ namespace json
 				{
 					_t = std::tr1::shared_ptr< T >( new T( *_t.get() ) );
 				}
+				_t->invalidate();
 				return _t.get();
 			}
 
@@ -279,6 +384,12 @@ namespace json
 				return _t.get();
 			}
 
+			/* true when no other var shares the data */
+			bool unique() const
+			{
+				return _t.unique();
+			}
+
 		private:
 
 			std::tr1::shared_ptr< T > _t;
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <exception>
+#ifndef _MSC_VER
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <jsonpp/var.h>
+#include <jsonpp/sink.h>
+
+namespace json
+{
+	/*
+	 * writes a large document on several threads. The containers near the
+	 * root are cut into runs of elements, see basic_var::write_elements, a
+	 * pool of threads takes the next run whenever it finished one and writes
+	 * it into a buffer of its own, and the buffers go to the sink in order.
+	 * The text is the one write() gives for every Markup, Cached is ignored
+	 * here since threads would share the forms of shared containers. A
+	 * document of fewer than threshold values is handed to write() as is.
+	 * Don't change the document while it is being written.
+	 */
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_parallel_writer
+	{
+		public:
+
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			typedef std::basic_string< Char > string_type;
+
+			/* threads 0 uses one per processor */
+			explicit basic_parallel_writer( unsigned int threads = 0, size_t threshold = 1 << 16 ) :
+				_threads( threads ? threads : processors() ),
+				_threshold( threshold ) { }
+
+			template < class Sink >
+			void write( const var_type &value, Sink &sink, unsigned int markup = Compact, unsigned int level = 0 ) const
+			{
+				if ( _threads < 2 || !value.cacheable() || values( value ) < _threshold )
+				{
+					value.write( sink, markup, level );
+					return;
+				}
+
+				std::vector< part > parts;
+				std::vector< run > runs;
+				plan( value, markup, level, parts, runs );
+
+				work( runs, markup & ~( Cached | IndentFirstItem ) );
+
+				for ( typename std::vector< part >::iterator i = parts.begin(); i != parts.end(); ++i )
+				{
+					sink.append( i->text.data(), i->text.size() );
+					if ( i->run == part::None ) continue;
+
+					run &done = runs[ i->run ];
+					if ( !done.error.empty() ) throw exception( done.error );
+
+					sink.append( done.text.data(), done.text.size() );
+					string_type().swap( done.text );
+				}
+			}
+
+			string_type serialize( const var_type &value, unsigned int markup = Compact, unsigned int level = 0 ) const
+			{
+				string_type result;
+				string_sink< string_type > sink( result );
+				write( value, sink, markup, level );
+				return result;
+			}
+
+			unsigned int threads() const
+			{
+				return _threads;
+			}
+
+			static unsigned int processors()
+			{
+#ifndef _MSC_VER
+				const long count = sysconf( _SC_NPROCESSORS_ONLN );
+				return count > 0 ? static_cast< unsigned int >( count ) : 1;
+#else
+				return 1;
+#endif
+			}
+
+		private:
+
+			enum
+			{
+				/* runs per thread a container is cut into, more even out runs of different length */
+				RunsPerThread = 4,
+				/* how many levels of small containers are looked into for large ones */
+				Descent = 4
+			};
+
+			/* elements [ first, last ) of node, written by a thread */
+			struct run
+			{
+				run( const var_type &n, size_t f, size_t l, unsigned int d ) :
+					node( &n ),
+					first( f ),
+					last( l ),
+					level( d ),
+					text(),
+					error() { }
+
+				run( const run &rhs ) :
+					node( rhs.node ),
+					first( rhs.first ),
+					last( rhs.last ),
+					level( rhs.level ),
+					text( rhs.text ),
+					error( rhs.error ) { }
+
+				run& operator = ( const run &rhs )
+				{
+					node = rhs.node;
+					first = rhs.first;
+					last = rhs.last;
+					level = rhs.level;
+					text = rhs.text;
+					error = rhs.error;
+					return *this;
+				}
+
+				const var_type *node;
+				size_t first, last;
+				unsigned int level;
+				string_type text;
+				std::string error;
+			};
+
+			/* text written while planning, followed by a run or not */
+			struct part
+			{
+				static const size_t None = ~static_cast< size_t >( 0 );
+
+				part() :
+					text(),
+					run( None ) { }
+
+				string_type text;
+				size_t run;
+			};
+
+			/* a container being planned and its next element */
+			struct frame
+			{
+				explicit frame( const var_type &n ) :
+					node( &n ),
+					index( 0 ) { }
+
+				const var_type *node;
+				size_t index;
+			};
+
+			/* what the threads share */
+			struct pool
+			{
+				pool( std::vector< run > &r, unsigned int m ) :
+					runs( r ),
+					markup( m ),
+#ifndef _MSC_VER
+					lock(),
+#endif
+					next( 0 ) { }
+
+				std::vector< run > &runs;
+				unsigned int markup;
+#ifndef _MSC_VER
+				pthread_mutex_t lock;
+#endif
+				size_t next;
+			};
+
+			/* the number of values in value, counted up to the threshold */
+			size_t values( const var_type &value ) const
+			{
+				size_t result = 0;
+				std::vector< const var_type* > pending( 1, &value );
+
+				while ( !pending.empty() && result < _threshold )
+				{
+					const var_type &next = *pending.back();
+					pending.pop_back();
+
+					++result;
+					if ( ( next.type != Array && next.type != Object ) || next._data->_fragment ) continue;
+
+					result += next._data->size();
+					if ( !next.cacheable() ) continue;
+
+					const typename var_type::array_type &elements = next.elements();
+					for ( typename var_type::array_type::const_iterator i = elements.begin(); i != elements.end() && result < _threshold; ++i ) pending.push_back( &i->value );
+				}
+
+				return result;
+			}
+
+			/*
+			 * writes what lies outside the runs into parts, the way write()
+			 * would. Containers with enough elements are cut into runs, smaller
+			 * ones are looked into for large ones a few levels deep and become
+			 * a single run below that.
+			 */
+			void plan( const var_type &root, unsigned int markup, unsigned int level, std::vector< part > &parts, std::vector< run > &runs ) const
+			{
+				const bool human = ( markup & HumanReadable ) != 0, count = human && ( markup & CountArrayValues );
+
+				string_type text;
+				string_sink< string_type > sink( text );
+
+				if ( human && markup & IndentFirstItem ) var_type::indent( sink, level );
+				markup &= ~( Cached | IndentFirstItem );
+
+				std::vector< frame > frames;
+
+				for ( const var_type *value = &root; ; )
+				{
+					while ( !value && !frames.empty() )
+					{
+						frame &current = frames.back();
+						const unsigned int depth = level + static_cast< unsigned int >( frames.size() );
+						const typename var_type::array_type &elements = current.node->elements();
+
+						if ( current.index == elements.size() )
+						{
+							if ( human ) var_type::newline( sink, depth - 1 );
+							sink.push_back( current.node->type == Array ? ']' : '}' );
+							frames.pop_back();
+							continue;
+						}
+
+						const size_t index = current.index++;
+
+						if ( index ) sink.push_back( ',' );
+						if ( human ) var_type::newline( sink, depth );
+
+						if ( current.node->type != Array ) var_type::write_key( sink, elements[ index ].key );
+						else if ( count ) var_type::append( var_type::append( sink, integer_to_string< Char >( index, false ) ), convert_string< Char >( " => " ) );
+
+						value = &elements[ index ].value;
+					}
+
+					if ( !value ) break;
+
+					const unsigned int depth = level + static_cast< unsigned int >( frames.size() );
+					const bool container = ( value->type == Array || value->type == Object ) && !value->_data->_fragment;
+					const size_t size = container ? value->_data->size() : 0;
+
+					if ( size >= 2 * _threads || ( size && value->cacheable() && frames.size() >= Descent ) )
+					{
+						const size_t cuts = size >= 2 * _threads ? std::min( size, static_cast< size_t >( RunsPerThread ) * _threads ) : 1;
+
+						sink.push_back( value->type == Array ? '[' : '{' );
+						for ( size_t i = 0; i < cuts; ++i )
+						{
+							parts.push_back( part() );
+							parts.back().text.swap( text );
+							parts.back().run = runs.size();
+							runs.push_back( run( *value, size * i / cuts, size * ( i + 1 ) / cuts, depth ) );
+						}
+						if ( human ) var_type::newline( sink, depth );
+						sink.push_back( value->type == Array ? ']' : '}' );
+					}
+					else if ( size && value->cacheable() )
+					{
+						sink.push_back( value->type == Array ? '[' : '{' );
+						frames.push_back( frame( *value ) );
+					}
+					else
+					{
+						value->write( sink, markup, depth );
+					}
+
+					value = 0;
+				}
+
+				parts.push_back( part() );
+				parts.back().text.swap( text );
+			}
+
+			/* writes the runs, on the calling thread and threads - 1 more */
+			void work( std::vector< run > &runs, unsigned int markup ) const
+			{
+				pool shared( runs, markup );
+
+#ifndef _MSC_VER
+				pthread_mutex_init( &shared.lock, 0 );
+
+				std::vector< pthread_t > running;
+				for ( unsigned int i = 1; i < _threads && i < runs.size(); ++i )
+				{
+					pthread_t thread;
+					if ( pthread_create( &thread, 0, take, &shared ) != 0 ) break;
+					running.push_back( thread );
+				}
+
+				take( &shared );
+
+				for ( std::vector< pthread_t >::const_iterator i = running.begin(); i != running.end(); ++i ) pthread_join( *i, 0 );
+				pthread_mutex_destroy( &shared.lock );
+#else
+				take( &shared );
+#endif
+			}
+
+			/* writes the next run that nobody took yet until none are left */
+			static void* take( void *argument )
+			{
+				pool &shared = *static_cast< pool* >( argument );
+
+				for ( ;; )
+				{
+#ifndef _MSC_VER
+					pthread_mutex_lock( &shared.lock );
+					const size_t next = shared.next++;
+					pthread_mutex_unlock( &shared.lock );
+#else
+					const size_t next = shared.next++;
+#endif
+					if ( next >= shared.runs.size() ) return 0;
+
+					run &current = shared.runs[ next ];
+
+					try
+					{
+						string_sink< string_type > sink( current.text );
+						current.node->write_elements( sink, current.first, current.last, shared.markup, current.level );
+					}
+					catch ( const std::exception &e )
+					{
+						current.error = e.what();
+					}
+				}
+			}
+
+			unsigned int _threads;
+			size_t _threshold;
+	};
+
+	typedef basic_parallel_writer< CopyOnWrite, char > parallel_writer;
+	typedef basic_parallel_writer< CopyOnWrite, wchar_t > wparallel_writer;
+}
@@ -3,10 +3,10 @@
 #include <string>
 #include <cstdlib>
 #include <iterator>
-#include <cstdlib>
-#include <iterator>
 
 #include <jsonpp/var.h>
+#include <jsonpp/reader.h>
+#include <jsonpp/pointer.h>
 
 namespace json
 {
@@ -17,6 +17,7 @@ namespace json
 			NextCharacter,
 			UnquotedString,
 			SingleQuotedString,
+			CompleteArray,
 			EventCount
 		};
 
@@ -30,6 +31,8 @@ namespace json
 					return stream << "UnquotedString";
 				case SingleQuotedString:
 					return stream << "SingleQuotedString";
+				case CompleteArray:
+					return stream << "CompleteArray";
 				default:
 					return stream << "unknown event";
 			}
@@ -45,17 +48,50 @@ namespace json
 			return value;
 		}
 
+		struct passthrough
+		{
+			template < class T >
+			const T& operator()( Events, const T &value ) const
+			{
+				return value;
+			}
+		};
+
+		/* stores every array of identically shaped objects column wise */
+		struct columns
+		{
+			template < class T >
+			const T& operator()( Events, const T &value ) const
+			{
+				return value;
+			}
+
+			template < template< class > class CopyBehaviour, class Char >
+			basic_var< CopyBehaviour, Char > operator()( Events event, const basic_var< CopyBehaviour, Char > &value ) const
+			{
+				basic_var< CopyBehaviour, Char > result( value );
+				if ( event == CompleteArray ) result.to_columns();
+				return result;
+			}
+		};
+
+		/* refuses the relaxed grammar: throws on unquoted and single quoted strings */
 		inline var strict( Events event, const var &value )
 		{
-			if ( event != NextCharacter )
+			if ( event == UnquotedString || event == SingleQuotedString )
 			{
-				std::cout << event << ':' << value <<  std::endl;
-				return var( "error" );
+				throw exception( "strict parsing refuses" ) << event << value;
 			}
 			return value;
 		}
 	}
 
+	/*
+	 * builds a basic_var from text. A parser can be kept and reused: parse_into
+	 * overwrites a document in place, reusing its nodes, strings and element
+	 * lists wherever the new document has the same shape, and the parser keeps
+	 * its scratch buffers, its stack and its interned keys between documents.
+	 */
 	template < template< class > class CopyBehaviour, class Char >
 	class basic_parser
 	{
@@ -63,394 +99,583 @@ namespace json
 
 			typedef std::basic_string< Char > string_type;
 
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			basic_parser() :
+				_raw_numbers( false ),
+				_limits(),
+				_keys(),
+				_strings(),
+				_frames(),
+				_value(),
+				_whitespace(),
+				_member( 0 ),
+				_captures(),
+				_path(),
+				_segment(),
+				_characters( 0 ),
+				_character( '*' ),
+				_result() { }
+
 			template < class Options >
 			basic_parser( const Char str[], Options options = parse_options::standard ) :
-				_string_value_buffer(),
-				_string_value_whitespace_buffer(),
-				_handle_escape_buffer(),
-				_result( parse( str, str + strlen( str ), options ) ) { }
+				_raw_numbers( false ),
+				_limits(),
+				_keys(),
+				_strings(),
+				_frames(),
+				_value(),
+				_whitespace(),
+				_member( 0 ),
+				_captures(),
+				_path(),
+				_segment(),
+				_characters( 0 ),
+				_character( '*' ),
+				_result( parse( str, str + std::char_traits< Char >::length( str ), options ) ) { }
 
 			template < class Options >
 			basic_parser( const string_type &string, Options options = parse_options::standard ) :
-				_string_value_buffer(),
-				_string_value_whitespace_buffer(),
-				_handle_escape_buffer(),
+				_raw_numbers( false ),
+				_limits(),
+				_keys(),
+				_strings(),
+				_frames(),
+				_value(),
+				_whitespace(),
+				_member( 0 ),
+				_captures(),
+				_path(),
+				_segment(),
+				_characters( 0 ),
+				_character( '*' ),
 				_result( parse( string.begin(), string.end(), options ) ) { }
 
 			template < class Options >
 			basic_parser( std::basic_istream< Char > &stream, Options options = parse_options::standard ) :
-				_string_value_buffer(),
-				_string_value_whitespace_buffer(),
-				_handle_escape_buffer(),
+				_raw_numbers( false ),
+				_limits(),
+				_keys(),
+				_strings(),
+				_frames(),
+				_value(),
+				_whitespace(),
+				_member( 0 ),
+				_captures(),
+				_path(),
+				_segment(),
+				_characters( 0 ),
+				_character( '*' ),
 				_result( parse( std::istream_iterator< Char >( stream ), std::istream_iterator< Char >(), options ) ) { }
 
-			operator const basic_var< CopyBehaviour, Char >&() const { return _result; }
+			operator const var_type&() const { return _result; }
+
+			/* keep numbers as their source text, see basic_var::raw_number */
+			void raw_numbers( bool keep )
+			{
+				_raw_numbers = keep;
+			}
+
+			/*
+			 * the containers at pointer are not built but kept as compact JSON text,
+			 * see basic_var::raw_fragment: for sub documents that are passed on
+			 * rather than read
+			 */
+			void capture( const string_type &pointer )
+			{
+				_captures.push_back( split_pointer( pointer ) );
+			}
+
+			/* bounds for what parse accepts, exceeding one throws limit_error */
+			void limits( const parse_limits &limits )
+			{
+				_limits = limits;
+			}
 
 			template < class I, class Options >
-			basic_var< CopyBehaviour, Char > parse( I start, const I &end, Options options )
+			var_type parse( I start, const I &end, Options options )
 			{
-				std::vector< basic_var< CopyBehaviour, Char >* > destinations;
+				var_type result;
+				parse_into( result, start, end, options );
+				return result;
+			}
 
-				basic_var< CopyBehaviour, Char > root( Undefined );
-				destinations.push_back( &root );
+			/* replaces document with the value in [ start, end ), see the class comment */
+			template < class I, class Options >
+			void parse_into( var_type &document, I start, const I &end, Options options )
+			{
+				basic_reader< Char, I > reader( start, end, _limits );
+				reader.swap_buffers( _value, _whitespace );
 
-				while ( start != end )
+				try
 				{
-					switch ( *start )
-					{
-						case '{': // start object
-							add_item( destinations, basic_var< CopyBehaviour, Char >( Object ) );
-							increment( start, options );
-							break;
-						case '[': // add array
-							add_item( destinations, basic_var< CopyBehaviour, Char >( Array ) );
-							increment( start, options );
-							break;
-						case '}': // close object
-						case ']': // close array
-							if ( destinations.empty() ) throw "empty array";
-							destinations.pop_back();
-							increment( start, options );
-							break;
-						case ':': // add property
-						case ',': // add destination
-							increment( start, options );
-							break;
-						case ' ': case '\t': case '\r': case '\n':
-							increment( start, options );
-							break;
-						case '"': // handle string
-							start = string_value< '"' >( destinations, increment( start, options ), end, options );
-							break;
-						case '\'': // handle string
-							start = string_value< '\'' >( destinations, increment( start, options ), end, options );
+					reader.next();
+					read_into( document, reader, options );
+				}
+				catch ( ... )
+				{
+					reader.swap_buffers( _value, _whitespace );
+					throw;
+				}
+
+				reader.swap_buffers( _value, _whitespace );
+			}
+
+			template < class I >
+			void parse_into( var_type &document, I start, const I &end )
+			{
+				parse_into( document, start, end, parse_options::passthrough() );
+			}
+
+			void parse_into( var_type &document, const string_type &string )
+			{
+				parse_into( document, string.begin(), string.end(), parse_options::passthrough() );
+			}
+
+			/* build the value that starts at the current token of reader */
+			template < class I, class Options >
+			var_type read( basic_reader< Char, I > &reader, Options options )
+			{
+				var_type result;
+				read_into( result, reader, options );
+				return result;
+			}
+
+			/* overwrite document with the value that starts at the current token of reader */
+			template < class I, class Options >
+			void read_into( var_type &document, basic_reader< Char, I > &reader, Options options )
+			{
+				begin( document );
+				for ( tokens::Token token = reader.token(); !consume( document, reader, token, options ); token = reader.next() ) { }
+			}
+
+			/* the next tokens given to consume overwrite document */
+			void begin( var_type &document )
+			{
+				_frames.clear();
+				_path.clear();
+				_member = &document;
+				_characters = 0;
+			}
+
+			/*
+			 * builds token, the current token of reader, into the document given
+			 * to begin, true once the document is complete. For callers that
+			 * pull the tokens themselves, see async.h.
+			 */
+			template < class I, class Options >
+			bool consume( var_type &document, basic_reader< Char, I > &reader, tokens::Token token, Options options )
+			{
+				/* one NextCharacter event for every character the reader went through */
+				for ( ; _characters < reader.offset(); ++_characters ) options( parse_options::NextCharacter, _character );
+
+				switch ( token )
+				{
+					case tokens::End:
+						if ( _member == &document ) document.clear();
+						while ( !_frames.empty() ) close( options );
+						_member = 0;
+						return true;
+					case tokens::BeginObject:
+					case tokens::BeginArray:
+						if ( !_captures.empty() && captured() )
+						{
+							put( var_type::raw_fragment( fragment( reader ) ) );
 							break;
-						default: // handle string/number/literal
-							start = string_or_number_value( destinations, start, end, options );
+						}
+						open( token == tokens::BeginObject ? Object : Array );
+						break;
+					case tokens::EndObject:
+					case tokens::EndArray:
+						close( options );
+						break;
+					case tokens::Key:
+						if ( !_captures.empty() ) _segment = reader.string();
+
+						if ( reader.quote() == '"' && !_member && !_frames.empty() && _frames.back().node->type == Object )
+						{
+							member( _keys.intern( reader.value().begin(), reader.value().end() ) );
 							break;
-					}
+						}
+						/* falls through */
+					case tokens::String:
+						switch ( reader.quote() )
+						{
+							case '\'':
+								put( options( parse_options::SingleQuotedString, reader.value() ) );
+								break;
+							case 0:
+								put( options( parse_options::UnquotedString, reader.value() ) );
+								break;
+							default:
+								put_string( reader.value() );
+								break;
+						}
+						break;
+					case tokens::Number:
+						put_number( reader );
+						break;
+					case tokens::True:
+						put_scalar( true );
+						break;
+					case tokens::False:
+						put_scalar( false );
+						break;
+					case tokens::Null:
+						if ( var_type *target = slot() )
+						{
+							target->reset( Null );
+						}
+						else
+						{
+							_frames.back().node->push( var_type( Null ) );
+						}
+						break;
+					case tokens::TokenCount:
+						break;
 				}
 
-				return root;
+				return _frames.empty() && !_member;
 			}
 
 		private:
 
-			template < Char EndChar, class I, class Options >
-			I string_value( std::vector< basic_var< CopyBehaviour, Char >* > &destination, const I &start, const I &end, Options options )
+			basic_parser( const basic_parser& );
+			basic_parser& operator = ( const basic_parser& );
+
+			enum
 			{
-				I i = start;
+				SharedStringLength = 16,
+				SharedStringCount = 4096
+			};
 
-				_string_value_buffer.clear();
+			typedef std::tr1::unordered_map< string_type, var_type > string_values;
 
-				while ( i != end )
+			/* an open container and the number of elements written to it so far */
+			struct frame
+			{
+				explicit frame( var_type *n ) :
+					node( n ),
+					index( 0 ) { }
+
+				var_type *node;
+				size_t index;
+			};
+
+			/*
+			 * where the next value goes: an existing var to overwrite, or 0 when it
+			 * is appended to the array on top of the stack
+			 */
+			var_type* slot()
+			{
+				if ( _member )
 				{
-					switch ( *i )
-					{
-						case '\\':
-							_string_value_buffer.append( handle_escape( ++i, end, options ) );
-							break;
-						case EndChar:
-							if ( EndChar == '\'' )
-							{
-								add_item( destination, options( parse_options::SingleQuotedString, _string_value_buffer ) );
-							}
-							else
-							{
-								add_item( destination, _string_value_buffer );
-							}
-							return ++i;
-						default:
-							_string_value_buffer.push_back( *i );
-					}
-
-					++i;
+					var_type *result = _member;
+					_member = 0;
+					return result;
 				}
 
-				add_item( destination, _string_value_buffer );
+				frame &top = _frames.back();
+				const size_t index = top.index++;
+
+				if ( index < top.node->size() ) return &top.node->array()[ index ].value;
 
-				return i;
+				return 0;
 			}
 
-			template < class I, class Options >
-			I string_or_number_value( std::vector< basic_var< CopyBehaviour, Char >* > &destination, const I &start, const I &end, Options options )
+			void open( Types type )
 			{
-				I i = start;
+				if ( !_captures.empty() ) _path.push_back( segment() );
 
-				_string_value_whitespace_buffer.clear();
-				_string_value_buffer.clear();
+				var_type *target = slot();
 
-				while ( i != end )
+				if ( !target )
 				{
-					switch ( *i )
-					{
-						case '\\':
-							_string_value_buffer.append( handle_escape( ++i, end, options ) );
-							break;
-						case ',':
-						case ':':
-						case '}':
-						case ']':
-							goto NUMBER_FOUND;
-						case '\r':
-						case '\n':
-						case '\t':
-						case ' ':
-							_string_value_whitespace_buffer.push_back( *i++ );
-							continue;
-					}
+					var_type &array = *_frames.back().node;
+					array.push( var_type( type ) );
+					target = &array.array().back().value;
+				}
+				else if ( target->type != type || target->columnar() || target->integers() || target->doubles() || target->fragment() )
+				{
+					target->reset( type );
+				}
 
-					if ( !_string_value_whitespace_buffer.empty() )
-					{
-						_string_value_buffer.append( _string_value_whitespace_buffer.begin(), _string_value_whitespace_buffer.end() );
-						_string_value_whitespace_buffer.clear();
-					}
+				_frames.push_back( frame( target ) );
+			}
 
-					_string_value_buffer.push_back( *i );
+			/* drops what is left of the previous document and completes the container */
+			template < class Options >
+			void close( Options options )
+			{
+				var_type &node = *_frames.back().node;
+				const size_t used = _frames.back().index;
 
-					++i;
-				}
+				if ( node.size() > used ) node.splice( static_cast< unsigned int >( used ), static_cast< unsigned int >( node.size() - used ) );
 
-NUMBER_FOUND:
-				if ( check_for_number( _string_value_buffer, options ) )
-				{
-					/* make sure the buffer is zero-delimited */
-					_string_value_buffer.push_back( 0 );
+				if ( node.type == Array ) node = options( parse_options::CompleteArray, node );
 
-					add_item( destination, dec_string_to_number< Buffer< Char >, long double >( _string_value_buffer.begin(), _string_value_buffer.end() ) );
-				}
-				else
+				_frames.pop_back();
+				if ( !_path.empty() ) _path.pop_back();
+			}
+
+			/* the pointer segment of the value that starts next: its member key or index */
+			string_type segment() const
+			{
+				if ( _frames.empty() ) return string_type();
+				if ( _frames.back().node->type == Object ) return _segment;
+				return integer_to_string< Char >( _frames.back().index, false );
+			}
+
+			/* whether the value that starts next is at one of the captured pointers */
+			bool captured() const
+			{
+				if ( !_frames.empty() && _frames.back().node->type == Object && !_member ) return false;
+
+				for ( typename std::vector< std::vector< string_type > >::const_iterator i = _captures.begin(); i != _captures.end(); ++i )
 				{
-					if ( _string_value_buffer == "null" )
-					{
-						add_item( destination, Null );
-					}
-					else if ( _string_value_buffer == "true" )
-					{
-						add_item( destination, true );
-					}
-					else if ( _string_value_buffer == "false" )
-					{
-						add_item( destination, false );
-					}
-					else
-					{
-						add_item( destination, options( parse_options::UnquotedString, _string_value_buffer ) );
-					}
+					if ( i->size() != _frames.size() ) continue;
+					if ( i->empty() ) return true;
+					if ( std::equal( _path.begin() + 1, _path.end(), i->begin() ) && i->back() == segment() ) return true;
 				}
 
-				return i;
+				return false;
 			}
 
-			template < class I, class Options >
-			string_type handle_escape( I &start, const I &end, Options options )
+			/* the container that starts at the current token of reader, written out compactly */
+			template < class I >
+			string_type fragment( basic_reader< Char, I > &reader )
 			{
-				_handle_escape_buffer.clear();
+				string_type result, closing;
+				string_sink< string_type > sink( result );
 
-				while ( start != end )
+				for ( tokens::Token token = reader.token(); ; token = reader.next() )
 				{
-					switch ( *start )
+					switch ( token )
 					{
-						case '"':
-						case '\'':
-						case '\\':
-						case '/':
-							_handle_escape_buffer.push_back( *start );
-							return _handle_escape_buffer;
-						case 'b':
-							_handle_escape_buffer.push_back( '\b' );
-							return _handle_escape_buffer;
-						case 'f':
-							_handle_escape_buffer.push_back( '\f' );
-							return _handle_escape_buffer;
-						case 'n':
-							_handle_escape_buffer.push_back( '\n' );
-							return _handle_escape_buffer;
-						case 'r':
-							_handle_escape_buffer.push_back( '\r' );
-							return _handle_escape_buffer;
-						case 't':
-							_handle_escape_buffer.push_back( '\t' );
-							return _handle_escape_buffer;
-						case 'u':
-						{
-							increment( start, options );
-							int m = 0;
-							while ( start != end && ++m < 5 )
-							{
-								switch ( *start )
-								{
-									case '0':	case 'a':	case 'A':
-									case '1':	case 'b':	case 'B':
-									case '2':	case 'c':	case 'C':
-									case '3':	case 'd':	case 'D':
-									case '4':	case 'e':	case 'E':
-									case '5':	case 'f':	case 'F':
-									case '6':
-									case '7':
-									case '8':
-									case '9':
-										increment( start, options );
-										_handle_escape_buffer.push_back( *start );
-									default:
-										m = 5;
-										break;
-								}
-							}
-
-							return utf8Encode< Char >( hex_string_to_number< Buffer< Char >, int >( _handle_escape_buffer.begin(), _handle_escape_buffer.end() ) );
-						}
-						default:
-							return _handle_escape_buffer;
+						case tokens::End:
+							while ( !closing.empty() ) close_fragment( result, closing );
+							return result;
+						case tokens::BeginObject:
+						case tokens::BeginArray:
+							separate( result );
+							result.push_back( token == tokens::BeginObject ? '{' : '[' );
+							closing.push_back( token == tokens::BeginObject ? '}' : ']' );
+							break;
+						case tokens::EndObject:
+						case tokens::EndArray:
+							close_fragment( result, closing );
+							break;
+						case tokens::Key:
+						case tokens::String:
+							separate( result );
+							result.push_back( '"' );
+							utf8Escape( reader.value().begin(), reader.value().end(), sink );
+							result.push_back( '"' );
+							if ( token == tokens::Key ) result.push_back( ':' );
+							break;
+						case tokens::Number:
+							separate( result );
+							result.append( reader.value().begin(), reader.value().end() );
+							break;
+						case tokens::True:
+						case tokens::False:
+						case tokens::Null:
+							separate( result );
+							result.append( convert_string< Char >( token == tokens::True ? "true" : token == tokens::False ? "false" : "null" ) );
+							break;
+						case tokens::TokenCount:
+							break;
 					}
+
+					if ( closing.empty() ) return result;
 				}
+			}
 
-				return _handle_escape_buffer;
+			static void separate( string_type &text )
+			{
+				if ( text.empty() ) return;
+
+				const Char last = text[ text.size() - 1 ];
+				if ( last != '[' && last != '{' && last != ':' ) text.push_back( ',' );
+			}
+
+			/* a key without a value gets null */
+			static void close_fragment( string_type &text, string_type &closing )
+			{
+				if ( text[ text.size() - 1 ] == ':' ) text.append( convert_string< Char >( "null" ) );
+
+				text.push_back( closing[ closing.size() - 1 ] );
+				closing.erase( closing.size() - 1 );
 			}
 
-			template < class Q, class Options >
-			bool is_binary( const Q &string, Options options )
+			/* the member key of the object on top of the stack becomes the slot for the next value */
+			template < class Key >
+			void member( const Key &key )
 			{
-				typename Q::const_iterator start = string.begin();
+				frame &top = _frames.back();
+				var_type &object = *top.node;
 
-				if ( std::distance( start, string.end() ) > 2 )
+				/* a repeated key overwrites the earlier member, like operator[] */
+				typename var_type::iterator i = object.array().begin();
+				for ( typename var_type::iterator written = i + top.index; i != written; ++i )
 				{
-					if ( *start == '0' )
+					if ( i->key == key )
 					{
-						increment( start, options );
-						if ( *start == 'x' )
-						{
-							increment( start, options );
-							return *start == 'b';
-						}
+						_member = &i->value;
+						return;
 					}
 				}
 
-				return false;
+				if ( top.index < object.size() )
+				{
+					if ( i->key != key ) i->key = typename var_type::key_type( key );
+					_member = &i->value;
+				}
+				else
+				{
+					object.push_member( typename var_type::key_type( key ), var_type( Undefined ) );
+					_member = &object.array().back().value;
+				}
+
+				++top.index;
 			}
 
-			template < class Q, class Options >
-			bool check_for_number( const Q &string, Options options )
+			void put( const var_type &value )
 			{
-				typename Q::const_iterator start = string.begin();
-				const typename Q::const_iterator &end = string.end();
+				/* a key that was not double quoted, see parse_options */
+				if ( !_member && !_frames.empty() && _frames.back().node->type == Object )
+				{
+					member( value.toString() );
+					return;
+				}
 
-				unsigned int validNumber = 1;
+				if ( var_type *target = slot() )
+				{
+					*target = value;
+				}
+				else
+				{
+					_frames.back().node->push( value );
+				}
+			}
 
-				/* determine type of string */
-				while ( start != end )
+			template < class T >
+			void put_scalar( const T &value )
+			{
+				if ( var_type *target = slot() )
+				{
+					target->assign( value );
+				}
+				else
+				{
+					_frames.back().node->push( var_type( value ) );
+				}
+			}
+
+			/* short strings tend to be enum like, every repetition shares the data of the first one */
+			void put_string( const Buffer< Char > &buffer )
+			{
+				if ( buffer.size() > SharedStringLength )
 				{
-					switch ( validNumber )
+					if ( var_type *target = slot() )
 					{
-						case 1:
-							switch ( *start )
-							{
-								case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-									validNumber = 2;
-									break;
-								default:
-									return false;
-							}
-							break;
-						case 2:
-							switch ( *start )
-							{
-								case '.':
-									validNumber = 3;
-									break;
-								case 'e':
-								case 'E':
-									validNumber = 4;
-									break;
-								case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-									break;
-								default:
-									return false;
-							}
-							break;
-						case 3:
-							switch ( *start )
-							{
-								case 'e':
-								case 'E':
-									validNumber = 4;
-									break;
-								case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-									break;
-								default:
-									return false;
-							}
-							break;
-						case 4:
-							switch ( *start )
-							{
-								case '+': case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-									validNumber = 5;
-									break;
-								default:
-									return false;
-							}
-							break;
-						case 5:
-							switch ( *start )
-							{
-								case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-									break;
-								default:
-									return false;
-							}
-							break;
+						target->assign( buffer.begin(), buffer.end() );
+					}
+					else
+					{
+						_frames.back().node->push( var_type( string_type( buffer ) ) );
 					}
+					return;
+				}
 
-					increment( start, options );
+				const string_type string( buffer );
+
+				typename string_values::const_iterator found = _strings.find( string );
+				if ( found != _strings.end() )
+				{
+					put( found->second );
+					return;
 				}
 
-				return true;
+				const var_type result( string );
+				if ( _strings.size() < SharedStringCount ) _strings.insert( std::make_pair( string, result ) );
+
+				put( result );
 			}
 
-			void add_item( std::vector< basic_var< CopyBehaviour, Char > *> &destinations, const basic_var< CopyBehaviour, Char > &item )
+			/* integers that fit 64 bits are kept exact, everything else becomes a long double */
+			template < class Reader >
+			void put_number( const Reader &reader )
 			{
-				if ( destinations.empty() ) return;
+				if ( _raw_numbers )
+				{
+					put( var_type::raw_number( reader.string() ) );
+					return;
+				}
 
-				basic_var< CopyBehaviour, Char > &destination( *destinations.back() );
+				const bool appending = !_member && !_frames.empty() && _frames.back().index >= _frames.back().node->size();
 
-				switch ( destination.type )
+				bool negative = false;
+				unsigned long long magnitude = 0;
+				long long value = 0;
+
+				if ( reader.integer( negative, magnitude ) )
 				{
-					case String:
-					case Number:
-					case Bool:
-					case Null:
-					case Undefined:
-					case TypeCount:
-						destination = item;
-						if ( item.type != Array && item.type != Object )
+					if ( !negative && magnitude > static_cast< unsigned long long >( std::numeric_limits< long long >::max() ) )
+					{
+						put_scalar( magnitude );
+						return;
+					}
+
+					if ( !negative || negate_integer( magnitude, value ) )
+					{
+						if ( !negative ) value = static_cast< long long >( magnitude );
+
+						if ( appending )
 						{
-							if ( destinations.empty() ) throw "empty array";
-							destinations.pop_back();
+							++_frames.back().index;
+							_frames.back().node->push_integer( value );
 						}
-						break;
-					case Object:
-						destinations.push_back( &destination[ item.toString() ] );
-						break;
-					case Array:
-						destination.push( item );
-						if ( item.type == Array || item.type == Object ) destinations.push_back( &destination.back() );
-						break;
+						else
+						{
+							put_scalar( value );
+						}
+						return;
+					}
 				}
-			}
 
-			template < class iterator_type, class Options >
-			iterator_type& increment( iterator_type &it, Options options )
-			{
-				options( parse_options::NextCharacter, '*' );
-				return ++it;
+				if ( appending )
+				{
+					++_frames.back().index;
+					_frames.back().node->push_number( reader.number() );
+				}
+				else
+				{
+					put_scalar( reader.number() );
+				}
 			}
 
-			Buffer< Char > _string_value_buffer, _string_value_whitespace_buffer, _handle_escape_buffer;
-
-			const basic_var< CopyBehaviour, Char > _result;
+			bool _raw_numbers;
+			parse_limits _limits;
+			string_table< Char > _keys;
+			string_values _strings;
+			std::vector< frame > _frames;
+			Buffer< Char > _value, _whitespace;
+			var_type *_member;
+			std::vector< std::vector< string_type > > _captures;
+			std::vector< string_type > _path;
+			string_type _segment;
+			size_t _characters;
+			const var_type _character;
+			const var_type _result;
 	};
 
+	template < template< class > class CopyBehaviour, class T >
+	void parse_fragment( const std::basic_string< T > &text, basic_var< CopyBehaviour, T > &result )
+	{
+		basic_parser< CopyBehaviour, T >().parse_into( result, text );
+	}
+
 	template < class Options >
 	inline var parser( const var::string_type &string, Options options )
 	{
@@ -459,7 +684,7 @@ NUMBER_FOUND:
 
 	inline var parser( const var::string_type &string )
 	{
-		return basic_parser< CopyOnWrite, char >( string, parse_options::standard ).operator const var&();
+		return basic_parser< CopyOnWrite, char >( string, parse_options::passthrough() ).operator const var&();
 	}
 
 	template < class Options >
@@ -470,6 +695,6 @@ NUMBER_FOUND:
 
 	inline wvar wparser( const wvar::string_type &string )
 	{
-		return basic_parser< CopyOnWrite, wchar_t >( string, parse_options::wstandard ).operator const wvar&();;
+		return basic_parser< CopyOnWrite, wchar_t >( string, parse_options::passthrough() ).operator const wvar&();;
 	}
 }
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <sstream>
+#ifdef _MSC_VER
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#include <jsonpp/var.h>
+#include <jsonpp/pointer.h>
+
+namespace json
+{
+	/*
+	 * RFC 7386 merge patches, RFC 6902 JSON patches and diff. Values are
+	 * assigned, never deep copied, so everything a patch does not touch stays
+	 * shared through the copy behaviour; writing only clones the nodes on the
+	 * path to a change. A JSON patch is applied to a shallow copy of the
+	 * document, which is only assigned back once every operation succeeded.
+	 */
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_patch
+	{
+		public:
+
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			typedef std::basic_string< Char > string_type;
+
+			typedef std::vector< string_type > path_type;
+
+			static void merge( var_type &target, const var_type &patch )
+			{
+				if ( patch.type != Object )
+				{
+					target = patch;
+					return;
+				}
+
+				if ( target.type != Object ) target = var_type( Object );
+
+				for ( typename var_type::const_iterator i = patch.begin(); i != patch.end(); ++i )
+				{
+					switch ( i->value.type )
+					{
+						case Null:
+							target.erase( i->key );
+							break;
+						case Object:
+							merge( target[ i->key ], i->value );
+							break;
+						default:
+							target[ i->key ] = i->value;
+							break;
+					}
+				}
+			}
+
+			static void apply( var_type &document, const var_type &operations )
+			{
+				var_type result( document );
+
+				for ( typename var_type::const_iterator i = operations.begin(); i != operations.end(); ++i )
+				{
+					const var_type &operation = i->value;
+					const string_type name = member( operation, "op" ).toString();
+					const string_type pointer = member( operation, "path" ).toString();
+					const path_type path = split_pointer( pointer );
+
+					if ( name == convert_string< Char >( "add" ) )
+					{
+						add( result, path, member( operation, "value" ), pointer );
+					}
+					else if ( name == convert_string< Char >( "remove" ) )
+					{
+						remove( result, path, pointer );
+					}
+					else if ( name == convert_string< Char >( "replace" ) )
+					{
+						locate( result, path, path.size(), pointer ) = member( operation, "value" );
+					}
+					else if ( name == convert_string< Char >( "move" ) )
+					{
+						const string_type from_pointer = member( operation, "from" ).toString();
+						const path_type from = split_pointer( from_pointer );
+
+						if ( from.size() < path.size() && std::equal( from.begin(), from.end(), path.begin() ) ) fail( "move into itself", pointer );
+
+						const var_type value( get( result, from, from_pointer ) );
+						remove( result, from, from_pointer );
+						add( result, path, value, pointer );
+					}
+					else if ( name == convert_string< Char >( "copy" ) )
+					{
+						const string_type from_pointer = member( operation, "from" ).toString();
+						const var_type value( get( result, split_pointer( from_pointer ), from_pointer ) );
+						add( result, path, value, pointer );
+					}
+					else if ( name == convert_string< Char >( "test" ) )
+					{
+						/* RFC 6902 compares objects regardless of member order */
+						if ( !get( result, path, pointer ).equals( member( operation, "value" ), UnorderedKeys ) ) fail( "test", pointer );
+					}
+					else
+					{
+						fail( "unknown operation", name );
+					}
+				}
+
+				document = result;
+			}
+
+			static var_type diff( const var_type &from, const var_type &to )
+			{
+				var_type operations( Array );
+				diff( from, to, string_type(), operations );
+				return operations;
+			}
+
+		private:
+
+			static void fail( const char *reason, const string_type &pointer )
+			{
+				throw exception( "patch failed:" ) << reason << std::string( pointer.begin(), pointer.end() );
+			}
+
+			static const var_type& member( const var_type &operation, const char *name )
+			{
+				typename var_type::const_iterator i = operation.find_key( convert_string< Char >( name ) );
+				if ( i == operation.end() ) fail( "missing member", convert_string< Char >( name ) );
+				return i->value;
+			}
+
+			static const var_type& get( const var_type &root, const path_type &path, const string_type &pointer )
+			{
+				const var_type *found = find_pointer( root, path );
+				if ( !found ) fail( "path not found", pointer );
+				return *found;
+			}
+
+			/* walks the first count segments of path with write access, only cloning shared nodes along the way */
+			static var_type& locate( var_type &root, const path_type &path, size_t count, const string_type &pointer )
+			{
+				var_type *current = &root;
+
+				for ( typename path_type::const_iterator i = path.begin(); i != path.begin() + count; ++i )
+				{
+					const var_type &inspect = *current;
+
+					if ( inspect.type == Array )
+					{
+						size_t index = 0;
+						if ( !pointer_index( *i, index ) || index >= inspect.size() ) fail( "path not found", pointer );
+						current = &( *current )[ static_cast< unsigned int >( index ) ];
+					}
+					else if ( inspect.type == Object && inspect.has_key( *i ) )
+					{
+						current = &( *current )[ *i ];
+					}
+					else
+					{
+						fail( "path not found", pointer );
+					}
+				}
+
+				return *current;
+			}
+
+			static void add( var_type &root, const path_type &path, const var_type &value, const string_type &pointer )
+			{
+				if ( path.empty() )
+				{
+					root = value;
+					return;
+				}
+
+				var_type &parent = locate( root, path, path.size() - 1, pointer );
+				const string_type &last = path.back();
+
+				if ( parent.type == Array )
+				{
+					size_t index = parent.size();
+					if ( last != convert_string< Char >( "-" ) && ( !pointer_index( last, index ) || index > parent.size() ) ) fail( "index out of range", pointer );
+
+					if ( index == parent.size() )
+					{
+						parent.push( value );
+					}
+					else
+					{
+						parent.splice( static_cast< unsigned int >( index ), 0, value );
+					}
+				}
+				else if ( parent.type == Object )
+				{
+					parent[ last ] = value;
+				}
+				else
+				{
+					fail( "path not found", pointer );
+				}
+			}
+
+			static void remove( var_type &root, const path_type &path, const string_type &pointer )
+			{
+				if ( path.empty() ) fail( "cannot remove root", pointer );
+
+				var_type &parent = locate( root, path, path.size() - 1, pointer );
+				const string_type &last = path.back();
+
+				if ( parent.type == Array )
+				{
+					size_t index = 0;
+					if ( !pointer_index( last, index ) || index >= parent.size() ) fail( "path not found", pointer );
+					parent.splice( static_cast< unsigned int >( index ), 1 );
+				}
+				else if ( parent.type != Object || !parent.erase( last ) )
+				{
+					fail( "path not found", pointer );
+				}
+			}
+
+			static string_type child( const string_type &path, const string_type &key )
+			{
+				return path + static_cast< Char >( '/' ) + escape_pointer( key );
+			}
+
+			static string_type child( const string_type &path, size_t index )
+			{
+				std::basic_stringstream< Char > stream;
+				stream << path << '/' << index;
+				return stream.str();
+			}
+
+			static void operation( var_type &operations, const char *name, const string_type &path )
+			{
+				var_type op( Object );
+				op[ convert_string< Char >( "op" ) ] = convert_string< Char >( name );
+				op[ convert_string< Char >( "path" ) ] = path;
+				operations.push( op );
+			}
+
+			static void operation( var_type &operations, const char *name, const string_type &path, const var_type &value )
+			{
+				var_type op( Object );
+				op[ convert_string< Char >( "op" ) ] = convert_string< Char >( name );
+				op[ convert_string< Char >( "path" ) ] = path;
+				op[ convert_string< Char >( "value" ) ] = value;
+				operations.push( op );
+			}
+
+			static void diff( const var_type &from, const var_type &to, const string_type &path, var_type &operations )
+			{
+				if ( from == to ) return;
+
+				if ( from.type == Object && to.type == Object )
+				{
+					typedef std::tr1::unordered_map< typename var_type::key_type, const var_type* > index_type;
+
+					index_type existing;
+					for ( typename var_type::const_iterator i = from.begin(); i != from.end(); ++i ) existing[ i->key ] = &i->value;
+
+					index_type wanted;
+					for ( typename var_type::const_iterator i = to.begin(); i != to.end(); ++i ) wanted[ i->key ] = &i->value;
+
+					for ( typename var_type::const_iterator i = from.begin(); i != from.end(); ++i )
+					{
+						typename index_type::const_iterator found = wanted.find( i->key );
+						if ( found == wanted.end() )
+						{
+							operation( operations, "remove", child( path, i->key ) );
+						}
+						else
+						{
+							diff( i->value, *found->second, child( path, i->key ), operations );
+						}
+					}
+
+					for ( typename var_type::const_iterator i = to.begin(); i != to.end(); ++i )
+					{
+						if ( existing.find( i->key ) == existing.end() ) operation( operations, "add", child( path, i->key ), i->value );
+					}
+				}
+				else if ( from.type == Array && to.type == Array )
+				{
+					const typename var_type::const_iterator a = from.begin(), b = to.begin();
+					const size_t a_size = from.size(), b_size = to.size();
+
+					size_t prefix = 0;
+					while ( prefix < a_size && prefix < b_size && ( a + prefix )->value == ( b + prefix )->value ) ++prefix;
+
+					size_t suffix = 0;
+					while ( suffix < a_size - prefix && suffix < b_size - prefix && ( a + ( a_size - 1 - suffix ) )->value == ( b + ( b_size - 1 - suffix ) )->value ) ++suffix;
+
+					const size_t a_middle = a_size - prefix - suffix, b_middle = b_size - prefix - suffix;
+					const size_t common = std::min( a_middle, b_middle );
+
+					for ( size_t i = prefix; i < prefix + common; ++i )
+					{
+						diff( ( a + i )->value, ( b + i )->value, child( path, i ), operations );
+					}
+
+					for ( size_t i = common; i < a_middle; ++i )
+					{
+						operation( operations, "remove", child( path, prefix + common ) );
+					}
+
+					for ( size_t i = common; i < b_middle; ++i )
+					{
+						operation( operations, "add", child( path, prefix + i ), ( b + ( prefix + i ) )->value );
+					}
+				}
+				else
+				{
+					operation( operations, "replace", path, to );
+				}
+			}
+	};
+
+	template < template< class > class CopyBehaviour, class Char >
+	void merge_patch( basic_var< CopyBehaviour, Char > &target, const basic_var< CopyBehaviour, Char > &patch )
+	{
+		basic_patch< CopyBehaviour, Char >::merge( target, patch );
+	}
+
+	template < template< class > class CopyBehaviour, class Char >
+	void apply_patch( basic_var< CopyBehaviour, Char > &document, const basic_var< CopyBehaviour, Char > &operations )
+	{
+		basic_patch< CopyBehaviour, Char >::apply( document, operations );
+	}
+
+	template < template< class > class CopyBehaviour, class Char >
+	basic_var< CopyBehaviour, Char > diff( const basic_var< CopyBehaviour, Char > &from, const basic_var< CopyBehaviour, Char > &to )
+	{
+		return basic_patch< CopyBehaviour, Char >::diff( from, to );
+	}
+}
@@ -0,0 +1,636 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+#include <jsonpp/var.h>
+#include <jsonpp/pointer.h>
+
+namespace json
+{
+	/*
+	 * an immutable JSON value for keeping versions of a large document. Every
+	 * change returns a new value that shares all untouched parts with the old
+	 * one. Objects are hash array mapped tries that remember insertion order,
+	 * arrays are tries of 32 wide nodes, so copying and changing one member
+	 * or element costs O(log n). A basic_var is wrapped as is, and one of its
+	 * objects or arrays is only turned into a trie when something below it
+	 * changes. Arrays can be changed and grown but not shortened.
+	 */
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_persistent
+	{
+		public:
+
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			typedef typename var_type::string_type string_type;
+
+			typedef typename var_type::key_type key_type;
+
+			basic_persistent() :
+				_value( undefined() ),
+				_members(),
+				_elements() { }
+
+			basic_persistent( const var_type &value ) :
+				_value( value ),
+				_members(),
+				_elements() { }
+
+			template < class T >
+			basic_persistent( const T &value ) :
+				_value( var_type( value ) ),
+				_members(),
+				_elements() { }
+
+			Types type() const
+			{
+				if ( _members ) return Object;
+				if ( _elements ) return Array;
+				return _value.type;
+			}
+
+			size_t size() const
+			{
+				if ( _members ) return _members->size;
+				if ( _elements ) return _elements->size;
+				return _value.size();
+			}
+
+			bool has_key( const string_type &key ) const
+			{
+				if ( _members ) return find( _members->root.get(), key_type( key ) ) != 0;
+				return _value.type == Object && _value.has_key( key );
+			}
+
+			/* Undefined for a missing member */
+			basic_persistent operator[]( const string_type &key ) const
+			{
+				if ( _members )
+				{
+					const member *found = find( _members->root.get(), key_type( key ) );
+					return found ? found->value : basic_persistent();
+				}
+
+				return _value.type == Object ? basic_persistent( _value[ key ] ) : basic_persistent();
+			}
+
+			/* Undefined for an index past the end */
+			basic_persistent operator[]( size_t index ) const
+			{
+				if ( _elements )
+				{
+					if ( index >= _elements->size ) return basic_persistent();
+
+					const array_node *node = _elements->root.get();
+					for ( unsigned int level = _elements->shift; level > 0; level -= Bits )
+					{
+						node = node->children[ ( index >> level ) & Mask ].get();
+					}
+					return node->values[ index & Mask ];
+				}
+
+				return _value.type == Array ? basic_persistent( _value[ static_cast< unsigned int >( index ) ] ) : basic_persistent();
+			}
+
+			/* this object with key set to value, a new key goes after the existing ones */
+			basic_persistent set( const string_type &key, const basic_persistent &value ) const
+			{
+				const std::tr1::shared_ptr< const object_data > current = members();
+
+				bool added = false;
+				std::tr1::shared_ptr< object_data > data( new object_data() );
+				data->root = assoc( current->root, key_type( key ), current->next, value, 0, false, added );
+				data->size = current->size + added;
+				data->next = current->next + added;
+
+				return basic_persistent( std::tr1::shared_ptr< const object_data >( data ) );
+			}
+
+			/* this array with the element at index set to value, an index past the end pads with Undefined like basic_var */
+			basic_persistent set( size_t index, const basic_persistent &value ) const
+			{
+				basic_persistent result( elements() );
+
+				while ( result._elements->size < index ) result = result.push( basic_persistent() );
+
+				if ( index == result._elements->size ) return result.push( value );
+
+				const array_data &current = *result._elements;
+
+				std::tr1::shared_ptr< array_data > data( new array_data( current ) );
+				data->root = assoc( current.root, current.shift, index, value, false );
+
+				return basic_persistent( std::tr1::shared_ptr< const array_data >( data ) );
+			}
+
+			basic_persistent push( const basic_persistent &value ) const
+			{
+				return basic_persistent( append( elements(), value, false ) );
+			}
+
+			/* this object without key */
+			basic_persistent erase( const string_type &key ) const
+			{
+				const std::tr1::shared_ptr< const object_data > current = members();
+
+				bool removed = false;
+				const node_pointer root = dissoc( current->root, key_type( key ), 0, removed );
+				if ( !removed ) return *this;
+
+				std::tr1::shared_ptr< object_data > data( new object_data( *current ) );
+				data->root = root;
+				--data->size;
+
+				return basic_persistent( std::tr1::shared_ptr< const object_data >( data ) );
+			}
+
+			/* sets the value a JSON pointer points at, like the add operation of a JSON patch */
+			basic_persistent set_pointer( const string_type &pointer, const basic_persistent &value ) const
+			{
+				const std::vector< string_type > path = split_pointer( pointer );
+				return set_path( path.begin(), path.end(), value, pointer );
+			}
+
+			/* the value as a basic_var, O(n) in what was changed since it was wrapped */
+			var_type var() const
+			{
+				if ( _members )
+				{
+					std::vector< const member* > found;
+					found.reserve( _members->size );
+					collect( _members->root.get(), found );
+					std::sort( found.begin(), found.end(), earlier );
+
+					var_type result( Object );
+					for ( typename std::vector< const member* >::const_iterator i = found.begin(); i != found.end(); ++i )
+					{
+						result.push_member( ( *i )->key, ( *i )->value.var() );
+					}
+					return result;
+				}
+
+				if ( _elements )
+				{
+					var_type result( Array );
+					if ( _elements->root ) collect( *_elements->root, _elements->shift, result );
+					return result;
+				}
+
+				return _value;
+			}
+
+		private:
+
+			enum
+			{
+				Bits = 5,
+				Width = 1 << Bits,
+				Mask = Width - 1,
+				HashBits = sizeof( size_t ) * 8
+			};
+
+			struct member;
+
+			struct object_node;
+
+			typedef std::tr1::shared_ptr< const object_node > node_pointer;
+
+			struct object_data
+			{
+				object_data() :
+					root(),
+					size( 0 ),
+					next( 0 ) { }
+
+				node_pointer root;
+				size_t size, next;
+			};
+
+			struct array_node;
+
+			typedef std::tr1::shared_ptr< const array_node > array_pointer;
+
+			struct array_data
+			{
+				array_data() :
+					root(),
+					size( 0 ),
+					shift( 0 ) { }
+
+				array_pointer root;
+				size_t size;
+				unsigned int shift;
+			};
+
+			explicit basic_persistent( const std::tr1::shared_ptr< const object_data > &members ) :
+				_value( undefined() ),
+				_members( members ),
+				_elements() { }
+
+			explicit basic_persistent( const std::tr1::shared_ptr< const array_data > &elements ) :
+				_value( undefined() ),
+				_members(),
+				_elements( elements ) { }
+
+			static const var_type& undefined()
+			{
+				static const var_type result;
+				return result;
+			}
+
+			static unsigned int rank( unsigned int map, unsigned int bit )
+			{
+				unsigned int bits = map & ( bit - 1 );
+				bits = bits - ( ( bits >> 1 ) & 0x55555555u );
+				bits = ( bits & 0x33333333u ) + ( ( bits >> 2 ) & 0x33333333u );
+				return ( ( ( bits + ( bits >> 4 ) ) & 0x0f0f0f0fu ) * 0x01010101u ) >> 24;
+			}
+
+			static unsigned int slot( size_t hash, unsigned int shift )
+			{
+				return 1u << ( ( hash >> shift ) & Mask );
+			}
+
+			/* the members of this object, converted from the wrapped var the first time */
+			std::tr1::shared_ptr< const object_data > members() const
+			{
+				if ( _members ) return _members;
+
+				std::tr1::shared_ptr< object_data > data( new object_data() );
+
+				if ( _value.type == Object )
+				{
+					for ( typename var_type::const_iterator i = _value.begin(); i != _value.end(); ++i )
+					{
+						bool added = false;
+						data->root = assoc( data->root, i->key, data->next, basic_persistent( i->value ), 0, true, added );
+						data->size += added;
+						data->next += added;
+					}
+				}
+
+				return data;
+			}
+
+			/* the elements of this array, converted from the wrapped var the first time */
+			std::tr1::shared_ptr< const array_data > elements() const
+			{
+				if ( _elements ) return _elements;
+
+				std::tr1::shared_ptr< const array_data > data( new array_data() );
+
+				if ( _value.type == Array )
+				{
+					for ( typename var_type::const_iterator i = _value.begin(); i != _value.end(); ++i )
+					{
+						data = append( data, basic_persistent( i->value ), true );
+					}
+				}
+
+				return data;
+			}
+
+			static const member* find( const object_node *node, const key_type &key )
+			{
+				const size_t hash = key.hash();
+
+				for ( unsigned int shift = 0; node; shift += Bits )
+				{
+					if ( shift >= HashBits )
+					{
+						for ( typename std::vector< member >::const_iterator i = node->members.begin(); i != node->members.end(); ++i )
+						{
+							if ( i->key == key ) return &*i;
+						}
+						return 0;
+					}
+
+					const unsigned int bit = slot( hash, shift );
+
+					if ( node->datamap & bit )
+					{
+						const member &found = node->members[ rank( node->datamap, bit ) ];
+						return found.key == key ? &found : 0;
+					}
+
+					if ( !( node->nodemap & bit ) ) return 0;
+
+					node = node->nodes[ rank( node->nodemap, bit ) ].get();
+				}
+
+				return 0;
+			}
+
+			/*
+			 * node with key set to value, copying the nodes on the way down unless
+			 * owned says they belong to a value that is still being built
+			 */
+			static node_pointer assoc( const node_pointer &node, const key_type &key, size_t order, const basic_persistent &value, unsigned int shift, bool owned, bool &added )
+			{
+				std::tr1::shared_ptr< object_node > result;
+				if ( !node ) result.reset( new object_node() );
+				else if ( owned ) result = std::tr1::const_pointer_cast< object_node >( node );
+				else result.reset( new object_node( *node ) );
+
+				if ( shift >= HashBits )
+				{
+					for ( typename std::vector< member >::iterator i = result->members.begin(); i != result->members.end(); ++i )
+					{
+						if ( i->key == key )
+						{
+							i->value = value;
+							return result;
+						}
+					}
+
+					result->members.push_back( member( key, order, value ) );
+					added = true;
+					return result;
+				}
+
+				const unsigned int bit = slot( key.hash(), shift );
+
+				if ( result->datamap & bit )
+				{
+					const unsigned int index = rank( result->datamap, bit );
+					member &current = result->members[ index ];
+
+					if ( current.key == key )
+					{
+						current.value = value;
+						return result;
+					}
+
+					/* two keys share this slot, both move to a node one level down */
+					bool ignored = false;
+					node_pointer child = assoc( node_pointer(), current.key, current.order, current.value, shift + Bits, true, ignored );
+					child = assoc( child, key, order, value, shift + Bits, true, added );
+
+					result->members.erase( result->members.begin() + index );
+					result->datamap &= ~bit;
+					result->nodes.insert( result->nodes.begin() + rank( result->nodemap, bit ), child );
+					result->nodemap |= bit;
+				}
+				else if ( result->nodemap & bit )
+				{
+					node_pointer &child = result->nodes[ rank( result->nodemap, bit ) ];
+					child = assoc( child, key, order, value, shift + Bits, owned, added );
+				}
+				else
+				{
+					result->members.insert( result->members.begin() + rank( result->datamap, bit ), member( key, order, value ) );
+					result->datamap |= bit;
+					added = true;
+				}
+
+				return result;
+			}
+
+			/* node without key, a node that ends up empty is dropped */
+			static node_pointer dissoc( const node_pointer &node, const key_type &key, unsigned int shift, bool &removed )
+			{
+				if ( !node ) return node;
+
+				std::tr1::shared_ptr< object_node > result;
+
+				if ( shift >= HashBits )
+				{
+					for ( size_t i = 0; i < node->members.size(); ++i )
+					{
+						if ( node->members[ i ].key != key ) continue;
+
+						result.reset( new object_node( *node ) );
+						result->members.erase( result->members.begin() + i );
+						removed = true;
+						return result->members.empty() ? node_pointer() : node_pointer( result );
+					}
+
+					return node;
+				}
+
+				const unsigned int bit = slot( key.hash(), shift );
+
+				if ( node->datamap & bit )
+				{
+					const unsigned int index = rank( node->datamap, bit );
+					if ( node->members[ index ].key != key ) return node;
+
+					result.reset( new object_node( *node ) );
+					result->members.erase( result->members.begin() + index );
+					result->datamap &= ~bit;
+				}
+				else if ( node->nodemap & bit )
+				{
+					const unsigned int index = rank( node->nodemap, bit );
+					const node_pointer child = dissoc( node->nodes[ index ], key, shift + Bits, removed );
+					if ( !removed ) return node;
+
+					result.reset( new object_node( *node ) );
+					if ( child )
+					{
+						result->nodes[ index ] = child;
+					}
+					else
+					{
+						result->nodes.erase( result->nodes.begin() + index );
+						result->nodemap &= ~bit;
+					}
+				}
+				else
+				{
+					return node;
+				}
+
+				removed = true;
+				return result->members.empty() && result->nodes.empty() ? node_pointer() : node_pointer( result );
+			}
+
+			static void collect( const object_node *root, std::vector< const member* > &found )
+			{
+				if ( !root ) return;
+
+				std::vector< const object_node* > pending( 1, root );
+				while ( !pending.empty() )
+				{
+					const object_node *node = pending.back();
+					pending.pop_back();
+
+					for ( typename std::vector< member >::const_iterator i = node->members.begin(); i != node->members.end(); ++i )
+					{
+						found.push_back( &*i );
+					}
+
+					for ( typename std::vector< node_pointer >::const_iterator i = node->nodes.begin(); i != node->nodes.end(); ++i )
+					{
+						pending.push_back( i->get() );
+					}
+				}
+			}
+
+			static bool earlier( const member *a, const member *b )
+			{
+				return a->order < b->order;
+			}
+
+			/* node with the element at index set to value, index may be one past the last element */
+			static array_pointer assoc( const array_pointer &node, unsigned int level, size_t index, const basic_persistent &value, bool owned )
+			{
+				std::tr1::shared_ptr< array_node > result;
+				if ( !node ) result.reset( new array_node() );
+				else if ( owned ) result = std::tr1::const_pointer_cast< array_node >( node );
+				else result.reset( new array_node( *node ) );
+
+				if ( level == 0 )
+				{
+					const size_t position = index & Mask;
+					if ( position == result->values.size() ) result->values.push_back( value );
+					else result->values[ position ] = value;
+				}
+				else
+				{
+					const size_t position = ( index >> level ) & Mask;
+					if ( position == result->children.size() ) result->children.push_back( assoc( array_pointer(), level - Bits, index, value, owned ) );
+					else result->children[ position ] = assoc( result->children[ position ], level - Bits, index, value, owned );
+				}
+
+				return result;
+			}
+
+			static std::tr1::shared_ptr< const array_data > append( const std::tr1::shared_ptr< const array_data > &current, const basic_persistent &value, bool owned )
+			{
+				std::tr1::shared_ptr< array_data > data;
+				if ( owned ) data = std::tr1::const_pointer_cast< array_data >( current );
+				else data.reset( new array_data( *current ) );
+
+				/* a full trie gets a new root one level up */
+				if ( data->root && data->size == static_cast< size_t >( Width ) << data->shift )
+				{
+					std::tr1::shared_ptr< array_node > root( new array_node() );
+					root->children.push_back( data->root );
+					data->root = root;
+					data->shift += Bits;
+				}
+
+				data->root = assoc( data->root, data->shift, data->size, value, owned );
+				++data->size;
+
+				return data;
+			}
+
+			static void collect( const array_node &root, unsigned int shift, var_type &result )
+			{
+				std::vector< std::pair< const array_node*, unsigned int > > pending( 1, std::make_pair( &root, shift ) );
+				while ( !pending.empty() )
+				{
+					const array_node *node = pending.back().first;
+					const unsigned int level = pending.back().second;
+					pending.pop_back();
+
+					if ( level == 0 )
+					{
+						for ( typename std::vector< basic_persistent >::const_iterator i = node->values.begin(); i != node->values.end(); ++i )
+						{
+							result.push( i->var() );
+						}
+						continue;
+					}
+
+					for ( typename std::vector< array_pointer >::const_reverse_iterator i = node->children.rbegin(); i != node->children.rend(); ++i )
+					{
+						pending.push_back( std::make_pair( i->get(), level - Bits ) );
+					}
+				}
+			}
+
+			template < class I >
+			basic_persistent set_path( I segment, const I &end, const basic_persistent &value, const string_type &pointer ) const
+			{
+				if ( segment == end ) return value;
+
+				I next = segment;
+				++next;
+
+				switch ( type() )
+				{
+					case Object:
+						return set( *segment, next == end ? value : ( *this )[ *segment ].set_path( next, end, value, pointer ) );
+					case Array:
+					{
+						size_t index = size();
+						if ( *segment != convert_string< Char >( "-" ) && ( !pointer_index( *segment, index ) || index > size() ) )
+						{
+							throw exception( "index out of range" ) << std::string( pointer.begin(), pointer.end() );
+						}
+						return set( index, next == end ? value : ( *this )[ index ].set_path( next, end, value, pointer ) );
+					}
+					default:
+						throw exception( "path not found" ) << std::string( pointer.begin(), pointer.end() );
+				}
+			}
+
+			var_type _value;
+			std::tr1::shared_ptr< const object_data > _members;
+			std::tr1::shared_ptr< const array_data > _elements;
+	};
+
+	template < template< class > class CopyBehaviour, class Char >
+	struct basic_persistent< CopyBehaviour, Char >::member
+	{
+		member() :
+			key(),
+			order( 0 ),
+			value() { }
+
+		member( const key_type &k, size_t o, const basic_persistent &v ) :
+			key( k ),
+			order( o ),
+			value( v ) { }
+
+		key_type key;
+		size_t order;
+		basic_persistent value;
+	};
+
+	/*
+	 * datamap marks the hash slots that hold a member, nodemap the ones that
+	 * lead to a deeper node. Below the last slot level all members share
+	 * their hash and are searched in order.
+	 */
+	template < template< class > class CopyBehaviour, class Char >
+	struct basic_persistent< CopyBehaviour, Char >::object_node
+	{
+		object_node() :
+			datamap( 0 ),
+			nodemap( 0 ),
+			members(),
+			nodes() { }
+
+		unsigned int datamap, nodemap;
+		std::vector< member > members;
+		std::vector< node_pointer > nodes;
+	};
+
+	/* leaves hold values, every other level holds children */
+	template < template< class > class CopyBehaviour, class Char >
+	struct basic_persistent< CopyBehaviour, Char >::array_node
+	{
+		array_node() :
+			values(),
+			children() { }
+
+		std::vector< basic_persistent > values;
+		std::vector< array_pointer > children;
+	};
+
+	typedef basic_persistent< CopyOnWrite, char > persistent;
+	typedef basic_persistent< CopyOnWrite, wchar_t > wpersistent;
+}
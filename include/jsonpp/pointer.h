@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <jsonpp/var.h>
+
+namespace json
+{
+	/* RFC 6901 JSON pointers */
+
+	template < class Char >
+	std::basic_string< Char > escape_pointer( const std::basic_string< Char > &segment )
+	{
+		std::basic_string< Char > result;
+		result.reserve( segment.size() );
+
+		for ( typename std::basic_string< Char >::const_iterator i = segment.begin(); i != segment.end(); ++i )
+		{
+			switch ( *i )
+			{
+				case '~':
+					result.push_back( '~' );
+					result.push_back( '0' );
+					break;
+				case '/':
+					result.push_back( '~' );
+					result.push_back( '1' );
+					break;
+				default:
+					result.push_back( *i );
+			}
+		}
+
+		return result;
+	}
+
+	template < class Char >
+	std::basic_string< Char > unescape_pointer( const std::basic_string< Char > &segment )
+	{
+		std::basic_string< Char > result;
+		result.reserve( segment.size() );
+
+		for ( typename std::basic_string< Char >::const_iterator i = segment.begin(); i != segment.end(); ++i )
+		{
+			if ( *i == '~' && i + 1 != segment.end() )
+			{
+				++i;
+				result.push_back( *i == '1' ? '/' : '~' );
+			}
+			else
+			{
+				result.push_back( *i );
+			}
+		}
+
+		return result;
+	}
+
+	template < class Char >
+	std::vector< std::basic_string< Char > > split_pointer( const std::basic_string< Char > &pointer )
+	{
+		std::vector< std::basic_string< Char > > result;
+
+		if ( pointer.empty() ) return result;
+
+		if ( pointer[ 0 ] != '/' ) throw exception( "invalid JSON pointer" ) << std::string( pointer.begin(), pointer.end() );
+
+		typename std::basic_string< Char >::size_type start = 0;
+		while ( start != std::basic_string< Char >::npos )
+		{
+			const typename std::basic_string< Char >::size_type end = pointer.find( '/', start + 1 );
+			result.push_back( unescape_pointer( pointer.substr( start + 1, end == std::basic_string< Char >::npos ? end : end - start - 1 ) ) );
+			start = end;
+		}
+
+		return result;
+	}
+
+	/* array indices are digits without leading zeros */
+	template < class Char >
+	bool pointer_index( const std::basic_string< Char > &segment, size_t &index )
+	{
+		if ( segment.empty() || ( segment.size() > 1 && segment[ 0 ] == '0' ) ) return false;
+
+		index = 0;
+		for ( typename std::basic_string< Char >::const_iterator i = segment.begin(); i != segment.end(); ++i )
+		{
+			if ( *i < '0' || *i > '9' ) return false;
+			index = index * 10 + ( *i - '0' );
+		}
+
+		return true;
+	}
+
+	/* returns 0 when pointer does not resolve */
+	template < template< class > class CopyBehaviour, class Char >
+	const basic_var< CopyBehaviour, Char >* find_pointer( const basic_var< CopyBehaviour, Char > &root, const std::vector< std::basic_string< Char > > &segments )
+	{
+		const basic_var< CopyBehaviour, Char > *current = &root;
+
+		for ( typename std::vector< std::basic_string< Char > >::const_iterator i = segments.begin(); i != segments.end(); ++i )
+		{
+			if ( current->type == Array )
+			{
+				size_t index = 0;
+				if ( !pointer_index( *i, index ) || index >= current->size() ) return 0;
+				current = &( current->begin() + index )->value;
+			}
+			else if ( current->type == Object )
+			{
+				typename basic_var< CopyBehaviour, Char >::const_iterator found = current->find_key( *i );
+				if ( found == current->end() ) return 0;
+				current = &found->value;
+			}
+			else
+			{
+				return 0;
+			}
+		}
+
+		return current;
+	}
+
+	template < template< class > class CopyBehaviour, class Char >
+	const basic_var< CopyBehaviour, Char >* find_pointer( const basic_var< CopyBehaviour, Char > &root, const std::basic_string< Char > &pointer )
+	{
+		return find_pointer( root, split_pointer( pointer ) );
+	}
+}
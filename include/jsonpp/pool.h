@@ -0,0 +1,302 @@
+#pragma once
+
+#include <new>
+#include <memory>
+#include <cstddef>
+
+#include <jsonpp/key.h>
+
+#ifdef _MSC_VER
+#define JSONPP_THREAD_LOCAL __declspec( thread )
+#else
+#define JSONPP_THREAD_LOCAL __thread
+#endif
+
+namespace json
+{
+	/*
+	 * per thread free lists of small blocks, one list for every multiple of
+	 * Granularity bytes up to Largest. A freed block goes to the list of the
+	 * thread that frees it, so a value may be released on any thread. Each list
+	 * keeps at most Retained blocks, the surplus goes back to operator delete,
+	 * which bounds what a thread that only frees can hold on to.
+	 */
+	class node_pool
+	{
+		public:
+
+			enum
+			{
+				Granularity = 16,
+				Classes = 16,
+				Largest = Granularity * Classes,
+				Retained = 4096
+			};
+
+			static void* allocate( size_t bytes )
+			{
+				if ( bytes > Largest ) return ::operator new( bytes );
+
+				const size_t index = size_class( bytes );
+				free_list &list = lists()[ index ];
+
+				if ( void *block = list.head )
+				{
+					list.head = *static_cast< void** >( block );
+					--list.count;
+					return block;
+				}
+
+				return ::operator new( ( index + 1 ) * Granularity );
+			}
+
+			static void deallocate( void *block, size_t bytes )
+			{
+				if ( !block ) return;
+
+				if ( bytes > Largest )
+				{
+					::operator delete( block );
+					return;
+				}
+
+				free_list &list = lists()[ size_class( bytes ) ];
+
+				if ( list.count >= Retained )
+				{
+					::operator delete( block );
+					return;
+				}
+
+				*static_cast< void** >( block ) = list.head;
+				list.head = block;
+				++list.count;
+			}
+
+			/* hands every block the calling thread keeps back to operator delete, call it before a thread ends */
+			static void release()
+			{
+				for ( size_t i = 0; i < Classes; ++i )
+				{
+					free_list &list = lists()[ i ];
+
+					while ( void *block = list.head )
+					{
+						list.head = *static_cast< void** >( block );
+						::operator delete( block );
+					}
+
+					list.count = 0;
+				}
+			}
+
+			/* number of blocks the calling thread keeps for reuse */
+			static size_t retained()
+			{
+				size_t result = 0;
+				for ( size_t i = 0; i < Classes; ++i ) result += lists()[ i ].count;
+				return result;
+			}
+
+		private:
+
+			struct free_list
+			{
+				void *head;
+				size_t count;
+			};
+
+			static size_t size_class( size_t bytes )
+			{
+				return bytes ? ( bytes - 1 ) / Granularity : 0;
+			}
+
+			static free_list* lists()
+			{
+				static JSONPP_THREAD_LOCAL free_list result[ Classes ];
+				return result;
+			}
+	};
+
+	/* standard allocator on top of node_pool */
+	template < class T >
+	class pool_allocator
+	{
+		public:
+
+			typedef T value_type;
+			typedef T* pointer;
+			typedef const T* const_pointer;
+			typedef T& reference;
+			typedef const T& const_reference;
+			typedef size_t size_type;
+			typedef ptrdiff_t difference_type;
+
+			template < class U >
+			struct rebind
+			{
+				typedef pool_allocator< U > other;
+			};
+
+			pool_allocator() { }
+
+			template < class U >
+			pool_allocator( const pool_allocator< U >& ) { }
+
+			pointer address( reference value ) const
+			{
+				return &value;
+			}
+
+			const_pointer address( const_reference value ) const
+			{
+				return &value;
+			}
+
+			pointer allocate( size_type count, const void* = 0 )
+			{
+				if ( count > max_size() ) throw std::bad_alloc();
+
+				return static_cast< pointer >( node_pool::allocate( count * sizeof( T ) ) );
+			}
+
+			void deallocate( pointer p, size_type count )
+			{
+				node_pool::deallocate( p, count * sizeof( T ) );
+			}
+
+			size_type max_size() const
+			{
+				return static_cast< size_type >( -1 ) / sizeof( T );
+			}
+
+			void construct( pointer p, const T &value )
+			{
+				new( static_cast< void* >( p ) ) T( value );
+			}
+
+			void destroy( pointer p )
+			{
+				p->~T();
+			}
+
+			template < class U >
+			bool operator == ( const pool_allocator< U >& ) const
+			{
+				return true;
+			}
+
+			template < class U >
+			bool operator != ( const pool_allocator< U >& ) const
+			{
+				return false;
+			}
+	};
+
+	/*
+	 * CopyOnWrite with the data and its reference count in one block from
+	 * node_pool, the element lists of a basic_var using it come from the pool
+	 * as well, see behaviour_allocator
+	 */
+	template < class T >
+	class PooledCopyOnWrite
+	{
+		public:
+
+			explicit PooledCopyOnWrite( const T &t ) :
+				_node( create( t ) ) { }
+
+			PooledCopyOnWrite( const PooledCopyOnWrite &rhs ) :
+				_node( rhs._node )
+			{
+				atomic_increment( &_node->references );
+			}
+
+			~PooledCopyOnWrite()
+			{
+				release( _node );
+			}
+
+			PooledCopyOnWrite& operator = ( const PooledCopyOnWrite &rhs )
+			{
+				atomic_increment( &rhs._node->references );
+				release( _node );
+				_node = rhs._node;
+				return *this;
+			}
+
+			T* operator ->()
+			{
+				if ( !unique() )
+				{
+					node *copy = create( _node->value );
+					release( _node );
+					_node = copy;
+				}
+				_node->value.invalidate();
+				return &_node->value;
+			}
+
+			const T* operator ->() const
+			{
+				return &_node->value;
+			}
+
+			/* true when no other var shares the data */
+			bool unique() const
+			{
+				return _node->references == 1;
+			}
+
+		private:
+
+			struct node
+			{
+				explicit node( const T &t ) :
+					references( 1 ),
+					value( t ) { }
+
+				volatile long references;
+				T value;
+			};
+
+			static node* create( const T &t )
+			{
+				void *block = node_pool::allocate( sizeof( node ) );
+
+				try
+				{
+					return new( block ) node( t );
+				}
+				catch ( ... )
+				{
+					node_pool::deallocate( block, sizeof( node ) );
+					throw;
+				}
+			}
+
+			static void release( node *n )
+			{
+				if ( atomic_decrement( &n->references ) == 0 )
+				{
+					n->~node();
+					node_pool::deallocate( n, sizeof( node ) );
+				}
+			}
+
+			node *_node;
+	};
+
+	/* the allocator for the element list of a basic_var with the given CopyBehaviour */
+	template < template< class > class CopyBehaviour, class T >
+	struct behaviour_allocator
+	{
+		typedef std::allocator< T > type;
+	};
+
+	template < class T >
+	struct behaviour_allocator< PooledCopyOnWrite, T >
+	{
+		typedef pool_allocator< T > type;
+	};
+}
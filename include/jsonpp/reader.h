@@ -0,0 +1,669 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+#include <jsonpp/misc.h>
+#include <jsonpp/unicode.h>
+
+namespace json
+{
+	namespace tokens
+	{
+		enum Token
+		{
+			End,
+			BeginObject,
+			EndObject,
+			BeginArray,
+			EndArray,
+			Key,
+			String,
+			Number,
+			True,
+			False,
+			Null,
+			TokenCount
+		};
+
+		inline std::ostream& operator << ( std::ostream &stream, Token token )
+		{
+			switch ( token )
+			{
+				case End:
+					return stream << "End";
+				case BeginObject:
+					return stream << "BeginObject";
+				case EndObject:
+					return stream << "EndObject";
+				case BeginArray:
+					return stream << "BeginArray";
+				case EndArray:
+					return stream << "EndArray";
+				case Key:
+					return stream << "Key";
+				case String:
+					return stream << "String";
+				case Number:
+					return stream << "Number";
+				case True:
+					return stream << "True";
+				case False:
+					return stream << "False";
+				case Null:
+					return stream << "Null";
+				default:
+					return stream << "unknown token";
+			}
+		}
+	}
+
+	/*
+	 * bounds on the input a reader accepts, counted in characters: open
+	 * containers, length of one string or key, elements of one container,
+	 * values in the document and characters read. The defaults don't limit
+	 * anything.
+	 */
+	struct parse_limits
+	{
+		parse_limits() :
+			depth( std::numeric_limits< size_t >::max() ),
+			string( std::numeric_limits< size_t >::max() ),
+			elements( std::numeric_limits< size_t >::max() ),
+			nodes( std::numeric_limits< size_t >::max() ),
+			bytes( std::numeric_limits< size_t >::max() ) { }
+
+		size_t depth;
+		size_t string;
+		size_t elements;
+		size_t nodes;
+		size_t bytes;
+	};
+
+	/* thrown by a reader as soon as the input exceeds one of its parse_limits */
+	class limit_error : public exception
+	{
+		public:
+
+			enum Limit
+			{
+				Depth,
+				String,
+				Elements,
+				Nodes,
+				Bytes
+			};
+
+			limit_error( Limit limit, size_t maximum, size_t offset ) :
+				exception( "input exceeds the" ),
+				_limit( limit ),
+				_offset( offset )
+			{
+				static const char *names[] = { "nesting depth", "string length", "elements per container", "number of values", "input size" };
+
+				*this << names[ limit ] << "limit of" << maximum << "at offset" << offset;
+			}
+
+			Limit limit() const { return _limit; }
+
+			/* characters read when the limit was exceeded */
+			size_t offset() const { return _offset; }
+
+		private:
+
+			Limit _limit;
+			size_t _offset;
+	};
+
+	/*
+	 * pull tokenizer shared by basic_parser and the typed readers, it accepts
+	 * the same relaxed grammar as the parser always did: single quoted and
+	 * unquoted strings, optional ':' and ',' and truncated input.
+	 * next() returns tokens::End once the first top level value is complete.
+	 */
+	template < class Char, class I >
+	class basic_reader
+	{
+		public:
+
+			typedef std::basic_string< Char > string_type;
+
+			typedef I iterator_type;
+
+			basic_reader( const I &start, const I &end, const parse_limits &limits = parse_limits() ) :
+				_start( start ),
+				_end( end ),
+				_limits( limits ),
+				_offset( 0 ),
+				_nodes( 0 ),
+				_token( tokens::End ),
+				_quote( 0 ),
+				_expect_key( false ),
+				_done( false ),
+				_containers(),
+				_elements(),
+				_value(),
+				_whitespace() { }
+
+			tokens::Token next()
+			{
+				if ( _done ) return _token = tokens::End;
+
+				while ( _start != _end )
+				{
+					if ( _offset >= _limits.bytes ) exceeded( limit_error::Bytes, _limits.bytes );
+
+					switch ( *_start )
+					{
+						case '{':
+							advance();
+							return begin( tokens::BeginObject );
+						case '[':
+							advance();
+							return begin( tokens::BeginArray );
+						case '}':
+							advance();
+							return finish( tokens::EndObject );
+						case ']':
+							advance();
+							return finish( tokens::EndArray );
+						case ':':
+						case ',':
+						case ' ': case '\t': case '\r': case '\n':
+							advance();
+							break;
+						case '"':
+							advance();
+							return string_value< '"' >();
+						case '\'':
+							advance();
+							return string_value< '\'' >();
+						default:
+							return string_or_number_value();
+					}
+				}
+
+				_done = true;
+
+				return _token = tokens::End;
+			}
+
+			tokens::Token token() const { return _token; }
+
+			/* text of the current Key, String or Number token */
+			const Buffer< Char >& value() const { return _value; }
+
+			string_type string() const { return _value; }
+
+			long double number() const
+			{
+				long double result = 0;
+				if ( exact_number( result ) ) return result;
+				return dec_string_to_number< Buffer< Char >, long double >( _value.begin(), _value.end() );
+			}
+
+			/* true when the current Number is an integer that fits 64 bits */
+			bool integer( bool &negative, unsigned long long &magnitude ) const
+			{
+				return parse_integer( _value.begin(), _value.end(), negative, magnitude );
+			}
+
+			/* '"' or '\'' for quoted strings, 0 for unquoted strings */
+			Char quote() const { return _quote; }
+
+			/* number of containers open after the current token */
+			size_t depth() const { return _containers.size(); }
+
+			/* skip the value started by the current token */
+			void skip()
+			{
+				if ( _token != tokens::BeginObject && _token != tokens::BeginArray ) return;
+
+				const size_t level = depth();
+
+				while ( depth() >= level && next() != tokens::End ) { }
+			}
+
+			const I& position() const { return _start; }
+
+			/* continues on [ start, end ) with the state left by the previous range, for input that arrives in pieces */
+			void range( const I &start, const I &end )
+			{
+				_start = start;
+				_end = end;
+			}
+
+			/* true once the first top level value is complete or the input ended */
+			bool done() const { return _done; }
+
+			/* trades the scratch buffers with the caller's, which keeps their capacity across readers */
+			void swap_buffers( Buffer< Char > &value, Buffer< Char > &whitespace )
+			{
+				_value.swap( value );
+				_whitespace.swap( whitespace );
+			}
+
+			/* characters read so far */
+			size_t offset() const { return _offset; }
+
+		private:
+
+			basic_reader( const basic_reader& );
+			basic_reader& operator = ( const basic_reader& );
+
+			void advance()
+			{
+				++_start;
+				++_offset;
+			}
+
+			void exceeded( limit_error::Limit limit, size_t maximum ) const
+			{
+				throw limit_error( limit, maximum, _offset );
+			}
+
+			/* checks a string that grew to length characters */
+			void grown( size_t length ) const
+			{
+				if ( length > _limits.string ) exceeded( limit_error::String, _limits.string );
+				if ( _offset >= _limits.bytes ) exceeded( limit_error::Bytes, _limits.bytes );
+			}
+
+			/* counts a value that starts here against the node and element limits */
+			void element()
+			{
+				if ( ++_nodes > _limits.nodes ) exceeded( limit_error::Nodes, _limits.nodes );
+				if ( !_elements.empty() && ++_elements.back() > _limits.elements ) exceeded( limit_error::Elements, _limits.elements );
+			}
+
+			tokens::Token begin( tokens::Token token )
+			{
+				element();
+				if ( _containers.size() >= _limits.depth ) exceeded( limit_error::Depth, _limits.depth );
+
+				_containers.push_back( token );
+				_elements.push_back( 0 );
+				_expect_key = token == tokens::BeginObject;
+				return _token = token;
+			}
+
+			tokens::Token finish( tokens::Token token )
+			{
+				if ( _containers.empty() )
+				{
+					_done = true;
+					return _token = tokens::End;
+				}
+
+				_containers.pop_back();
+				_elements.pop_back();
+				value_done();
+
+				return _token = token;
+			}
+
+			tokens::Token scalar( tokens::Token token )
+			{
+				if ( _expect_key )
+				{
+					_expect_key = false;
+					return _token = tokens::Key;
+				}
+
+				element();
+				value_done();
+
+				return _token = token;
+			}
+
+			void value_done()
+			{
+				if ( _containers.empty() )
+				{
+					_done = true;
+				}
+				else
+				{
+					_expect_key = _containers.back() == tokens::BeginObject;
+				}
+			}
+
+			template < Char EndChar >
+			tokens::Token string_value()
+			{
+				_value.clear();
+				_quote = EndChar;
+
+				while ( _start != _end )
+				{
+					switch ( *_start )
+					{
+						case '\\':
+							handle_escape();
+							grown( _value.size() );
+							continue;
+						case EndChar:
+							advance();
+							return scalar( tokens::String );
+						default:
+							_value.push_back( *_start );
+							grown( _value.size() );
+					}
+
+					advance();
+				}
+
+				return scalar( tokens::String );
+			}
+
+			tokens::Token string_or_number_value()
+			{
+				_value.clear();
+				_whitespace.clear();
+				_quote = 0;
+
+				while ( _start != _end )
+				{
+					switch ( *_start )
+					{
+						case ',':
+						case ':':
+						case '}':
+						case ']':
+							goto VALUE_FOUND;
+						case '\r':
+						case '\n':
+						case '\t':
+						case ' ':
+							_whitespace.push_back( *_start );
+							grown( _value.size() + _whitespace.size() );
+							advance();
+							continue;
+					}
+
+					if ( !_whitespace.empty() )
+					{
+						_value.append( _whitespace.begin(), _whitespace.end() );
+						_whitespace.clear();
+					}
+
+					if ( *_start == '\\' )
+					{
+						handle_escape();
+						grown( _value.size() );
+						continue;
+					}
+
+					_value.push_back( *_start );
+					grown( _value.size() );
+
+					advance();
+				}
+
+VALUE_FOUND:
+				if ( check_for_number() ) return scalar( tokens::Number );
+
+				if ( _value == "null" ) return scalar( tokens::Null );
+
+				if ( _value == "true" ) return scalar( tokens::True );
+
+				if ( _value == "false" ) return scalar( tokens::False );
+
+				return scalar( tokens::String );
+			}
+
+			/* called with _start on the backslash, leaves _start after the escape sequence */
+			void handle_escape()
+			{
+				advance();
+				if ( _start == _end ) return;
+
+				switch ( *_start )
+				{
+					case '"':
+					case '\'':
+					case '\\':
+					case '/':
+						_value.push_back( *_start );
+						break;
+					case 'b':
+						_value.push_back( '\b' );
+						break;
+					case 'f':
+						_value.push_back( '\f' );
+						break;
+					case 'n':
+						_value.push_back( '\n' );
+						break;
+					case 'r':
+						_value.push_back( '\r' );
+						break;
+					case 't':
+						_value.push_back( '\t' );
+						break;
+					case 'u':
+					{
+						advance();
+						int unicode = hex_quad();
+
+						/*
+						 * a high surrogate pairs with a low one in the \u escape after it, when
+						 * that holds anything else it is read on its own. Unpaired surrogates
+						 * are encoded as they are, like the parser always did.
+						 */
+						while ( unicode >= 0xD800 && unicode < 0xDC00 )
+						{
+							I low( _start );
+							if ( _start == _end || *_start != '\\' || ++low == _end || *low != 'u' ) break;
+
+							_start = ++low;
+							_offset += 2;
+							const int second = hex_quad();
+
+							if ( second >= 0xDC00 && second < 0xE000 )
+							{
+								unicode = 0x10000 + ( ( unicode - 0xD800 ) << 10 ) + ( second - 0xDC00 );
+								break;
+							}
+
+							_value.append( utf8Encode< Char >( unicode ) );
+							unicode = second;
+						}
+
+						_value.append( utf8Encode< Char >( unicode ) );
+						return;
+					}
+					default:
+						break;
+				}
+
+				advance();
+			}
+
+			int hex_quad()
+			{
+				int result = 0;
+
+				for ( int i = 0; i < 4 && _start != _end; ++i, advance() )
+				{
+					const Char c = *_start;
+
+					if ( c >= '0' && c <= '9' ) result = ( result << 4 ) | ( c - '0' );
+					else if ( c >= 'a' && c <= 'f' ) result = ( result << 4 ) | ( c - 'a' + 10 );
+					else if ( c >= 'A' && c <= 'F' ) result = ( result << 4 ) | ( c - 'A' + 10 );
+					else break;
+				}
+
+				return result;
+			}
+
+			/*
+			 * numbers whose significant digits fit the mantissa of a long double and
+			 * whose power of ten is exact in one convert with a single rounding, as
+			 * exact as strtold but without copying the text; anything else is left
+			 * to dec_string_to_number
+			 */
+			bool exact_number( long double &result ) const
+			{
+				static const int digits = std::numeric_limits< long double >::digits >= 64 ? 19 : 15;
+				static const int powers = std::numeric_limits< long double >::digits >= 64 ? 27 : 22;
+
+				typename Buffer< Char >::const_iterator i = _value.begin();
+				const typename Buffer< Char >::const_iterator end = _value.end();
+
+				const bool negative = i != end && *i == '-';
+				if ( negative ) ++i;
+
+				unsigned long long mantissa = 0;
+				int significant = 0, exponent = 0, seen = 0;
+
+				for ( bool fraction = false; i != end; ++i )
+				{
+					if ( *i == '.' && !fraction )
+					{
+						fraction = true;
+						continue;
+					}
+
+					if ( *i < '0' || *i > '9' ) break;
+
+					++seen;
+					if ( mantissa == 0 && *i == '0' )
+					{
+						if ( fraction ) --exponent;
+						continue;
+					}
+
+					if ( ++significant > digits ) return false;
+					mantissa = mantissa * 10 + ( *i - '0' );
+					if ( fraction ) --exponent;
+				}
+
+				if ( !seen ) return false;
+
+				if ( i != end )
+				{
+					if ( *i != 'e' && *i != 'E' ) return false;
+					++i;
+
+					const bool negative_exponent = i != end && *i == '-';
+					if ( i != end && ( *i == '-' || *i == '+' ) ) ++i;
+					if ( i == end ) return false;
+
+					int value = 0;
+					for ( ; i != end; ++i )
+					{
+						if ( *i < '0' || *i > '9' || value > 10000 ) return false;
+						value = value * 10 + ( *i - '0' );
+					}
+
+					exponent += negative_exponent ? -value : value;
+				}
+
+				if ( mantissa == 0 )
+				{
+					result = negative ? -0.0L : 0.0L;
+					return true;
+				}
+
+				if ( exponent < -powers || exponent > powers ) return false;
+
+				long double scale = 1;
+				for ( int p = exponent < 0 ? -exponent : exponent; p; --p ) scale *= 10;
+
+				result = exponent < 0 ? mantissa / scale : mantissa * scale;
+				if ( negative ) result = -result;
+
+				return true;
+			}
+
+			bool check_for_number() const
+			{
+				typename Buffer< Char >::const_iterator start = _value.begin();
+				const typename Buffer< Char >::const_iterator end = _value.end();
+
+				unsigned int validNumber = 1;
+
+				/* determine type of string */
+				while ( start != end )
+				{
+					switch ( validNumber )
+					{
+						case 1:
+							switch ( *start )
+							{
+								case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+									validNumber = 2;
+									break;
+								default:
+									return false;
+							}
+							break;
+						case 2:
+							switch ( *start )
+							{
+								case '.':
+									validNumber = 3;
+									break;
+								case 'e':
+								case 'E':
+									validNumber = 4;
+									break;
+								case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+									break;
+								default:
+									return false;
+							}
+							break;
+						case 3:
+							switch ( *start )
+							{
+								case 'e':
+								case 'E':
+									validNumber = 4;
+									break;
+								case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+									break;
+								default:
+									return false;
+							}
+							break;
+						case 4:
+							switch ( *start )
+							{
+								case '+': case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+									validNumber = 5;
+									break;
+								default:
+									return false;
+							}
+							break;
+						case 5:
+							switch ( *start )
+							{
+								case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+									break;
+								default:
+									return false;
+							}
+							break;
+					}
+
+					++start;
+				}
+
+				return validNumber != 1;
+			}
+
+			I _start;
+			I _end;
+			const parse_limits _limits;
+			size_t _offset, _nodes;
+			tokens::Token _token;
+			Char _quote;
+			bool _expect_key, _done;
+			std::vector< tokens::Token > _containers;
+			std::vector< size_t > _elements;
+			Buffer< Char > _value, _whitespace;
+	};
+}
@@ -0,0 +1,482 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <limits>
+#include <cmath>
+#if __cplusplus >= 201703L
+#include <optional>
+#endif
+
+#include <jsonpp/var.h>
+#include <jsonpp/reader.h>
+#include <jsonpp/parser.h>
+
+namespace json
+{
+	/*
+	 * describe the members of a struct once by specialising register_struct,
+	 * json::write and json::read then convert between text and the struct
+	 * directly, without building a basic_var in between:
+	 *
+	 * template <> struct json::register_struct< Point >
+	 * {
+	 *     template < class Fields >
+	 *     static void fields( Fields &f )
+	 *     {
+	 *         f( "x", &Point::x );
+	 *         f( "y", &Point::y );
+	 *     }
+	 * };
+	 */
+	template < class T >
+	struct register_struct;
+
+	template < class T >
+	struct typed_value;
+
+	template < class Reader >
+	void expect( const Reader &reader, tokens::Token token )
+	{
+		if ( reader.token() != token )
+		{
+			throw exception( "expected" ) << token << "but found" << reader.token();
+		}
+	}
+
+	template < class Char >
+	void write_quoted( std::basic_string< Char > &out, const std::basic_string< Char > &string )
+	{
+		out.push_back( '"' );
+		out.append( utf8Decode( string ) );
+		out.push_back( '"' );
+	}
+
+	template < class Char, class T >
+	class field_writer
+	{
+		public:
+
+			field_writer( std::basic_string< Char > &out, const T &object ) :
+				_out( out ),
+				_object( object ),
+				_first( true ) { }
+
+			template < class M >
+			void operator()( const char *name, M T::*member )
+			{
+				const M &value = _object.*member;
+
+				if ( !typed_value< M >::present( value ) ) return;
+
+				if ( !_first ) _out.push_back( ',' );
+				_first = false;
+
+				_out.push_back( '"' );
+				while ( *name ) _out.push_back( *name++ );
+				_out.push_back( '"' );
+				_out.push_back( ':' );
+
+				typed_value< M >::write( _out, value );
+			}
+
+		private:
+
+			std::basic_string< Char > &_out;
+			const T &_object;
+			bool _first;
+	};
+
+	template < class Reader, class T >
+	class field_reader
+	{
+		public:
+
+			field_reader( Reader &reader, T &object ) :
+				_reader( reader ),
+				_object( object ),
+				_found( false ) { }
+
+			template < class M >
+			void operator()( const char *name, M T::*member )
+			{
+				if ( _found || !( _reader.value() == name ) ) return;
+
+				_found = true;
+				_reader.next();
+				typed_value< M >::read( _reader, _object.*member );
+			}
+
+			bool found() const { return _found; }
+
+		private:
+
+			Reader &_reader;
+			T &_object;
+			bool _found;
+	};
+
+	/* registered structs */
+	template < class T >
+	struct typed_value
+	{
+		template < class Char >
+		static void write( std::basic_string< Char > &out, const T &t )
+		{
+			field_writer< Char, T > fields( out, t );
+			out.push_back( '{' );
+			register_struct< T >::fields( fields );
+			out.push_back( '}' );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, T &t )
+		{
+			expect( reader, tokens::BeginObject );
+
+			while ( reader.next() == tokens::Key )
+			{
+				field_reader< Reader, T > fields( reader, t );
+				register_struct< T >::fields( fields );
+
+				if ( !fields.found() )
+				{
+					reader.next();
+					reader.skip();
+				}
+			}
+
+			expect( reader, tokens::EndObject );
+		}
+
+		static bool present( const T& ) { return true; }
+	};
+
+	template < class T >
+	struct typed_integer
+	{
+		template < class Char >
+		static void write( std::basic_string< Char > &out, const T &t )
+		{
+			std::basic_stringstream< Char > stream;
+			stream << t;
+			out.append( stream.str() );
+		}
+
+		/* throws unless the number is an integer that T holds */
+		template < class Reader >
+		static void read( Reader &reader, T &t )
+		{
+			expect( reader, tokens::Number );
+
+			bool negative = false;
+			unsigned long long magnitude = 0;
+
+			if ( reader.integer( negative, magnitude ) )
+			{
+				const unsigned long long largest = static_cast< unsigned long long >( std::numeric_limits< T >::max() );
+				const unsigned long long limit = !negative ? largest : std::numeric_limits< T >::is_signed ? largest + 1 : 0;
+
+				if ( magnitude > limit ) invalid( negative ? -static_cast< long double >( magnitude ) : static_cast< long double >( magnitude ) );
+
+				t = negative && magnitude ? static_cast< T >( -static_cast< long long >( magnitude - 1 ) - 1 ) : static_cast< T >( magnitude );
+				return;
+			}
+
+			/* fractions and exponents, 2.0 and 1e3 still are integers */
+			const long double number = reader.number();
+			const long double end = static_cast< long double >( std::numeric_limits< T >::max() / 2 + 1 ) * 2;
+
+			if ( number != std::floor( number ) || number < static_cast< long double >( std::numeric_limits< T >::min() ) || number >= end ) invalid( number );
+
+			t = static_cast< T >( number );
+		}
+
+		static bool present( const T& ) { return true; }
+
+	private:
+
+		static void invalid( long double number )
+		{
+			throw exception( "number" ) << number << "is not an integer of" << sizeof( T ) * 8 << "bits";
+		}
+	};
+
+	template < class T >
+	struct typed_float
+	{
+		template < class Char >
+		static void write( std::basic_string< Char > &out, const T &t )
+		{
+			out.append( number_to_string< Char >( t ) );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, T &t )
+		{
+			expect( reader, tokens::Number );
+			t = static_cast< T >( reader.number() );
+		}
+
+		static bool present( const T& ) { return true; }
+	};
+
+	template <> struct typed_value< short > : typed_integer< short > { };
+
+	template <> struct typed_value< unsigned short > : typed_integer< unsigned short > { };
+
+	template <> struct typed_value< int > : typed_integer< int > { };
+
+	template <> struct typed_value< unsigned int > : typed_integer< unsigned int > { };
+
+	template <> struct typed_value< long > : typed_integer< long > { };
+
+	template <> struct typed_value< unsigned long > : typed_integer< unsigned long > { };
+
+	template <> struct typed_value< long long > : typed_integer< long long > { };
+
+	template <> struct typed_value< unsigned long long > : typed_integer< unsigned long long > { };
+
+	template <> struct typed_value< float > : typed_float< float > { };
+
+	template <> struct typed_value< double > : typed_float< double > { };
+
+	template <> struct typed_value< long double > : typed_float< long double > { };
+
+	template <>
+	struct typed_value< bool >
+	{
+		template < class Char >
+		static void write( std::basic_string< Char > &out, bool b )
+		{
+			out.append( convert_string< Char >( b ? "true" : "false" ) );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, bool &b )
+		{
+			switch ( reader.token() )
+			{
+				case tokens::True:
+					b = true;
+					break;
+				case tokens::False:
+					b = false;
+					break;
+				default:
+					expect( reader, tokens::True );
+			}
+		}
+
+		static bool present( bool ) { return true; }
+	};
+
+	template <>
+	struct typed_value< char >
+	{
+		template < class Char >
+		static void write( std::basic_string< Char > &out, char c )
+		{
+			write_quoted( out, std::basic_string< Char >( 1, c ) );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, char &c )
+		{
+			expect( reader, tokens::String );
+			c = reader.value().empty() ? 0 : *reader.value().begin();
+		}
+
+		static bool present( char ) { return true; }
+	};
+
+	template < class Char >
+	struct typed_value< std::basic_string< Char > >
+	{
+		static void write( std::basic_string< Char > &out, const std::basic_string< Char > &string )
+		{
+			write_quoted( out, string );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, std::basic_string< Char > &string )
+		{
+			switch ( reader.token() )
+			{
+				case tokens::Key:
+				case tokens::String:
+				case tokens::Number:
+					string.assign( reader.value().begin(), reader.value().end() );
+					break;
+				default:
+					expect( reader, tokens::String );
+			}
+		}
+
+		static bool present( const std::basic_string< Char >& ) { return true; }
+	};
+
+	template < class T >
+	struct typed_value< std::vector< T > >
+	{
+		template < class Char >
+		static void write( std::basic_string< Char > &out, const std::vector< T > &vector )
+		{
+			out.push_back( '[' );
+
+			for ( typename std::vector< T >::const_iterator i = vector.begin(); i != vector.end(); ++i )
+			{
+				if ( i != vector.begin() ) out.push_back( ',' );
+				typed_value< T >::write( out, *i );
+			}
+
+			out.push_back( ']' );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, std::vector< T > &vector )
+		{
+			expect( reader, tokens::BeginArray );
+
+			vector.clear();
+
+			while ( reader.next() != tokens::EndArray )
+			{
+				if ( reader.token() == tokens::End ) expect( reader, tokens::EndArray );
+
+				vector.push_back( T() );
+				typed_value< T >::read( reader, vector.back() );
+			}
+		}
+
+		static bool present( const std::vector< T >& ) { return true; }
+	};
+
+	template < class Char, class T >
+	struct typed_value< std::map< std::basic_string< Char >, T > >
+	{
+		typedef std::map< std::basic_string< Char >, T > map_type;
+
+		static void write( std::basic_string< Char > &out, const map_type &map )
+		{
+			out.push_back( '{' );
+
+			for ( typename map_type::const_iterator i = map.begin(); i != map.end(); ++i )
+			{
+				if ( i != map.begin() ) out.push_back( ',' );
+				write_quoted( out, i->first );
+				out.push_back( ':' );
+				typed_value< T >::write( out, i->second );
+			}
+
+			out.push_back( '}' );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, map_type &map )
+		{
+			expect( reader, tokens::BeginObject );
+
+			map.clear();
+
+			while ( reader.next() == tokens::Key )
+			{
+				T &value = map[ std::basic_string< Char >( reader.value().begin(), reader.value().end() ) ];
+				reader.next();
+				typed_value< T >::read( reader, value );
+			}
+
+			expect( reader, tokens::EndObject );
+		}
+
+		static bool present( const map_type& ) { return true; }
+	};
+
+	template < template< class > class CopyBehaviour, class Char >
+	struct typed_value< basic_var< CopyBehaviour, Char > >
+	{
+		static void write( std::basic_string< Char > &out, const basic_var< CopyBehaviour, Char > &value )
+		{
+			out.append( value.serialize() );
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, basic_var< CopyBehaviour, Char > &value )
+		{
+			basic_parser< CopyBehaviour, Char > parser;
+			value = parser.read( reader, parse_options::passthrough() );
+		}
+
+		static bool present( const basic_var< CopyBehaviour, Char > &value ) { return value.type != Undefined; }
+	};
+
+#if __cplusplus >= 201703L
+	/* absent optionals are left out of objects, null resets them */
+	template < class T >
+	struct typed_value< std::optional< T > >
+	{
+		template < class Char >
+		static void write( std::basic_string< Char > &out, const std::optional< T > &optional )
+		{
+			if ( optional )
+			{
+				typed_value< T >::write( out, *optional );
+			}
+			else
+			{
+				out.append( convert_string< Char >( "null" ) );
+			}
+		}
+
+		template < class Reader >
+		static void read( Reader &reader, std::optional< T > &optional )
+		{
+			if ( reader.token() == tokens::Null )
+			{
+				optional.reset();
+			}
+			else
+			{
+				optional.emplace();
+				typed_value< T >::read( reader, *optional );
+			}
+		}
+
+		static bool present( const std::optional< T > &optional ) { return optional.has_value(); }
+	};
+#endif
+
+	template < class T, class Char >
+	void read( const std::basic_string< Char > &string, T &t )
+	{
+		basic_reader< Char, typename std::basic_string< Char >::const_iterator > reader( string.begin(), string.end() );
+		reader.next();
+		typed_value< T >::read( reader, t );
+	}
+
+	template < class T >
+	T read( const std::string &string )
+	{
+		T t = T();
+		read( string, t );
+		return t;
+	}
+
+	template < class T >
+	std::string write( const T &t )
+	{
+		std::string result;
+		typed_value< T >::write( result, t );
+		return result;
+	}
+
+	template < class T >
+	std::wstring wwrite( const T &t )
+	{
+		std::wstring result;
+		typed_value< T >::write( result, t );
+		return result;
+	}
+}
@@ -78,4 +78,21 @@ namespace json
 				return Buffer< typename JSON::character_type >( str.begin(), str.end() );
 			}
 	};
+
+	/* bytes are kept as they are and written as base64, see basic_var::raw_bytes */
+	template < class JSON >
+	struct register_type< JSON, std::vector< char > >
+	{
+			static Types type( const std::vector< char >& ) { return String; }
+
+			static typename JSON::basic_data to_json( const std::vector< char > &bytes )
+			{
+				return JSON::basic_data::bytes( bytes.empty() ? 0 : &bytes[ 0 ], bytes.size() );
+			}
+
+			static std::vector< char > from_json( const JSON &json )
+			{
+				return json.bytes();
+			}
+	};
 }
@@ -0,0 +1,847 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <cmath>
+#include <regex>
+#ifdef _MSC_VER
+#include <unordered_map>
+#else
+#include <tr1/unordered_map>
+#endif
+
+#include <jsonpp/var.h>
+#include <jsonpp/reader.h>
+#include <jsonpp/parser.h>
+#include <jsonpp/pointer.h>
+
+namespace json
+{
+	struct validation_error
+	{
+		validation_error() :
+			keyword(),
+			location() { }
+
+		std::string keyword;
+		std::string location;
+	};
+
+	/*
+	 * validator for the core and validation vocabularies of JSON Schema draft
+	 * 2020-12. The schema is compiled once: $ref's are resolved to node
+	 * indices, patterns are compiled to regexes and properties are looked up
+	 * through a hash table. Documents can be validated as a var or straight
+	 * from text, in which case only the parts that need a tree (enum, const,
+	 * allOf/anyOf/oneOf/not/if, uniqueItems and contains) are materialized.
+	 * Supported $ref's are local: "#", JSON pointers "#/..." and "#anchor".
+	 */
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_schema
+	{
+		public:
+
+			typedef basic_var< CopyBehaviour, Char > var_type;
+
+			typedef std::basic_string< Char > string_type;
+
+			explicit basic_schema( const var_type &schema ) :
+				_root( schema ),
+				_nodes(),
+				_regexes(),
+				_compiled(),
+				_anchors()
+			{
+				collect_anchors( schema, string_type() );
+				compile( schema, string_type() );
+				reject_cycles();
+			}
+
+			bool validate( const var_type &document ) const
+			{
+				return valid( 0, document, 0 );
+			}
+
+			void check( const var_type &document ) const
+			{
+				validation_error error;
+				if ( !valid( 0, document, &error ) ) report( error );
+			}
+
+			template < class I >
+			bool validate( const I &start, const I &end ) const
+			{
+				basic_reader< Char, I > reader( start, end );
+				reader.next();
+				return stream_valid( 0, reader, 0 );
+			}
+
+			template < class I >
+			void check( const I &start, const I &end ) const
+			{
+				basic_reader< Char, I > reader( start, end );
+				reader.next();
+				validation_error error;
+				if ( !stream_valid( 0, reader, &error ) ) report( error );
+			}
+
+		private:
+
+			enum
+			{
+				Integer = 1 << 10,
+				Unbounded = -1
+			};
+
+			struct node
+			{
+				node() :
+					always_false( false ),
+					needs_tree( false ),
+					keywords( 0 ),
+					types( 0 ),
+					ref( -1 ),
+					enums(),
+					has_const( false ),
+					constant(),
+					minimum( 0 ), maximum( 0 ), exclusive_minimum( 0 ), exclusive_maximum( 0 ), multiple_of( 0 ),
+					has_minimum( false ), has_maximum( false ), has_exclusive_minimum( false ), has_exclusive_maximum( false ), has_multiple_of( false ),
+					min_length( 0 ), max_length( Unbounded ), pattern( -1 ),
+					min_items( 0 ), max_items( Unbounded ), unique_items( false ), prefix_items(), items( -1 ),
+					contains( -1 ), min_contains( 1 ), max_contains( Unbounded ),
+					min_properties( 0 ), max_properties( Unbounded ), properties(), pattern_properties(),
+					additional_properties( -1 ), property_names( -1 ), required(), dependent_required(),
+					all_of(), any_of(), one_of(), not_( -1 ), if_( -1 ), then_( -1 ), else_( -1 ) { }
+
+				bool always_false, needs_tree;
+				int keywords;
+				unsigned int types;
+				int ref;
+
+				std::vector< var_type > enums;
+				bool has_const;
+				var_type constant;
+
+				long double minimum, maximum, exclusive_minimum, exclusive_maximum, multiple_of;
+				bool has_minimum, has_maximum, has_exclusive_minimum, has_exclusive_maximum, has_multiple_of;
+
+				long min_length, max_length;
+				int pattern;
+
+				long min_items, max_items;
+				bool unique_items;
+				std::vector< int > prefix_items;
+				int items, contains;
+				long min_contains, max_contains;
+
+				long min_properties, max_properties;
+				std::tr1::unordered_map< string_type, int > properties;
+				std::vector< std::pair< int, int > > pattern_properties;
+				int additional_properties, property_names;
+				std::tr1::unordered_map< string_type, size_t > required;
+				std::vector< std::pair< string_type, std::vector< string_type > > > dependent_required;
+
+				std::vector< int > all_of, any_of, one_of;
+				int not_, if_, then_, else_;
+			};
+
+			static void report( const validation_error &error )
+			{
+				throw exception( "schema violation:" ) << error.keyword << "at" << ( error.location.empty() ? std::string( "/" ) : error.location );
+			}
+
+			static bool fail( validation_error *error, const char *keyword )
+			{
+				if ( error ) error->keyword = keyword;
+				return false;
+			}
+
+			/* true when values holds one equal to value, objects being equal whatever the order of their members */
+			static bool listed( const std::vector< var_type > &values, const var_type &value )
+			{
+				for ( typename std::vector< var_type >::const_iterator i = values.begin(); i != values.end(); ++i )
+				{
+					if ( i->equals( value ) ) return true;
+				}
+				return false;
+			}
+
+			static bool fail_at( validation_error *error, const string_type &segment )
+			{
+				if ( error ) error->location.insert( 0, '/' + std::string( segment.begin(), segment.end() ) );
+				return false;
+			}
+
+			static bool fail_at( validation_error *error, size_t index )
+			{
+				if ( error )
+				{
+					std::stringstream stream;
+					stream << '/' << index;
+					error->location.insert( 0, stream.str() );
+				}
+				return false;
+			}
+
+			static string_type percent_decode( const string_type &string )
+			{
+				string_type result;
+				for ( typename string_type::const_iterator i = string.begin(); i != string.end(); ++i )
+				{
+					if ( *i == '%' && string.end() - i > 2 )
+					{
+						const string_type hex( i + 1, i + 3 );
+						result.push_back( static_cast< Char >( hex_string_to_number< string_type, int >( hex.begin(), hex.end() ) ) );
+						i += 2;
+					}
+					else
+					{
+						result.push_back( *i );
+					}
+				}
+				return result;
+			}
+
+			static string_type child( const string_type &pointer, const char *keyword )
+			{
+				return pointer + static_cast< Char >( '/' ) + convert_string< Char >( keyword );
+			}
+
+			static string_type child( const string_type &pointer, const char *keyword, const string_type &segment )
+			{
+				return child( pointer, keyword ) + static_cast< Char >( '/' ) + escape_pointer( segment );
+			}
+
+			static string_type child( const string_type &pointer, const char *keyword, size_t index )
+			{
+				std::basic_stringstream< Char > stream;
+				stream << index;
+				return child( pointer, keyword ) + static_cast< Char >( '/' ) + stream.str();
+			}
+
+			const var_type& resolve( const string_type &pointer ) const
+			{
+				const var_type *found = find_pointer( _root, pointer );
+
+				if ( !found ) throw exception( "unresolvable $ref" ) << std::string( pointer.begin(), pointer.end() );
+
+				return *found;
+			}
+
+			void collect_anchors( const var_type &schema, const string_type &pointer )
+			{
+				if ( schema.type != Object && schema.type != Array ) return;
+
+				for ( typename var_type::const_iterator i = schema.begin(); i != schema.end(); ++i )
+				{
+					if ( schema.type == Object )
+					{
+						if ( i->key == convert_string< Char >( "$anchor" ) && i->value.type == String )
+						{
+							_anchors[ i->value.toString() ] = pointer;
+						}
+						collect_anchors( i->value, pointer + static_cast< Char >( '/' ) + escape_pointer( i->key.str() ) );
+					}
+					else
+					{
+						std::basic_stringstream< Char > stream;
+						stream << pointer << '/' << ( i - schema.begin() );
+						collect_anchors( i->value, stream.str() );
+					}
+				}
+			}
+
+			int compile_ref( const string_type &reference )
+			{
+				if ( reference.empty() || reference[ 0 ] != '#' )
+				{
+					throw exception( "unsupported $ref" ) << std::string( reference.begin(), reference.end() );
+				}
+
+				const string_type fragment( percent_decode( reference.substr( 1 ) ) );
+
+				if ( !fragment.empty() && fragment[ 0 ] != '/' )
+				{
+					typename std::map< string_type, string_type >::const_iterator anchor = _anchors.find( fragment );
+					if ( anchor == _anchors.end() ) throw exception( "unknown $anchor" ) << std::string( fragment.begin(), fragment.end() );
+					return compile( resolve( anchor->second ), anchor->second );
+				}
+
+				return compile( resolve( fragment ), fragment );
+			}
+
+			bool has( const var_type &schema, const char *keyword, node &n )
+			{
+				if ( !schema.has_key( convert_string< Char >( keyword ) ) ) return false;
+				++n.keywords;
+				return true;
+			}
+
+			static const var_type& get( const var_type &schema, const char *keyword )
+			{
+				return schema[ convert_string< Char >( keyword ) ];
+			}
+
+			static long count( const var_type &schema, const char *keyword )
+			{
+				return static_cast< long >( get( schema, keyword ).toNumber() );
+			}
+
+			static unsigned int type_mask( const string_type &name )
+			{
+				if ( name == convert_string< Char >( "null" ) ) return Null;
+				if ( name == convert_string< Char >( "boolean" ) ) return Bool;
+				if ( name == convert_string< Char >( "number" ) ) return static_cast< unsigned int >( Number ) | Integer;
+				if ( name == convert_string< Char >( "integer" ) ) return Integer;
+				if ( name == convert_string< Char >( "string" ) ) return String;
+				if ( name == convert_string< Char >( "array" ) ) return Array;
+				if ( name == convert_string< Char >( "object" ) ) return Object;
+				throw exception( "unknown type" ) << std::string( name.begin(), name.end() );
+			}
+
+			std::vector< int > compile_list( const var_type &list, const string_type &pointer, const char *keyword )
+			{
+				std::vector< int > result;
+				for ( typename var_type::const_iterator i = list.begin(); i != list.end(); ++i )
+				{
+					result.push_back( compile( i->value, child( pointer, keyword, i - list.begin() ) ) );
+				}
+				return result;
+			}
+
+			int compile( const var_type &schema, const string_type &pointer )
+			{
+				typename std::map< string_type, int >::const_iterator known = _compiled.find( pointer );
+				if ( known != _compiled.end() ) return known->second;
+
+				const int index = static_cast< int >( _nodes.size() );
+				_compiled[ pointer ] = index;
+				_nodes.push_back( node() );
+
+				node n;
+
+				if ( schema.type == Bool )
+				{
+					n.always_false = !schema.toBool();
+					_nodes[ index ] = n;
+					return index;
+				}
+
+				if ( has( schema, "type", n ) )
+				{
+					const var_type &type = get( schema, "type" );
+					if ( type.type == Array )
+					{
+						for ( typename var_type::const_iterator i = type.begin(); i != type.end(); ++i )
+						{
+							n.types |= type_mask( i->value.toString() );
+						}
+					}
+					else
+					{
+						n.types = type_mask( type.toString() );
+					}
+				}
+
+				if ( has( schema, "enum", n ) )
+				{
+					const var_type &values = get( schema, "enum" );
+					for ( typename var_type::const_iterator i = values.begin(); i != values.end(); ++i ) n.enums.push_back( i->value );
+					n.needs_tree = true;
+				}
+
+				if ( has( schema, "const", n ) )
+				{
+					n.has_const = true;
+					n.constant = get( schema, "const" );
+					n.needs_tree = true;
+				}
+
+				if ( ( n.has_minimum = has( schema, "minimum", n ) ) ) n.minimum = get( schema, "minimum" ).toNumber();
+				if ( ( n.has_maximum = has( schema, "maximum", n ) ) ) n.maximum = get( schema, "maximum" ).toNumber();
+				if ( ( n.has_exclusive_minimum = has( schema, "exclusiveMinimum", n ) ) ) n.exclusive_minimum = get( schema, "exclusiveMinimum" ).toNumber();
+				if ( ( n.has_exclusive_maximum = has( schema, "exclusiveMaximum", n ) ) ) n.exclusive_maximum = get( schema, "exclusiveMaximum" ).toNumber();
+				if ( ( n.has_multiple_of = has( schema, "multipleOf", n ) ) ) n.multiple_of = get( schema, "multipleOf" ).toNumber();
+
+				if ( has( schema, "minLength", n ) ) n.min_length = count( schema, "minLength" );
+				if ( has( schema, "maxLength", n ) ) n.max_length = count( schema, "maxLength" );
+				if ( has( schema, "pattern", n ) )
+				{
+					const string_type pattern = get( schema, "pattern" ).toString();
+					n.pattern = static_cast< int >( _regexes.size() );
+					_regexes.push_back( std::basic_regex< Char >( pattern, std::regex_constants::ECMAScript | std::regex_constants::optimize ) );
+				}
+
+				if ( has( schema, "minItems", n ) ) n.min_items = count( schema, "minItems" );
+				if ( has( schema, "maxItems", n ) ) n.max_items = count( schema, "maxItems" );
+				if ( has( schema, "uniqueItems", n ) ) n.needs_tree |= ( n.unique_items = get( schema, "uniqueItems" ).toBool() );
+				if ( has( schema, "prefixItems", n ) ) n.prefix_items = compile_list( get( schema, "prefixItems" ), pointer, "prefixItems" );
+				if ( has( schema, "items", n ) ) n.items = compile( get( schema, "items" ), child( pointer, "items" ) );
+				if ( has( schema, "contains", n ) )
+				{
+					n.contains = compile( get( schema, "contains" ), child( pointer, "contains" ) );
+					n.needs_tree = true;
+				}
+				if ( has( schema, "minContains", n ) ) n.min_contains = count( schema, "minContains" );
+				if ( has( schema, "maxContains", n ) ) n.max_contains = count( schema, "maxContains" );
+
+				if ( has( schema, "minProperties", n ) ) n.min_properties = count( schema, "minProperties" );
+				if ( has( schema, "maxProperties", n ) ) n.max_properties = count( schema, "maxProperties" );
+				if ( has( schema, "properties", n ) )
+				{
+					const var_type &properties = get( schema, "properties" );
+					for ( typename var_type::const_iterator i = properties.begin(); i != properties.end(); ++i )
+					{
+						n.properties[ i->key ] = compile( i->value, child( pointer, "properties", i->key ) );
+					}
+				}
+				if ( has( schema, "patternProperties", n ) )
+				{
+					const var_type &properties = get( schema, "patternProperties" );
+					for ( typename var_type::const_iterator i = properties.begin(); i != properties.end(); ++i )
+					{
+						const int pattern = static_cast< int >( _regexes.size() );
+						_regexes.push_back( std::basic_regex< Char >( i->key.str(), std::regex_constants::ECMAScript | std::regex_constants::optimize ) );
+						n.pattern_properties.push_back( std::make_pair( pattern, compile( i->value, child( pointer, "patternProperties", i->key ) ) ) );
+					}
+				}
+				if ( has( schema, "additionalProperties", n ) ) n.additional_properties = compile( get( schema, "additionalProperties" ), child( pointer, "additionalProperties" ) );
+				if ( has( schema, "propertyNames", n ) ) n.property_names = compile( get( schema, "propertyNames" ), child( pointer, "propertyNames" ) );
+				if ( has( schema, "required", n ) )
+				{
+					const var_type &required = get( schema, "required" );
+					for ( typename var_type::const_iterator i = required.begin(); i != required.end(); ++i )
+					{
+						n.required.insert( std::make_pair( i->value.toString(), n.required.size() ) );
+					}
+				}
+				if ( has( schema, "dependentRequired", n ) )
+				{
+					const var_type &dependent = get( schema, "dependentRequired" );
+					for ( typename var_type::const_iterator i = dependent.begin(); i != dependent.end(); ++i )
+					{
+						std::vector< string_type > names;
+						for ( typename var_type::const_iterator j = i->value.begin(); j != i->value.end(); ++j ) names.push_back( j->value.toString() );
+						n.dependent_required.push_back( std::make_pair( i->key.str(), names ) );
+					}
+					n.needs_tree = true;
+				}
+
+				if ( has( schema, "allOf", n ) ) n.all_of = compile_list( get( schema, "allOf" ), pointer, "allOf" );
+				if ( has( schema, "anyOf", n ) ) n.any_of = compile_list( get( schema, "anyOf" ), pointer, "anyOf" );
+				if ( has( schema, "oneOf", n ) ) n.one_of = compile_list( get( schema, "oneOf" ), pointer, "oneOf" );
+				if ( has( schema, "not", n ) ) n.not_ = compile( get( schema, "not" ), child( pointer, "not" ) );
+				if ( has( schema, "if", n ) ) n.if_ = compile( get( schema, "if" ), child( pointer, "if" ) );
+				if ( has( schema, "then", n ) ) n.then_ = compile( get( schema, "then" ), child( pointer, "then" ) );
+				if ( has( schema, "else", n ) ) n.else_ = compile( get( schema, "else" ), child( pointer, "else" ) );
+				n.needs_tree |= !n.all_of.empty() || !n.any_of.empty() || !n.one_of.empty() || n.not_ >= 0 || n.if_ >= 0;
+
+				if ( schema.has_key( convert_string< Char >( "$ref" ) ) )
+				{
+					n.ref = compile_ref( get( schema, "$ref" ).toString() );
+					n.needs_tree |= n.keywords > 0;
+				}
+
+				_nodes[ index ] = n;
+
+				return index;
+			}
+
+			/* the schemas applied to the same value as node n, without reading any of it */
+			static void same_value( const node &n, std::vector< int > &next )
+			{
+				next.clear();
+				if ( n.ref >= 0 ) next.push_back( n.ref );
+				next.insert( next.end(), n.all_of.begin(), n.all_of.end() );
+				next.insert( next.end(), n.any_of.begin(), n.any_of.end() );
+				next.insert( next.end(), n.one_of.begin(), n.one_of.end() );
+				if ( n.not_ >= 0 ) next.push_back( n.not_ );
+				if ( n.if_ >= 0 ) next.push_back( n.if_ );
+				if ( n.then_ >= 0 ) next.push_back( n.then_ );
+				if ( n.else_ >= 0 ) next.push_back( n.else_ );
+			}
+
+			/*
+			 * a loop of $ref's and applicators that all look at the same value,
+			 * like { "$ref":"#" }, would validate forever, refuse it up front
+			 */
+			void reject_cycles() const
+			{
+				enum { Unvisited, Visiting, Done };
+
+				std::vector< int > state( _nodes.size(), Unvisited );
+				std::vector< std::pair< int, std::vector< int > > > stack;
+
+				for ( size_t start = 0; start < _nodes.size(); ++start )
+				{
+					if ( state[ start ] != Unvisited ) continue;
+
+					stack.push_back( std::make_pair( static_cast< int >( start ), std::vector< int >() ) );
+					same_value( _nodes[ start ], stack.back().second );
+					state[ start ] = Visiting;
+
+					while ( !stack.empty() )
+					{
+						std::vector< int > &next = stack.back().second;
+
+						if ( next.empty() )
+						{
+							state[ stack.back().first ] = Done;
+							stack.pop_back();
+							continue;
+						}
+
+						const int index = next.back();
+						next.pop_back();
+
+						if ( state[ index ] == Visiting )
+						{
+							for ( typename std::map< string_type, int >::const_iterator i = _compiled.begin(); i != _compiled.end(); ++i )
+							{
+								if ( i->second == index ) throw exception( "$ref cycle at" ) << std::string( i->first.begin(), i->first.end() );
+							}
+						}
+
+						if ( state[ index ] != Unvisited ) continue;
+
+						state[ index ] = Visiting;
+						stack.push_back( std::make_pair( index, std::vector< int >() ) );
+						same_value( _nodes[ index ], stack.back().second );
+					}
+				}
+			}
+
+			bool check_type( const node &n, unsigned int type, validation_error *error ) const
+			{
+				if ( n.types && !( n.types & type ) ) return fail( error, "type" );
+				return true;
+			}
+
+			bool check_number( const node &n, long double number, validation_error *error ) const
+			{
+				if ( n.types && !( n.types & Number ) )
+				{
+					if ( !( n.types & Integer ) || std::floor( number ) != number ) return fail( error, "type" );
+				}
+				if ( n.has_minimum && number < n.minimum ) return fail( error, "minimum" );
+				if ( n.has_maximum && number > n.maximum ) return fail( error, "maximum" );
+				if ( n.has_exclusive_minimum && number <= n.exclusive_minimum ) return fail( error, "exclusiveMinimum" );
+				if ( n.has_exclusive_maximum && number >= n.exclusive_maximum ) return fail( error, "exclusiveMaximum" );
+				if ( n.has_multiple_of )
+				{
+					const long double quotient = number / n.multiple_of;
+					if ( std::floor( quotient ) != quotient ) return fail( error, "multipleOf" );
+				}
+				return true;
+			}
+
+			template < class I >
+			bool check_string( const node &n, const I &start, const I &end, validation_error *error ) const
+			{
+				if ( !check_type( n, String, error ) ) return false;
+
+				if ( n.min_length > 0 || n.max_length != Unbounded )
+				{
+					long length = 0;
+					for ( I i = start; i != end; ++i )
+					{
+						/* count code points, not utf-8 continuation bytes */
+						if ( ( *i & 0xC0 ) != 0x80 ) ++length;
+					}
+					if ( length < n.min_length ) return fail( error, "minLength" );
+					if ( n.max_length != Unbounded && length > n.max_length ) return fail( error, "maxLength" );
+				}
+
+				if ( n.pattern >= 0 && !std::regex_search( start, end, _regexes[ n.pattern ] ) ) return fail( error, "pattern" );
+
+				return true;
+			}
+
+			bool check_count( long count, long minimum, long maximum, const char *min_keyword, const char *max_keyword, validation_error *error ) const
+			{
+				if ( count < minimum ) return fail( error, min_keyword );
+				if ( maximum != Unbounded && count > maximum ) return fail( error, max_keyword );
+				return true;
+			}
+
+			bool key_valid( const node &n, const string_type &key, validation_error *error ) const
+			{
+				if ( n.property_names < 0 ) return true;
+				const node &names = _nodes[ n.property_names ];
+				if ( names.needs_tree || names.ref >= 0 ) return valid( n.property_names, var_type( key ), error );
+				if ( names.always_false ) return fail( error, "propertyNames" );
+				return check_string( names, key.begin(), key.end(), error );
+			}
+
+			/* collects the schemas that apply to member key */
+			void member_schemas( const node &n, const string_type &key, std::vector< int > &schemas ) const
+			{
+				schemas.clear();
+
+				typename std::tr1::unordered_map< string_type, int >::const_iterator property = n.properties.find( key );
+				if ( property != n.properties.end() ) schemas.push_back( property->second );
+
+				for ( typename std::vector< std::pair< int, int > >::const_iterator i = n.pattern_properties.begin(); i != n.pattern_properties.end(); ++i )
+				{
+					if ( std::regex_search( key, _regexes[ i->first ] ) ) schemas.push_back( i->second );
+				}
+
+				if ( schemas.empty() && n.additional_properties >= 0 ) schemas.push_back( n.additional_properties );
+			}
+
+			bool valid( int index, const var_type &value, validation_error *error ) const
+			{
+				const node &n = _nodes[ index ];
+
+				if ( n.always_false ) return fail( error, "false" );
+
+				if ( n.ref >= 0 && !valid( n.ref, value, error ) ) return false;
+
+				switch ( value.type )
+				{
+					case Number:
+						if ( !check_number( n, value.toNumber(), error ) ) return false;
+						break;
+					case String:
+						if ( n.types || n.min_length || n.max_length != Unbounded || n.pattern >= 0 )
+						{
+							const string_type string( value.toString() );
+							if ( !check_string( n, string.begin(), string.end(), error ) ) return false;
+						}
+						break;
+					case Array:
+					{
+						if ( !check_type( n, Array, error ) ) return false;
+						if ( !check_count( static_cast< long >( value.size() ), n.min_items, n.max_items, "minItems", "maxItems", error ) ) return false;
+
+						long contained = 0;
+						size_t position = 0;
+						for ( typename var_type::const_iterator i = value.begin(); i != value.end(); ++i, ++position )
+						{
+							const int item = position < n.prefix_items.size() ? n.prefix_items[ position ] : n.items;
+							if ( item >= 0 && !valid( item, i->value, error ) ) return fail_at( error, position );
+							if ( n.contains >= 0 && valid( n.contains, i->value, 0 ) ) ++contained;
+							if ( n.unique_items )
+							{
+								for ( typename var_type::const_iterator j = value.begin(); j != i; ++j )
+								{
+									if ( j->value.equals( i->value ) ) return fail( error, "uniqueItems" );
+								}
+							}
+						}
+
+						if ( n.contains >= 0 && !check_count( contained, n.min_contains, n.max_contains, "contains", "maxContains", error ) ) return false;
+						break;
+					}
+					case Object:
+					{
+						if ( !check_type( n, Object, error ) ) return false;
+						if ( !check_count( static_cast< long >( value.size() ), n.min_properties, n.max_properties, "minProperties", "maxProperties", error ) ) return false;
+
+						std::vector< bool > seen( n.required.size(), false );
+						size_t seen_count = 0;
+						std::vector< int > schemas;
+
+						for ( typename var_type::const_iterator i = value.begin(); i != value.end(); ++i )
+						{
+							if ( !key_valid( n, i->key, error ) ) return fail_at( error, i->key );
+
+							member_schemas( n, i->key, schemas );
+							for ( std::vector< int >::const_iterator s = schemas.begin(); s != schemas.end(); ++s )
+							{
+								if ( !valid( *s, i->value, error ) ) return fail_at( error, i->key );
+							}
+
+							if ( !n.required.empty() )
+							{
+								typename std::tr1::unordered_map< string_type, size_t >::const_iterator r = n.required.find( i->key );
+								if ( r != n.required.end() && !seen[ r->second ] )
+								{
+									seen[ r->second ] = true;
+									++seen_count;
+								}
+							}
+						}
+
+						if ( seen_count != n.required.size() ) return fail( error, "required" );
+
+						for ( typename std::vector< std::pair< string_type, std::vector< string_type > > >::const_iterator i = n.dependent_required.begin(); i != n.dependent_required.end(); ++i )
+						{
+							if ( !value.has_key( i->first ) ) continue;
+							for ( typename std::vector< string_type >::const_iterator j = i->second.begin(); j != i->second.end(); ++j )
+							{
+								if ( !value.has_key( *j ) ) return fail( error, "dependentRequired" );
+							}
+						}
+						break;
+					}
+					case Bool:
+						if ( !check_type( n, Bool, error ) ) return false;
+						break;
+					case Null:
+					case Undefined:
+					case TypeCount:
+						if ( !check_type( n, Null, error ) ) return false;
+						break;
+				}
+
+				if ( !n.enums.empty() && !listed( n.enums, value ) ) return fail( error, "enum" );
+
+				if ( n.has_const && !n.constant.equals( value ) ) return fail( error, "const" );
+
+				for ( std::vector< int >::const_iterator i = n.all_of.begin(); i != n.all_of.end(); ++i )
+				{
+					if ( !valid( *i, value, error ) ) return false;
+				}
+
+				if ( !n.any_of.empty() )
+				{
+					std::vector< int >::const_iterator i = n.any_of.begin();
+					while ( i != n.any_of.end() && !valid( *i, value, 0 ) ) ++i;
+					if ( i == n.any_of.end() ) return fail( error, "anyOf" );
+				}
+
+				if ( !n.one_of.empty() )
+				{
+					size_t matches = 0;
+					for ( std::vector< int >::const_iterator i = n.one_of.begin(); i != n.one_of.end() && matches < 2; ++i )
+					{
+						if ( valid( *i, value, 0 ) ) ++matches;
+					}
+					if ( matches != 1 ) return fail( error, "oneOf" );
+				}
+
+				if ( n.not_ >= 0 && valid( n.not_, value, 0 ) ) return fail( error, "not" );
+
+				if ( n.if_ >= 0 )
+				{
+					const int branch = valid( n.if_, value, 0 ) ? n.then_ : n.else_;
+					if ( branch >= 0 && !valid( branch, value, error ) ) return false;
+				}
+
+				return true;
+			}
+
+			/* validates the value starting at the current token, leaves reader on its last token */
+			template < class Reader >
+			bool stream_valid( int index, Reader &reader, validation_error *error ) const
+			{
+				const node &n = _nodes[ index ];
+
+				if ( n.needs_tree )
+				{
+					basic_parser< CopyBehaviour, Char > parser;
+					return valid( index, parser.read( reader, parse_options::passthrough() ), error );
+				}
+
+				if ( n.always_false )
+				{
+					reader.skip();
+					return fail( error, "false" );
+				}
+
+				if ( n.ref >= 0 ) return stream_valid( n.ref, reader, error );
+
+				switch ( reader.token() )
+				{
+					case tokens::Null:
+						return check_type( n, Null, error );
+					case tokens::True:
+					case tokens::False:
+						return check_type( n, Bool, error );
+					case tokens::Number:
+						return check_number( n, reader.number(), error );
+					case tokens::String:
+						return check_string( n, reader.value().begin(), reader.value().end(), error );
+					case tokens::BeginArray:
+					{
+						if ( !check_type( n, Array, error ) ) return false;
+
+						size_t position = 0;
+						while ( reader.next() != tokens::EndArray )
+						{
+							if ( reader.token() == tokens::End ) return fail( error, "truncated" );
+
+							const int item = position < n.prefix_items.size() ? n.prefix_items[ position ] : n.items;
+							if ( item >= 0 )
+							{
+								if ( !stream_valid( item, reader, error ) ) return fail_at( error, position );
+							}
+							else
+							{
+								reader.skip();
+							}
+							++position;
+						}
+
+						return check_count( static_cast< long >( position ), n.min_items, n.max_items, "minItems", "maxItems", error );
+					}
+					case tokens::BeginObject:
+					{
+						if ( !check_type( n, Object, error ) ) return false;
+
+						std::vector< bool > seen( n.required.size(), false );
+						size_t seen_count = 0, members = 0;
+						std::vector< int > schemas;
+
+						while ( reader.next() == tokens::Key )
+						{
+							const string_type key( reader.string() );
+							++members;
+
+							if ( !key_valid( n, key, error ) ) return fail_at( error, key );
+
+							if ( !n.required.empty() )
+							{
+								typename std::tr1::unordered_map< string_type, size_t >::const_iterator r = n.required.find( key );
+								if ( r != n.required.end() && !seen[ r->second ] )
+								{
+									seen[ r->second ] = true;
+									++seen_count;
+								}
+							}
+
+							reader.next();
+
+							member_schemas( n, key, schemas );
+							if ( schemas.size() == 1 )
+							{
+								if ( !stream_valid( schemas[ 0 ], reader, error ) ) return fail_at( error, key );
+							}
+							else if ( !schemas.empty() )
+							{
+								basic_parser< CopyBehaviour, Char > parser;
+								const var_type value( parser.read( reader, parse_options::passthrough() ) );
+								for ( std::vector< int >::const_iterator s = schemas.begin(); s != schemas.end(); ++s )
+								{
+									if ( !valid( *s, value, error ) ) return fail_at( error, key );
+								}
+							}
+							else
+							{
+								reader.skip();
+							}
+						}
+
+						if ( reader.token() != tokens::EndObject ) return fail( error, "truncated" );
+
+						if ( seen_count != n.required.size() ) return fail( error, "required" );
+
+						return check_count( static_cast< long >( members ), n.min_properties, n.max_properties, "minProperties", "maxProperties", error );
+					}
+					default:
+						return fail( error, "truncated" );
+				}
+			}
+
+			var_type _root;
+			std::vector< node > _nodes;
+			std::vector< std::basic_regex< Char > > _regexes;
+			std::map< string_type, int > _compiled;
+			std::map< string_type, string_type > _anchors;
+	};
+
+	typedef basic_schema< CopyOnWrite, char > schema;
+	typedef basic_schema< CopyOnWrite, wchar_t > wschema;
+}
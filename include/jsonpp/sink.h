@@ -0,0 +1,163 @@
+#pragma once
+
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <cerrno>
+#ifdef _MSC_VER
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <jsonpp/misc.h>
+
+/*
+ * output targets for the writers in this library. A sink takes characters
+ * through push_back( c ) and append( start, count ); the buffered ones pass
+ * them on in blocks and flush when they go out of scope.
+ */
+namespace json
+{
+	template < class String >
+	class string_sink
+	{
+		public:
+
+			explicit string_sink( String &string ) :
+				_string( string ) { }
+
+			void push_back( typename String::value_type c )
+			{
+				_string.push_back( c );
+			}
+
+			void append( const typename String::value_type *start, size_t count )
+			{
+				_string.append( start, count );
+			}
+
+			void flush() { }
+
+		private:
+
+			String &_string;
+	};
+
+	/* collects characters in a fixed buffer and calls Derived::write( data, size ) per block */
+	template < class Derived, class Char >
+	class buffered_sink
+	{
+		public:
+
+			buffered_sink() :
+				_used( 0 ) { }
+
+			void push_back( Char c )
+			{
+				if ( _used == Size ) flush();
+				_buffer[ _used++ ] = c;
+			}
+
+			void append( const Char *start, size_t count )
+			{
+				if ( count > Size - _used )
+				{
+					flush();
+					if ( count >= Size )
+					{
+						static_cast< Derived* >( this )->write( start, count );
+						return;
+					}
+				}
+
+				std::copy( start, start + count, _buffer + _used );
+				_used += count;
+			}
+
+			void flush()
+			{
+				if ( _used ) static_cast< Derived* >( this )->write( _buffer, _used );
+				_used = 0;
+			}
+
+		private:
+
+			enum { Size = 65536 / sizeof( Char ) };
+
+			buffered_sink( const buffered_sink& );
+			buffered_sink& operator = ( const buffered_sink& );
+
+			Char _buffer[ Size ];
+			size_t _used;
+	};
+
+	template < class Char >
+	class stream_sink : public buffered_sink< stream_sink< Char >, Char >
+	{
+		public:
+
+			explicit stream_sink( std::basic_ostream< Char > &stream ) :
+				buffered_sink< stream_sink< Char >, Char >(),
+				_stream( stream ) { }
+
+			~stream_sink()
+			{
+				this->flush();
+			}
+
+			void write( const Char *start, size_t count )
+			{
+				_stream.write( start, static_cast< std::streamsize >( count ) );
+			}
+
+		private:
+
+			std::basic_ostream< Char > &_stream;
+	};
+
+	/* writes to a file descriptor, a failing write throws json::exception */
+	class descriptor_sink : public buffered_sink< descriptor_sink, char >
+	{
+		public:
+
+			explicit descriptor_sink( int descriptor ) :
+				buffered_sink< descriptor_sink, char >(),
+				_descriptor( descriptor ) { }
+
+			~descriptor_sink()
+			{
+				try
+				{
+					flush();
+				}
+				catch ( const exception& )
+				{
+				}
+			}
+
+			void write( const char *start, size_t count )
+			{
+				while ( count )
+				{
+#ifdef _MSC_VER
+					const int written = ::_write( _descriptor, start, static_cast< unsigned int >( count ) );
+#else
+					const ssize_t written = ::write( _descriptor, start, count );
+#endif
+					if ( written < 0 )
+					{
+						if ( errno == EINTR ) continue;
+						throw exception( "write to descriptor" ) << _descriptor << "failed with errno" << errno;
+					}
+
+					start += written;
+					count -= static_cast< size_t >( written );
+				}
+			}
+
+		private:
+
+			int _descriptor;
+	};
+}
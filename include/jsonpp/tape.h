@@ -0,0 +1,736 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <jsonpp/var.h>
+#include <jsonpp/reader.h>
+
+namespace json
+{
+	/*
+	 * a parsed document as one array of 64 bit words and one buffer with the
+	 * characters of its strings and keys. A word holds a tag in its top byte
+	 * and a payload below it:
+	 *
+	 *   Null, True, False         one word
+	 *   Signed, Unsigned, Floating the tag, then the 64 bits of the number
+	 *   String                    offset in the buffer, then the length
+	 *   BeginArray, BeginObject   index of the word after the matching end,
+	 *                             then the number of elements or members
+	 *   EndArray, EndObject       index of the matching begin
+	 *
+	 * A member is its key, laid out as a String, followed by its value. Any
+	 * value is skipped with one jump, see next().
+	 */
+	namespace tape_format
+	{
+		enum Tag
+		{
+			Null,
+			True,
+			False,
+			Signed,
+			Unsigned,
+			Floating,
+			String,
+			BeginArray,
+			EndArray,
+			BeginObject,
+			EndObject
+		};
+
+		const unsigned int Shift = 56;
+
+		const unsigned long long Payload = ( 1ULL << Shift ) - 1;
+
+		inline unsigned long long word( Tag tag, unsigned long long payload = 0 )
+		{
+			return ( static_cast< unsigned long long >( tag ) << Shift ) | payload;
+		}
+
+		inline Tag tag( unsigned long long word )
+		{
+			return static_cast< Tag >( word >> Shift );
+		}
+
+		inline unsigned long long payload( unsigned long long word )
+		{
+			return word & Payload;
+		}
+
+		/* the index of the word after the value that starts at index */
+		inline size_t next( const unsigned long long *words, size_t index )
+		{
+			switch ( tag( words[ index ] ) )
+			{
+				case BeginArray:
+				case BeginObject:
+					return static_cast< size_t >( payload( words[ index ] ) );
+				case Signed:
+				case Unsigned:
+				case Floating:
+				case String:
+					return index + 2;
+				default:
+					return index + 1;
+			}
+		}
+	}
+
+	template < class Char >
+	class basic_tape_view;
+
+	/*
+	 * read only document for read mostly work, parsed straight into a tape
+	 * instead of a tree of shared nodes, see tape_format. A tape can be kept
+	 * and parsed into again, it reuses what it allocated. Repeated keys are
+	 * kept as written, lookups find the first one.
+	 */
+	template < class Char >
+	class basic_tape
+	{
+		public:
+
+			typedef std::basic_string< Char > string_type;
+
+			typedef basic_tape_view< Char > view_type;
+
+			basic_tape() :
+				_words(),
+				_strings(),
+				_open(),
+				_key( false ),
+				_value(),
+				_whitespace() { }
+
+			explicit basic_tape( const string_type &text, const parse_limits &limits = parse_limits() ) :
+				_words(),
+				_strings(),
+				_open(),
+				_key( false ),
+				_value(),
+				_whitespace()
+			{
+				parse( text.begin(), text.end(), limits );
+			}
+
+			/* replaces the document with the first value in [ start, end ) */
+			template < class I >
+			void parse( I start, const I &end, const parse_limits &limits = parse_limits() )
+			{
+				clear();
+
+				basic_reader< Char, I > reader( start, end, limits );
+				reader.swap_buffers( _value, _whitespace );
+
+				try
+				{
+					read( reader );
+				}
+				catch ( ... )
+				{
+					reader.swap_buffers( _value, _whitespace );
+					clear();
+					throw;
+				}
+
+				reader.swap_buffers( _value, _whitespace );
+			}
+
+			void parse( const string_type &text, const parse_limits &limits = parse_limits() )
+			{
+				parse( text.begin(), text.end(), limits );
+			}
+
+			void clear()
+			{
+				_words.clear();
+				_strings.clear();
+				_open.clear();
+				_key = false;
+			}
+
+			/* Undefined for an empty tape */
+			view_type root() const
+			{
+				if ( _words.empty() ) return view_type();
+				return view_type( &_words[ 0 ], _strings.data(), 0 );
+			}
+
+			const std::vector< unsigned long long >& words() const
+			{
+				return _words;
+			}
+
+			/* the characters of all strings and keys, each followed by a 0 */
+			const string_type& strings() const
+			{
+				return _strings;
+			}
+
+		private:
+
+			template < class I >
+			void read( basic_reader< Char, I > &reader )
+			{
+				for ( tokens::Token token = reader.next(); token != tokens::End; token = reader.next() )
+				{
+					switch ( token )
+					{
+						case tokens::BeginObject:
+							open( tape_format::BeginObject, reader );
+							break;
+						case tokens::BeginArray:
+							open( tape_format::BeginArray, reader );
+							break;
+						case tokens::EndObject:
+						case tokens::EndArray:
+							close();
+							break;
+						case tokens::Key:
+							++_words[ _open.back() + 1 ];
+							put_string( reader.value() );
+							_key = true;
+							break;
+						case tokens::String:
+							element( reader );
+							put_string( reader.value() );
+							break;
+						case tokens::Number:
+							element( reader );
+							put_number( reader );
+							break;
+						case tokens::True:
+							element( reader );
+							_words.push_back( tape_format::word( tape_format::True ) );
+							break;
+						case tokens::False:
+							element( reader );
+							_words.push_back( tape_format::word( tape_format::False ) );
+							break;
+						case tokens::Null:
+							element( reader );
+							_words.push_back( tape_format::word( tape_format::Null ) );
+							break;
+						default:
+							break;
+					}
+
+					if ( _open.empty() ) return;
+				}
+
+				/* truncated input, like the parser the open containers are completed */
+				while ( !_open.empty() ) close();
+			}
+
+			/* counts a value that starts here in the container it is part of */
+			template < class I >
+			void element( const basic_reader< Char, I > &reader )
+			{
+				if ( _open.empty() ) return;
+
+				const size_t container = _open.back();
+
+				if ( tape_format::tag( _words[ container ] ) == tape_format::BeginArray )
+				{
+					++_words[ container + 1 ];
+				}
+				else if ( !_key )
+				{
+					throw exception( "expected a key at offset" ) << reader.offset();
+				}
+
+				_key = false;
+			}
+
+			template < class I >
+			void open( tape_format::Tag tag, const basic_reader< Char, I > &reader )
+			{
+				element( reader );
+
+				_open.push_back( _words.size() );
+				_words.push_back( tape_format::word( tag ) );
+				_words.push_back( 0 );
+			}
+
+			void close()
+			{
+				const size_t begin = _open.back();
+				const bool object = tape_format::tag( _words[ begin ] ) == tape_format::BeginObject;
+
+				/* a key without a value gets null */
+				if ( _key ) _words.push_back( tape_format::word( tape_format::Null ) );
+				_key = false;
+
+				_open.pop_back();
+				_words.push_back( tape_format::word( object ? tape_format::EndObject : tape_format::EndArray, begin ) );
+				_words[ begin ] = tape_format::word( object ? tape_format::BeginObject : tape_format::BeginArray, checked( _words.size() ) );
+			}
+
+			void put_string( const Buffer< Char > &buffer )
+			{
+				_words.push_back( tape_format::word( tape_format::String, checked( _strings.size() ) ) );
+				_words.push_back( buffer.size() );
+				_strings.append( buffer.begin(), buffer.end() );
+				_strings.push_back( 0 );
+			}
+
+			/* integers that fit 64 bits are kept exact, everything else becomes a double */
+			template < class I >
+			void put_number( const basic_reader< Char, I > &reader )
+			{
+				bool negative = false;
+				unsigned long long magnitude = 0;
+				long long value = 0;
+
+				if ( reader.integer( negative, magnitude ) )
+				{
+					if ( !negative )
+					{
+						_words.push_back( tape_format::word( tape_format::Unsigned ) );
+						_words.push_back( magnitude );
+						return;
+					}
+
+					if ( negate_integer( magnitude, value ) )
+					{
+						_words.push_back( tape_format::word( tape_format::Signed ) );
+						_words.push_back( static_cast< unsigned long long >( value ) );
+						return;
+					}
+				}
+
+				const double number = static_cast< double >( reader.number() );
+				unsigned long long bits;
+				std::memcpy( &bits, &number, sizeof( bits ) );
+
+				_words.push_back( tape_format::word( tape_format::Floating ) );
+				_words.push_back( bits );
+			}
+
+			static unsigned long long checked( size_t payload )
+			{
+				if ( payload > tape_format::Payload ) throw exception( "document too large for a tape" );
+				return payload;
+			}
+
+			std::vector< unsigned long long > _words;
+			string_type _strings;
+			std::vector< size_t > _open;
+			bool _key;
+			Buffer< Char > _value, _whitespace;
+	};
+
+	/*
+	 * read only cursor at one value of a tape, with the const interface of
+	 * basic_var. It points into the tape, which has to outlive it and must not
+	 * be parsed into meanwhile. Stepping to the next element is one jump, so
+	 * operator[] on an array or object is linear in the elements before the
+	 * one asked for, not in their size.
+	 */
+	template < class Char >
+	class basic_tape_view
+	{
+		public:
+
+			typedef std::basic_string< Char > string_type;
+
+			struct entry;
+
+			class const_iterator;
+
+			basic_tape_view() :
+				_words( 0 ),
+				_strings( 0 ),
+				_index( 0 ) { }
+
+			Types type() const
+			{
+				if ( !_words ) return Undefined;
+
+				switch ( tag() )
+				{
+					case tape_format::Null:
+						return Null;
+					case tape_format::True:
+					case tape_format::False:
+						return Bool;
+					case tape_format::Signed:
+					case tape_format::Unsigned:
+					case tape_format::Floating:
+						return Number;
+					case tape_format::String:
+						return String;
+					case tape_format::BeginArray:
+						return Array;
+					case tape_format::BeginObject:
+						return Object;
+					default:
+						return Undefined;
+				}
+			}
+
+			size_t size() const
+			{
+				switch ( type() )
+				{
+					case String:
+					case Array:
+					case Object:
+						return static_cast< size_t >( _words[ _index + 1 ] );
+					default:
+						return 0;
+				}
+			}
+
+			bool empty() const
+			{
+				return size() == 0;
+			}
+
+			const_iterator begin() const
+			{
+				return const_iterator( *this, type() == Array || type() == Object ? _index + 2 : 0 );
+			}
+
+			const_iterator end() const
+			{
+				return const_iterator( *this, type() == Array || type() == Object ? static_cast< size_t >( tape_format::payload( _words[ _index ] ) ) - 1 : 0 );
+			}
+
+			/* Undefined for an index past the end or a view that is no array */
+			basic_tape_view operator[]( size_t index ) const
+			{
+				if ( type() != Array || index >= size() ) return basic_tape_view();
+
+				size_t at = _index + 2;
+				while ( index-- ) at = tape_format::next( _words, at );
+
+				return basic_tape_view( _words, _strings, at );
+			}
+
+			basic_tape_view operator[]( int index ) const
+			{
+				return operator[]( static_cast< size_t >( index ) );
+			}
+
+			/* Undefined for a missing member */
+			basic_tape_view operator[]( const string_type &key ) const
+			{
+				return find( key.data(), key.size() );
+			}
+
+			basic_tape_view operator[]( const Char *key ) const
+			{
+				return find( key, std::char_traits< Char >::length( key ) );
+			}
+
+			bool has_key( const string_type &key ) const
+			{
+				return find( key.data(), key.size() ).type() != Undefined;
+			}
+
+			/* the characters of a String, in the tape and 0 terminated */
+			const Char* data() const
+			{
+				if ( type() != String ) return 0;
+				return _strings + tape_format::payload( _words[ _index ] );
+			}
+
+			/* the index of the first word of the value in the tape */
+			size_t position() const
+			{
+				return _index;
+			}
+
+			string_type toString() const
+			{
+				switch ( type() )
+				{
+					case Array:
+						return convert_string< Char >( "Array" );
+					case Object:
+						return convert_string< Char >( "Object" );
+					case String:
+						return string_type( data(), size() );
+					case Number:
+						switch ( tag() )
+						{
+							case tape_format::Signed:
+							{
+								const long long value = toInteger();
+								return integer_to_string< Char >( value < 0 ? 0 - bits() : bits(), value < 0 );
+							}
+							case tape_format::Unsigned:
+								return integer_to_string< Char >( bits(), false );
+							default:
+								return number_to_string< Char >( toNumber() );
+						}
+					case Bool:
+						return convert_string< Char >( toBool() ? "true" : "false" );
+					case Null:
+						return convert_string< Char >( "null" );
+					default:
+						return string_type();
+				}
+			}
+
+			long double toNumber() const
+			{
+				switch ( type() )
+				{
+					case Number:
+						switch ( tag() )
+						{
+							case tape_format::Signed:
+								return static_cast< long double >( toInteger() );
+							case tape_format::Unsigned:
+								return static_cast< long double >( bits() );
+							default:
+							{
+								double result;
+								const unsigned long long value = bits();
+								std::memcpy( &result, &value, sizeof( result ) );
+								return result;
+							}
+						}
+					case Bool:
+						return toBool() ? 1 : 0;
+					case String:
+					{
+						const string_type text = toString();
+						return dec_string_to_number< string_type, long double >( text.begin(), text.end() );
+					}
+					default:
+						return 0;
+				}
+			}
+
+			long long toInteger() const
+			{
+				if ( exact() ) return static_cast< long long >( bits() );
+				return static_cast< long long >( toNumber() );
+			}
+
+			unsigned long long toUnsigned() const
+			{
+				if ( exact() ) return bits();
+				return static_cast< unsigned long long >( toNumber() );
+			}
+
+			bool toBool() const
+			{
+				switch ( type() )
+				{
+					case Bool:
+						return tag() == tape_format::True;
+					case Number:
+						return toNumber() != 0;
+					case String:
+						return size() != 0;
+					case Array:
+					case Object:
+						return true;
+					default:
+						return false;
+				}
+			}
+
+			/* copies the value out of the tape, for a subtree that has to change */
+			template < template< class > class CopyBehaviour >
+			basic_var< CopyBehaviour, Char > var() const
+			{
+				typedef basic_var< CopyBehaviour, Char > var_type;
+
+				var_type result;
+				std::vector< std::pair< basic_tape_view, var_type* > > pending( 1, std::make_pair( *this, &result ) );
+
+				while ( !pending.empty() )
+				{
+					const basic_tape_view view = pending.back().first;
+					var_type &target = *pending.back().second;
+					pending.pop_back();
+
+					switch ( view.type() )
+					{
+						case Array:
+							target = var_type( Array );
+							for ( const_iterator i = view.begin(); i != view.end(); ++i ) target.push( var_type() );
+							break;
+						case Object:
+							target = var_type( Object );
+							for ( const_iterator i = view.begin(); i != view.end(); ++i ) target.push_member( typename var_type::key_type( i->key.data(), i->key.size() ), var_type() );
+							break;
+						case Number:
+							switch ( view.tag() )
+							{
+								case tape_format::Signed:
+									target = var_type( view.toInteger() );
+									break;
+								case tape_format::Unsigned:
+									target = var_type( view.toUnsigned() );
+									break;
+								default:
+									target = var_type( view.toNumber() );
+									break;
+							}
+							continue;
+						case String:
+							target = var_type( view.toString() );
+							continue;
+						case Bool:
+							target = var_type( view.toBool() );
+							continue;
+						default:
+							target = var_type( view.type() );
+							continue;
+					}
+
+					typename var_type::iterator element = target.array().begin();
+					for ( const_iterator i = view.begin(); i != view.end(); ++i, ++element )
+					{
+						pending.push_back( std::make_pair( i->value, &element->value ) );
+					}
+				}
+
+				return result;
+			}
+
+		private:
+
+			friend class basic_tape< Char >;
+
+			basic_tape_view( const unsigned long long *words, const Char *strings, size_t index ) :
+				_words( words ),
+				_strings( strings ),
+				_index( index ) { }
+
+			tape_format::Tag tag() const
+			{
+				return tape_format::tag( _words[ _index ] );
+			}
+
+			unsigned long long bits() const
+			{
+				return _words[ _index + 1 ];
+			}
+
+			bool exact() const
+			{
+				return _words && ( tag() == tape_format::Signed || tag() == tape_format::Unsigned );
+			}
+
+			basic_tape_view find( const Char *key, size_t length ) const
+			{
+				if ( type() != Object ) return basic_tape_view();
+
+				const size_t end = static_cast< size_t >( tape_format::payload( _words[ _index ] ) ) - 1;
+				for ( size_t at = _index + 2; at != end; at = tape_format::next( _words, at + 2 ) )
+				{
+					if ( _words[ at + 1 ] != length ) continue;
+
+					const Char *characters = _strings + tape_format::payload( _words[ at ] );
+					if ( std::equal( key, key + length, characters ) ) return basic_tape_view( _words, _strings, at + 2 );
+				}
+
+				return basic_tape_view();
+			}
+
+			const unsigned long long *_words;
+			const Char *_strings;
+			size_t _index;
+	};
+
+	/* a member of an object, or an element of an array with an Undefined key */
+	template < class Char >
+	struct basic_tape_view< Char >::entry
+	{
+		entry() :
+			key(),
+			value() { }
+
+		basic_tape_view key;
+		basic_tape_view value;
+	};
+
+	template < class Char >
+	class basic_tape_view< Char >::const_iterator
+	{
+		public:
+
+			const_iterator() :
+				_container(),
+				_at( 0 ),
+				_current() { }
+
+			const entry& operator * () const
+			{
+				return _current;
+			}
+
+			const entry* operator -> () const
+			{
+				return &_current;
+			}
+
+			const_iterator& operator ++ ()
+			{
+				_at = tape_format::next( _container._words, _current.value._index );
+				load();
+				return *this;
+			}
+
+			bool operator == ( const const_iterator &rhs ) const
+			{
+				return _at == rhs._at;
+			}
+
+			bool operator != ( const const_iterator &rhs ) const
+			{
+				return _at != rhs._at;
+			}
+
+		private:
+
+			friend class basic_tape_view;
+
+			const_iterator( const basic_tape_view &container, size_t at ) :
+				_container( container ),
+				_at( at ),
+				_current()
+			{
+				load();
+			}
+
+			void load()
+			{
+				if ( _container.type() != Array && _container.type() != Object ) return;
+
+				const tape_format::Tag tag = tape_format::tag( _container._words[ _at ] );
+				if ( tag == tape_format::EndArray || tag == tape_format::EndObject ) return;
+
+				if ( _container.type() == Object )
+				{
+					_current.key = basic_tape_view( _container._words, _container._strings, _at );
+					_current.value = basic_tape_view( _container._words, _container._strings, _at + 2 );
+				}
+				else
+				{
+					_current.value = basic_tape_view( _container._words, _container._strings, _at );
+				}
+			}
+
+			basic_tape_view _container;
+			size_t _at;
+			entry _current;
+	};
+
+	typedef basic_tape< char > tape;
+	typedef basic_tape< wchar_t > wtape;
+
+	typedef basic_tape_view< char > tape_view;
+	typedef basic_tape_view< wchar_t > wtape_view;
+}
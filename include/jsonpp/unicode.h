@@ -3,6 +3,8 @@
 #include <string>
 #include <sstream>
 
+#include <jsonpp/sink.h>
+
 namespace json
 {
 	enum Bitmasks
@@ -70,15 +72,15 @@ namespace json
 		return output;
 	}
 
-	template < class Char >
-	inline std::basic_string< Char > utf8Decode( const std::basic_string< Char > &string )
+	/*
+	 * writes string escaped for a JSON string literal to sink: the short
+	 * escapes for '"', '\\', '/' and \b \f \n \r \t, multi byte UTF-8
+	 * sequences as \u followed by the code point in hexadecimal
+	 */
+	template < class I, class Sink >
+	void utf8Escape( I input, const I &end, Sink &sink )
 	{
-		if ( string.empty() ) return string;
-
-		std::basic_stringstream< Char > stream;
-
-		typename std::basic_string< Char >::const_iterator input = string.begin();
-		const typename std::basic_string< Char >::const_iterator &end = string.end();
+		static const char hex[] = "0123456789abcdef";
 
 		size_t diff = 0;
 
@@ -92,31 +94,39 @@ namespace json
 				switch ( *input )
 				{
 					case '"':
-						stream << '\\' << '"';
+						sink.push_back( '\\' );
+						sink.push_back( '"' );
 						break;
 					case '\\':
-						stream << '\\' << '\\';
+						sink.push_back( '\\' );
+						sink.push_back( '\\' );
 						break;
 					case '/':
-						stream << '\\' << '/';
+						sink.push_back( '\\' );
+						sink.push_back( '/' );
 						break;
 					case '\b':
-						stream << '\\' << 'b';
+						sink.push_back( '\\' );
+						sink.push_back( 'b' );
 						break;
 					case '\f':
-						stream << '\\' << 'f';
+						sink.push_back( '\\' );
+						sink.push_back( 'f' );
 						break;
 					case '\n':
-						stream << '\\' << 'n';
+						sink.push_back( '\\' );
+						sink.push_back( 'n' );
 						break;
 					case '\r':
-						stream << '\\' << 'r';
+						sink.push_back( '\\' );
+						sink.push_back( 'r' );
 						break;
 					case '\t':
-						stream << '\\' << 't';
+						sink.push_back( '\\' );
+						sink.push_back( 't' );
 						break;
 					default:
-						stream << *input;
+						sink.push_back( *input );
 						break;
 				}
 
@@ -154,7 +164,7 @@ namespace json
 				unicode = ( ( *input & 0x03 ) << 24 ) | ( ( *( input + 1 ) & LowerSixBits ) << 18 )
 					   | ( ( *( input + 2 ) & LowerSixBits ) << 12 ) | ( ( *( input + 3 ) & LowerSixBits ) << 6 )
 					   | ( *( input + 4 ) & LowerSixBits );
-			   input += 5;
+				input += 5;
 			}
 			// 1111110x 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx 10xxxxxx
 			else if ( unicode < Upper6Bits )
@@ -165,10 +175,29 @@ namespace json
 					| ( ( *( input + 4 ) & LowerSixBits ) << 6 ) | ( *( input + 5 ) & LowerSixBits );
 				input += 6;
 			}
+			else
+			{
+				++input;
+			}
 
-			stream << std::hex << "\\u" << unicode;
+			sink.push_back( '\\' );
+			sink.push_back( 'u' );
+
+			int shift = 28;
+			while ( shift > 0 && !( ( static_cast< unsigned int >( unicode ) >> shift ) & 0xF ) ) shift -= 4;
+			for ( ; shift >= 0; shift -= 4 ) sink.push_back( hex[ ( static_cast< unsigned int >( unicode ) >> shift ) & 0xF ] );
 		}
+	}
+
+	template < class Char >
+	inline std::basic_string< Char > utf8Decode( const std::basic_string< Char > &string )
+	{
+		std::basic_string< Char > result;
+		result.reserve( string.size() + 2 );
+
+		string_sink< std::basic_string< Char > > sink( result );
+		utf8Escape( string.begin(), string.end(), sink );
 
-		return stream.str();
+		return result;
 	}
 }
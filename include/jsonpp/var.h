@@ -4,20 +4,40 @@
 #include <cmath>
 #include <algorithm>
 #include <string>
+#include <functional>
 #ifdef _MSC_VER
 #include <memory>
+#include <functional>
+#include <unordered_map>
 #else
 #include <tr1/memory>
+#include <tr1/functional>
+#include <tr1/unordered_map>
 #endif
 #include <limits>
+#include <deque>
 
 #include <jsonpp/unicode.h>
 #include <jsonpp/misc.h>
 #include <jsonpp/basic_var_data.h>
 #include <jsonpp/register_type.h>
+#include <jsonpp/pool.h>
+#include <jsonpp/base64.h>
 
 namespace json
 {
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_parallel_writer;
+
+	template < template< class > class CopyBehaviour, class Char >
+	class basic_parser;
+
+	template < class Char >
+	class basic_view;
+
+	template < class Char >
+	class basic_tape_view;
+
 	template < template< class > class CopyBehaviour, class Char >
 	struct basic_var
 	{
@@ -29,9 +49,11 @@ namespace json
 
 		typedef long double number_type;
 
-		typedef key_value< string_type, basic_var > value_type;
+		typedef basic_key< Char > key_type;
 
-		typedef std::vector< value_type > array_type;
+		typedef key_value< key_type, basic_var > value_type;
+
+		typedef typename basic_data::array_type array_type;
 
 		typedef typename array_type::iterator iterator;
 
@@ -49,11 +71,109 @@ namespace json
 				type( type ),
 				_data( basic_data() ) { }
 
+			basic_var( const basic_var &copy ) :
+				type( copy.type ),
+				_data( copy._data ) { }
+
 			template < class InputType >
 			basic_var( const InputType &type ) :
 				type( register_type< basic_var, InputType >::type( type ) ),
 				_data( register_type< basic_var, InputType >::to_json( type ) ) { }
 
+			/*
+			 * a Number that keeps text as its source: serialize writes it back byte
+			 * for byte and it is only converted when its value is read
+			 */
+			static basic_var raw_number( const string_type &text )
+			{
+				return basic_var( Number, basic_data::text( text ) );
+			}
+
+			/*
+			 * an Array or Object that keeps text, its JSON source, as is: serialize
+			 * splices it into the output and it is only parsed when an element is
+			 * first read, which keeps the text, or written, which drops it. text is
+			 * trusted to be valid JSON.
+			 */
+			static basic_var raw_fragment( const string_type &text )
+			{
+				typename string_type::const_iterator first = text.begin();
+				while ( first != text.end() && ( *first == ' ' || *first == '\t' || *first == '\r' || *first == '\n' ) ) ++first;
+
+				if ( first == text.end() || ( *first != '[' && *first != '{' ) ) throw exception( "a fragment holds an array or object" );
+
+				return basic_var( *first == '[' ? Array : Object, basic_data::fragment( text ) );
+			}
+
+			/*
+			 * a String that holds count bytes as they are, for binary payloads: it
+			 * reads and serializes as their base64, which is only produced while
+			 * writing, straight into the output
+			 */
+			static basic_var raw_bytes( const char *start, size_t count )
+			{
+				return basic_var( String, basic_data::bytes( start, count ) );
+			}
+
+			/* true for a String that holds bytes, see raw_bytes */
+			bool binary() const
+			{
+				return _data->_binary;
+			}
+
+			/*
+			 * the bytes of a String: those it holds, or its text decoded as base64.
+			 * Text is decoded on every call, a full pass over it, because the data
+			 * may be shared with other values, see the parser's short strings, and
+			 * a const read leaves it as it is. Call to_bytes() first to read the
+			 * bytes of a parsed String more than once.
+			 */
+			std::vector< char > bytes() const
+			{
+				if ( type != String ) return std::vector< char >();
+
+				const basic_data &data = *_data.operator->();
+
+				if ( !data._binary ) return basic_base64< Char >::decode( data._string );
+
+				std::vector< char > result( data._string.size() );
+				for ( size_t i = 0; i < result.size(); ++i ) result[ i ] = static_cast< char >( data._string[ i ] );
+				return result;
+			}
+
+			/*
+			 * keeps the bytes of a base64 String as raw_bytes does, so bytes() copies
+			 * them instead of decoding the text again. Only done when they encode
+			 * back to the same text, false otherwise.
+			 */
+			bool to_bytes()
+			{
+				const basic_var &inspect = *this;
+
+				if ( type != String || inspect._data->_binary ) return false;
+
+				const std::vector< char > decoded( inspect.bytes() );
+				const char *start = decoded.empty() ? 0 : &decoded[ 0 ];
+
+				if ( basic_base64< Char >::encode( start, decoded.size() ) != inspect._data->_string ) return false;
+
+				*this = raw_bytes( start, decoded.size() );
+				return true;
+			}
+
+			/* true while the value is a fragment that has not been parsed, see raw_fragment */
+			bool fragment() const
+			{
+				return _data->_fragment;
+			}
+
+			/* true when write() with Cached would copy a form it stored for this container, see write() */
+			bool cached( unsigned int markup = Compact, unsigned int level = 0 ) const
+			{
+				markup &= ~( Cached | IndentFirstItem | Compact );
+				return cacheable() && cached_form( markup, markup & HumanReadable ? level : 0 );
+			}
+
 			basic_var& operator = ( const basic_var &rhs )
 			{
 				if ( this != &rhs )
@@ -65,6 +185,11 @@ namespace json
 				return *this;
 			}
 
+			~basic_var()
+			{
+				if ( ( type == Array || type == Object ) && _data.unique() ) release();
+			}
+
 			string_type toString() const
 			{
 				switch ( type )
@@ -74,24 +199,10 @@ namespace json
 					case Object:
 						return convert_string< Char >( "Object" );
 					case String:
+						if ( _data->_binary ) return encoded();
 						return _data->_string;
 					case Number:
-					{
-						std::basic_stringstream< Char > stream;
-						long double temp = 0;
-						stream.precision( std::numeric_limits< long double >::digits10 );
-						if ( std::modf( _data->_number, &temp ) != 0.0 )
-						{
-							// fraction
-							stream << _data->_number;
-						}
-						else
-						{
-							// integer
-							stream << _data->_number;
-						}
-						return stream.str();
-					}
+						return number_string();
 					case Bool:
 						return ( toBool() ? convert_string< Char >( "true" ) : convert_string< Char >( "false" ) );
 					case Null:
@@ -104,17 +215,41 @@ namespace json
 
 			long double toNumber() const
 			{
-				if ( isNaN( _data->_number ) )
+				const typename basic_data::number_value number = _data->number();
+
+				if ( isNaN( number.number ) )
 				{
-					std::basic_stringstream< Char > stream( _data->_string );
+					std::basic_stringstream< Char > stream( _data->_binary ? encoded() : _data->_string );
 					long double result;
 					stream >> result;
 					return result;
 				}
-				return _data->_number;
+				return number.number;
+			}
+
+			long long toInteger() const
+			{
+				const typename basic_data::number_value number = _data->number();
+
+				if ( number.format == basic_data::Signed || number.format == basic_data::Unsigned ) return static_cast< long long >( number.integer );
+
+				return static_cast< long long >( toNumber() );
+			}
+
+			unsigned long long toUnsigned() const
+			{
+				const typename basic_data::number_value number = _data->number();
+
+				if ( number.format == basic_data::Signed || number.format == basic_data::Unsigned ) return number.integer;
+
+				return static_cast< unsigned long long >( toNumber() );
 			}
 
-			long long toInteger() const { return toNumber(); }
+			/* whether a Number is an exact Signed or Unsigned integer or Floating, Text numbers are read first */
+			typename basic_data::NumberFormat number_format() const
+			{
+				return _data->number().format;
+			}
 
 			bool toBool() const
 			{
@@ -164,23 +299,33 @@ namespace json
 				return find_key( key, from ) != end();
 			}
 
+			const_iterator find_key( const key_type &key ) const
+			{
+				return std::find( begin(), end(), key );
+			}
+
+			bool has_key( const key_type &key ) const
+			{
+				return find_key( key ) != end();
+			}
+
 			basic_var& operator[]( const basic_var &key )
 			{
 				switch ( type )
 				{
 					case Number:
-						return operator[]( key._data->_number );
+						return operator[]( key.toNumber() );
 					default:
 						return operator[]( key.toString() );
 				}
 			}
 
-			const basic_var& operator[]( const basic_var &key ) const
+			const basic_var operator[]( const basic_var &key ) const
 			{
 				switch ( type )
 				{
 					case Number:
-						return operator[]( key._data->_number );
+						return operator[]( key.toNumber() );
 					default:
 						return operator[]( key.toString() );
 				}
@@ -188,35 +333,16 @@ namespace json
 
 			basic_var& operator[]( const char key[] ) { return operator []( string_type( key ) ); }
 
-			basic_var& operator[]( const string_type &key )
-			{
-				if ( type != Object )
-				{
-					const_cast< Types& >( type ) = Object;
-					_data->_array.clear();
-				}
-				iterator i = std::find( _data->_array.begin(), _data->_array.end(), key );
-				if ( i == _data->_array.end() )
-				{
-					_data->_array.push_back( value_type( key, Undefined ) );
+			basic_var& operator[]( const string_type &key ) { return member( key ); }
 
-					return _data->_array.back().value;
-				}
-				return i->value;
-			}
+			/* interned keys compare by pointer and are shared instead of copied when added */
+			basic_var& operator[]( const key_type &key ) { return member( key ); }
 
 			const basic_var& operator[]( const char key[] ) const { return operator []( string_type( key ) ); }
 
-			const basic_var& operator[]( const string_type &key ) const
-			{
-				const_iterator i = std::find( _data->_array.begin(), _data->_array.end(), key );
-				if ( i == _data->_array.end() )
-				{
-					static basic_var undefined( Undefined );
-					return undefined;
-				}
-				return i->value;
-			}
+			const basic_var& operator[]( const string_type &key ) const { return member( key ); }
+
+			const basic_var& operator[]( const key_type &key ) const { return member( key ); }
 
 			basic_var& operator[]( char index ) { return operator []( string_type( 1, index ) ); }
 
@@ -233,10 +359,11 @@ namespace json
 				if ( type != Array )
 				{
 					const_cast< Types& >( type ) = Array;
-					_data->_array.clear();
+					_data->clear_elements();
 				}
-				if ( index >= _data->_array.size() ) _data->_array.resize( index + 1, value_type() );
-				return _data->_array.operator[]( index ).value;
+				array_type &elements = lend();
+				if ( index >= elements.size() ) elements.resize( index + 1, value_type() );
+				return elements.operator[]( index ).value;
 			}
 
 			basic_var& operator[]( long index ) { return operator []( static_cast< unsigned int >( index ) ); }
@@ -258,54 +385,161 @@ namespace json
 
 			const basic_var& operator[]( unsigned char index ) const { return operator []( string_type( 1, index ) ); }
 
-			const basic_var& operator[]( short index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( short index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( unsigned short index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( unsigned short index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( int index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( int index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( unsigned int index ) const
+			/* by value, so packed numbers are read in place instead of being built into elements */
+			const basic_var operator[]( unsigned int index ) const
 			{
-				if ( index >= _data->_array.size() )
-				{
-					static basic_var undefined( Undefined );
-					return undefined;
-				}
-				return _data->_array.operator[]( index ).value;
+				if ( ( type != Array && type != Object ) || index >= _data->size() ) return basic_var( Undefined );
+				return element( index );
 			}
 
-			const basic_var& operator[]( long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( unsigned long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( unsigned long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( long long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( long long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( unsigned long long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( unsigned long long index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( float index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( float index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( double index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( double index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
-			const basic_var& operator[]( long double index ) const { return operator []( static_cast< unsigned int >( index ) ); }
+			const basic_var operator[]( long double index ) const { return operator []( static_cast< unsigned int >( index ) ); }
 
 			bool operator == ( const basic_var &rhs ) const
 			{
-				if ( type != rhs.type ) return false;
+				return equals( rhs, OrderedKeys );
+			}
+
+			/*
+			 * with UnorderedKeys objects compare equal regardless of the order of
+			 * their members. Walks both trees with an explicit stack, so nesting
+			 * depth is only bounded by memory.
+			 */
+			bool equals( const basic_var &rhs, Equality equality = UnorderedKeys ) const
+			{
+				std::vector< std::pair< const basic_var*, const basic_var* > > pending( 1, std::make_pair( this, &rhs ) );
 
-				if ( isNaN( _data->_number ) != isNaN( rhs._data->_number ) ) return false;
+				/* elements of packed layouts, read one by one as they are compared */
+				std::deque< basic_var > held;
 
-				if ( !isNaN( _data->_number ) )
+				while ( !pending.empty() )
 				{
-					if ( _data->_number != rhs._data->_number ) return false;
-				}
+					const basic_var &a = *pending.back().first, &b = *pending.back().second;
+					pending.pop_back();
+
+					if ( a.type != b.type ) return false;
+
+					if ( a._data.operator->() == b._data.operator->() ) continue;
+
+					size_t x = 0, y = 0;
+					if ( a.cached_hash( x, false ) && b.cached_hash( y, false ) && x != y ) return false;
+
+					if ( a.type == Number || a.type == Bool )
+					{
+						if ( !a.same_number( b ) ) return false;
+						continue;
+					}
+
+					if ( a.type != Array && a.type != Object )
+					{
+						if ( a._data->_binary != b._data->_binary ? a.toString() != b.toString() : a._data->_string != b._data->_string ) return false;
+						continue;
+					}
+
+					/* a fragment keeps its text in _string */
+					if ( a._data->_fragment && b._data->_fragment && a._data->_string == b._data->_string ) continue;
+
+					if ( a._data->size() != b._data->size() ) return false;
+
+					if ( a._data->packed() && b._data->packed() && a._data->_numbers && b._data->_numbers )
+					{
+						if ( !same_numbers( *a._data->_numbers, *b._data->_numbers ) ) return false;
+						continue;
+					}
+
+					const size_t first = pending.size();
 
-				if ( _data->_string != rhs._data->_string ) return false;
+					if ( a.type == Object && equality == UnorderedKeys )
+					{
+						if ( !a.pair_members( b, pending ) ) return false;
+					}
+					else if ( a._data->packed() || b._data->packed() )
+					{
+						for ( size_t i = 0, count = a._data->size(); i < count; ++i )
+						{
+							pending.push_back( std::make_pair( a.element( i, held ), b.element( i, held ) ) );
+						}
+					}
+					else
+					{
+						for ( const_iterator i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j )
+						{
+							if ( i->key != j->key ) return false;
+							pending.push_back( std::make_pair( &i->value, &j->value ) );
+						}
+					}
 
-				if ( _data->_array != rhs._data->_array ) return false;
+					/* so the first child is compared first */
+					std::reverse( pending.begin() + first, pending.end() );
+				}
 
 				return true;
 			}
 
+			/*
+			 * structural hash, objects hash the same regardless of member order.
+			 * Strings and containers cache theirs until a write access, one of a
+			 * container that handed out its elements is used while none of them
+			 * changed, see lent_check(). Safe to call from several threads.
+			 */
+			size_t hash() const
+			{
+				size_t cached = 0;
+				if ( cached_hash( cached, true ) ) return cached;
+
+				std::vector< hash_frame > frames( 1, hash_frame( *this ) );
+
+				for ( ;; )
+				{
+					hash_frame &frame = frames.back();
+
+					if ( frame.index < frame.count )
+					{
+						if ( !frame.elements )
+						{
+							frame.add( key_type(), frame.node->element_hash( frame.index ) );
+							continue;
+						}
+
+						const value_type &element = ( *frame.elements )[ frame.index ];
+
+						if ( !element.value.cached_hash( cached, true ) )
+						{
+							frames.push_back( hash_frame( element.value ) );
+							continue;
+						}
+
+						frame.add( element.key, cached );
+						continue;
+					}
+
+					const size_t result = frame.finish();
+					frames.pop_back();
+
+					if ( frames.empty() ) return result;
+
+					hash_frame &parent = frames.back();
+					parent.add( ( *parent.elements )[ parent.index ].key, result );
+				}
+			}
+
 			bool operator != ( const basic_var &rhs ) const
 			{
 				return !operator == ( rhs );
@@ -315,7 +549,17 @@ namespace json
 			{
 				if ( type == Number && rhs.type == Number )
 				{
-					_data->_number += rhs.toNumber();
+					const long long a = toInteger(), b = rhs.toInteger();
+
+					if ( number_format() == basic_data::Signed && rhs.number_format() == basic_data::Signed &&
+						( b > 0 ? a <= std::numeric_limits< long long >::max() - b : a >= std::numeric_limits< long long >::min() - b ) )
+					{
+						*this = basic_var( a + b );
+					}
+					else
+					{
+						*this = basic_var( toNumber() + rhs.toNumber() );
+					}
 				}
 				else
 				{
@@ -329,9 +573,10 @@ namespace json
 			{
 				if ( remove )
 				{
-					if ( index < _data->_array.size() && remove < _data->_array.size() - index )
+					if ( index < size() && remove <= size() - index )
 					{
-						_data->_array.erase( _data->_array.begin() + index, _data->_array.begin() + index + remove );
+						array_type &elements = array();
+						elements.erase( elements.begin() + index, elements.begin() + index + remove );
 					}
 				}
 
@@ -352,9 +597,10 @@ namespace json
 					splice( index, remove );
 				}
 
-				if ( index < _data->_array.size() )
+				if ( index <= size() )
 				{
-					_data->_array.insert( _data->_array.begin() + index, value_type( item ) );
+					array_type &elements = array();
+					elements.insert( elements.begin() + index, value_type( item ) );
 				}
 
 				if ( remove )
@@ -367,151 +613,277 @@ namespace json
 				}
 			}
 
+			bool erase( const string_type &key )
+			{
+				const array_type &current = static_cast< const basic_var& >( *this ).elements();
+				const size_t index = std::find( current.begin(), current.end(), key ) - current.begin();
+
+				if ( type != Object || index == current.size() ) return false;
+
+				array_type &members = array();
+				members.erase( members.begin() + index );
+
+				return true;
+			}
+
 			void push( const basic_var &value )
 			{
+				if ( value.type == Number && pack( value ) ) return;
+
 				if ( type != Array )
 				{
 					const_cast< Types& >( type ) = Array;
-					_data->_array.clear();
+					_data->clear_elements();
+				}
+				array().push_back( value_type( value ) );
+			}
+
+			/* push without building a var first, arrays of numbers stay packed */
+			void push_number( number_type number )
+			{
+				if ( !pack( number ) ) push( basic_var( number ) );
+			}
+
+			void push_integer( long long number )
+			{
+				if ( !pack( number ) ) push( basic_var( number ) );
+			}
+
+			/* appends a member without looking for an existing one, for callers that know key is new */
+			void push_member( const key_type &key, const basic_var &value )
+			{
+				if ( type != Object )
+				{
+					const_cast< Types& >( type ) = Object;
+					_data->clear_elements();
 				}
-				_data->_array.push_back( value_type( value ) );
+				array().push_back( value_type( key, value ) );
 			}
 
 			void clear()
 			{
-				const_cast< Types& >( type ) = Undefined;
-				_data->_string.clear();
-				_data->_array.clear();
-				_data->_number = std::numeric_limits< long double >::quiet_NaN();
+				reset( Undefined );
 			}
 
-			void merge( const basic_var &rhs )
+			/*
+			 * the assign functions and reset replace the value in place: when no
+			 * other var shares the data, its block and the capacity of its string
+			 * and element list are reused instead of allocated again
+			 */
+			void reset( Types t )
 			{
-				switch ( type )
+				basic_data &data = *_data.operator->();
+
+				const_cast< Types& >( type ) = t;
+				data._string.clear();
+				if ( t == Array )
 				{
-					case Null:
-					case Undefined:
-					case Number:
-					case Bool:
-					case String:
-						operator = ( rhs );
-						break;
-					case Object:
-						for ( const_iterator i = rhs._data->_array.begin(); i != rhs._data->_array.end(); ++i )
-						{
-							operator []( i->key ).merge( i->value );
-						}
-						break;
-					case Array:
-						int c = 0;
-						for ( const_iterator i = rhs._data->_array.begin(); i != rhs._data->_array.end(); ++i )
-						{
-							operator []( c++ ).merge( i->value );
-						}
-						break;
+					data.empty_elements();
+				}
+				else
+				{
+					data.clear_elements();
 				}
+				data._number = std::numeric_limits< long double >::quiet_NaN();
+				data._format = basic_data::Floating;
+				data._raw = false;
+				data._binary = false;
 			}
 
-			string_type serialize( unsigned int markup = Compact, unsigned int level = 0 ) const
+			/* a String made of the characters in [ start, end ) */
+			template < class I >
+			void assign( I start, const I &end )
 			{
-				const string_type tabs( level, '\t' );
+				reset( String );
+				_data->_string.assign( start, end );
+			}
 
-				switch ( type )
+			void assign( bool value )
+			{
+				reset( Bool );
+				_data->integer( static_cast< unsigned long long >( value ) );
+			}
+
+			void assign( long long value )
+			{
+				reset( Number );
+				_data->integer( value );
+			}
+
+			void assign( unsigned long long value )
+			{
+				reset( Number );
+				_data->integer( value );
+			}
+
+			void assign( number_type value )
+			{
+				reset( Number );
+				_data->_number = value;
+			}
+
+			void merge( const basic_var &rhs )
+			{
+				/* a copy shares the data, so merging a value into itself still reads the original */
+				const basic_var source( rhs );
+
+				std::vector< std::pair< basic_var*, const basic_var* > > pending( 1, std::make_pair( this, &source ) );
+
+				while ( !pending.empty() )
 				{
-					case Null:
-					case Undefined:
-						if ( markup & HumanReadable && markup & IndentFirstItem ) return tabs + convert_string< Char >( "null" );
-						return convert_string< Char >( "null" );
-					case Number:
-					case Bool:
-						if ( markup & HumanReadable && markup & IndentFirstItem ) return tabs + toString();
-						return toString();
-					case String:
+					basic_var &target = *pending.back().first;
+					const basic_var &from = *pending.back().second;
+					pending.pop_back();
+
+					switch ( target.type )
 					{
-						const string_type tak = static_cast< Char >( '\"' ) + utf8Decode( _data->_string ) + static_cast< Char >( '\"' );
-						if ( markup & HumanReadable && markup & IndentFirstItem ) return tabs + tak;
-						return tak;
+						case Null:
+						case Undefined:
+						case Number:
+						case Bool:
+						case String:
+							target = from;
+							break;
+						case TypeCount:
+							break;
+						case Object:
+							/* add every member before taking addresses, adding may move them */
+							for ( const_iterator i = from.begin(); i != from.end(); ++i ) target[ i->key ];
+							for ( const_iterator i = from.begin(); i != from.end(); ++i )
+							{
+								pending.push_back( std::make_pair( &target[ i->key ], &i->value ) );
+							}
+							break;
+						case Array:
+							if ( from.empty() ) break;
+							target[ static_cast< unsigned int >( from.size() - 1 ) ];
+							unsigned int c = 0;
+							for ( const_iterator i = from.begin(); i != from.end(); ++i )
+							{
+								pending.push_back( std::make_pair( &target[ c++ ], &i->value ) );
+							}
+							break;
 					}
-					case Object:
-					case Array:
-					case TypeCount:
-						break;
 				}
+			}
 
-				std::basic_stringstream< Char > result;
+			/*
+			 * a copy that shares no data with this value at any depth, copies
+			 * normally share until written to
+			 */
+			basic_var clone() const
+			{
+				basic_var result( *this );
 
-				if ( markup & HumanReadable && markup & IndentFirstItem ) result << tabs;
+				std::vector< basic_var* > pending( 1, &result );
 
-				if ( type == Array )
+				while ( !pending.empty() )
 				{
-					result << '[';
+					basic_var &node = *pending.back();
+					pending.pop_back();
 
-					for ( const_iterator i = _data->_array.begin(); i != _data->_array.end(); ++i )
-					{
-						if ( i != _data->_array.begin() ) result << ',';
+					node = basic_var( node.type, *node._data.operator->() );
 
-						if ( markup & HumanReadable )
-						{
-							result << '\n' << '\t' << tabs;
+					basic_data &data = *node._data.operator->();
 
-							if ( markup & CountArrayValues )
-							{
-								result << i - _data->_array.begin() << " => ";
-							}
-						}
+					if ( data._numbers ) data._numbers.reset( new packed_numbers( *data._numbers ) );
 
-						result << i->value.serialize( markup & ~IndentFirstItem, level + 1 );
-					}
+					if ( data._columns )
+					{
+						typename basic_data::columns_type *columns = new typename basic_data::columns_type( *data._columns );
+						data._columns.reset( columns );
 
-					if ( markup & HumanReadable ) result << '\n' << tabs;
+						pending.push_back( &columns->prototype );
+						for ( typename std::vector< basic_var >::iterator i = columns->columns.begin(); i != columns->columns.end(); ++i ) pending.push_back( &*i );
+					}
 
-					result << ']';
+					for ( iterator i = data._array.begin(); i != data._array.end(); ++i ) pending.push_back( &i->value );
 				}
-				else
-				{
-					result << '{';
 
-					for ( const_iterator i = _data->_array.begin(); i != _data->_array.end(); ++i )
-					{
-						if ( i != _data->_array.begin() ) result << ',';
+				return result;
+			}
+
+			string_type serialize( unsigned int markup = Compact, unsigned int level = 0 ) const
+			{
+				string_type result;
+				string_sink< string_type > sink( result );
+				write( sink, markup, level );
+				return result;
+			}
+
+			/*
+			 * serialize into a sink, see sink.h. Containers are written from an
+			 * explicit stack, so nesting depth is only bounded by memory. With
+			 * Cached every container keeps its text, see serialized_form, until a
+			 * write access to it or anything inside it drops it: writing a mostly
+			 * unchanged document again only formats the containers on the paths to
+			 * what changed and copies the rest. Like hash(), a container that handed
+			 * out its elements keeps its form while none of them changed.
+			 */
+			template < class Sink >
+			void write( Sink &sink, unsigned int markup = Compact, unsigned int level = 0 ) const
+			{
+				const bool human = ( markup & HumanReadable ) != 0;
 
-						if ( markup & HumanReadable ) result << '\n' << '\t' << tabs;
+				if ( human && markup & IndentFirstItem ) indent( sink, level );
 
-						result << '\"' << utf8Decode( i->key ) << '\"' << ':';
+				if ( markup & Cached )
+				{
+					/* Compact is the absence of the other flags, forms are kept without it */
+					markup &= ~( Cached | IndentFirstItem | Compact );
 
-						result << i->value.serialize( markup & ~IndentFirstItem, level + 1 );
+					if ( cacheable() )
+					{
+						write_form( sink, *serialized( markup, human ? level : 0 ) );
+						return;
 					}
+				}
 
-					if ( markup & HumanReadable ) result << '\n' << tabs;
+				std::vector< write_frame > frames;
+				write_values( sink, this, frames, markup, level );
+			}
 
-					result << '}';
-				}
+			/*
+			 * writes elements [ first, last ) of this container the way write()
+			 * does inside it at level, with the separators between them but
+			 * without the brackets, so a container can be written in pieces that
+			 * concatenate to the same text, see parallel.h.
+			 */
+			template < class Sink >
+			void write_elements( Sink &sink, size_t first, size_t last, unsigned int markup = Compact, unsigned int level = 0 ) const
+			{
+				if ( type != Array && type != Object ) return;
+
+				std::vector< write_frame > frames( 1, write_frame( *this ) );
+				frames.back().index = std::min( first, frames.back().count );
+				frames.back().count = std::max( frames.back().index, std::min( last, frames.back().count ) );
+				frames.back().close = false;
 
-				return result.str();
+				write_values( sink, 0, frames, markup & ~( Cached | IndentFirstItem ), level );
 			}
 
 			basic_var& front()
 			{
-				if ( _data->_array.empty() ) return *this;
-				return _data->_array.front().value;
+				if ( static_cast< const data_pointer& >( _data )->size() == 0 ) return *this;
+				return lend().front().value;
 			}
 
 			basic_var front() const
 			{
-				if ( _data->_array.empty() ) return basic_var();
-				return _data->_array.front().value;
+				if ( ( type != Array && type != Object ) || _data->size() == 0 ) return basic_var();
+				return element( 0 );
 			}
 
 			basic_var& back()
 			{
-				if ( _data->_array.empty() ) return *this;
-				return _data->_array.back().value;
+				if ( static_cast< const data_pointer& >( _data )->size() == 0 ) return *this;
+				return lend().back().value;
 			}
 
 			basic_var back() const
 			{
-				if ( _data->_array.empty() ) return basic_var();
-				return _data->_array.back().value;
+				if ( ( type != Array && type != Object ) || _data->size() == 0 ) return basic_var();
+				return element( _data->size() - 1 );
 			}
 
 			size_t size() const
@@ -521,10 +893,11 @@ namespace json
 					default:
 						return 0;
 					case String:
+						if ( _data->_binary ) return basic_base64< Char >::encoded_size( _data->_string.size() );
 						return _data->_string.size();
 					case Array:
 					case Object:
-						return _data->_array.size();
+						return _data->size();
 				}
 			}
 
@@ -538,25 +911,917 @@ namespace json
 						return _data->_string.empty();
 					case Array:
 					case Object:
-						return _data->_array.empty();
+						return _data->size() == 0;
 				}
 			}
 
-			iterator begin() { return _data->_array.begin(); }
+			iterator begin() { return lend().begin(); }
 
-			const_iterator begin() const { return _data->_array.begin(); }
+			const_iterator begin() const { return elements().begin(); }
 
-			iterator end() { return _data->_array.end(); }
+			iterator end() { return lend().end(); }
 
-			const_iterator end() const { return _data->_array.end(); }
+			const_iterator end() const { return elements().end(); }
 
-		private:
+			/*
+			 * stores an array of objects that all have the same members in the same
+			 * order column wise: the member names once and one Array per member, so
+			 * scanning a member reads consecutive values and serialize, hash() and
+			 * equals() read the records straight from the columns. Iterating or
+			 * indexing builds the records once, see basic_data::elements(), and any
+			 * write drops the columns again.
+			 */
+			bool to_columns()
+			{
+				const basic_var &inspect = *this;
 
-			data_pointer _data;
-	};
+				if ( type != Array || inspect._data->packed() ) return false;
 
-	template < template< class > class A, class B, class C >
-	bool operator == ( const basic_var< A, B > &lhs, const C &rhs )
+				const array_type &records = inspect.elements();
+
+				if ( records.size() < 2 ) return false;
+
+				const basic_var &first = records.front().value;
+
+				for ( const_iterator i = records.begin(); i != records.end(); ++i )
+				{
+					if ( i->value.type != Object || i->value.size() != first.size() ) return false;
+
+					for ( const_iterator a = i->value.begin(), b = first.begin(); b != first.end(); ++a, ++b )
+					{
+						if ( a->key != b->key ) return false;
+					}
+				}
+
+				std::tr1::shared_ptr< typename basic_data::columns_type > columns( new typename basic_data::columns_type() );
+				columns->size = records.size();
+				columns->prototype = first;
+				columns->columns.resize( first.size(), basic_var( Array ) );
+
+				for ( const_iterator i = records.begin(); i != records.end(); ++i )
+				{
+					typename std::vector< basic_var >::iterator column = columns->columns.begin();
+					for ( const_iterator j = i->value.begin(); j != i->value.end(); ++j, ++column )
+					{
+						column->push( j->value );
+					}
+				}
+
+				basic_data &data = *_data.operator->();
+				array_type().swap( data._array );
+				data._columns = columns;
+
+				return true;
+			}
+
+			bool columnar() const
+			{
+				return _data->_columns.get() != 0;
+			}
+
+			/* member key of every element of an array of objects, straight from the columns when columnar */
+			basic_var column( const string_type &key ) const
+			{
+				if ( type == Array && _data->_columns )
+				{
+					const basic_var &prototype = _data->_columns->prototype;
+					typename std::vector< basic_var >::const_iterator column = _data->_columns->columns.begin();
+					for ( const_iterator i = prototype.begin(); i != prototype.end(); ++i, ++column )
+					{
+						if ( i->key == key ) return *column;
+					}
+				}
+
+				basic_var result( Array );
+				if ( type != Array ) return result;
+
+				for ( const_iterator i = begin(); i != end(); ++i ) result.push( i->value[ key ] );
+
+				return result;
+			}
+
+			/* contiguous elements of an array packed as doubles, 0 for any other layout */
+			const double* doubles() const
+			{
+				const basic_data &data = *_data.operator->();
+				if ( type != Array || !data._numbers || data._numbers->doubles.empty() ) return 0;
+				return &data._numbers->doubles[ 0 ];
+			}
+
+			/* contiguous elements of an array packed as int64, 0 for any other layout */
+			const long long* integers() const
+			{
+				const basic_data &data = *_data.operator->();
+				if ( type != Array || !data._numbers || data._numbers->integers.empty() ) return 0;
+				return &data._numbers->integers[ 0 ];
+			}
+
+			number_type sum() const
+			{
+				if ( const double *values = doubles() )
+				{
+					/* independent partial sums leave the compiler free to vectorize */
+					double partial[ 4 ] = { 0, 0, 0, 0 };
+					const size_t count = size(), blocks = count - count % 4;
+					for ( size_t i = 0; i < blocks; i += 4 )
+					{
+						partial[ 0 ] += values[ i ];
+						partial[ 1 ] += values[ i + 1 ];
+						partial[ 2 ] += values[ i + 2 ];
+						partial[ 3 ] += values[ i + 3 ];
+					}
+					for ( size_t i = blocks; i < count; ++i ) partial[ 0 ] += values[ i ];
+					return ( partial[ 0 ] + partial[ 1 ] ) + ( partial[ 2 ] + partial[ 3 ] );
+				}
+
+				number_type result = 0;
+
+				if ( const long long *values = integers() )
+				{
+					for ( size_t i = 0, count = size(); i < count; ++i ) result += values[ i ];
+					return result;
+				}
+
+				for ( const_iterator i = begin(); i != end(); ++i ) result += i->value.toNumber();
+				return result;
+			}
+
+			/* smallest element, NaN for an empty array */
+			number_type minimum() const
+			{
+				return extreme( smaller() );
+			}
+
+			/* largest element, NaN for an empty array */
+			number_type maximum() const
+			{
+				return extreme( larger() );
+			}
+
+		private:
+
+			friend class basic_parallel_writer< CopyBehaviour, Char >;
+
+			/* these build values through array(), nobody else holds on to the elements they write */
+			friend class basic_parser< CopyBehaviour, Char >;
+
+			template < class > friend class basic_view;
+
+			template < class > friend class basic_tape_view;
+
+			basic_var( Types type, const basic_data &data ) :
+				type( type ),
+				_data( data ) { }
+
+			string_type number_string() const
+			{
+				const basic_data &data = *_data.operator->();
+
+				if ( data._raw ) return data._string;
+
+				switch ( data._format )
+				{
+					case basic_data::Signed:
+					{
+						const long long value = static_cast< long long >( data._integer );
+						return integer_to_string< Char >( value < 0 ? 0 - data._integer : data._integer, value < 0 );
+					}
+					case basic_data::Unsigned:
+						return integer_to_string< Char >( data._integer, false );
+					default:
+						return number_to_string< Char >( data._number );
+				}
+			}
+
+			bool same_number( const basic_var &rhs ) const
+			{
+				const basic_data &a = *_data.operator->(), &b = *rhs._data.operator->();
+
+				if ( a._raw && b._raw && a._string == b._string ) return true;
+
+				const typename basic_data::number_value x = a.number(), y = b.number();
+
+				const bool integers = ( x.format == basic_data::Signed || x.format == basic_data::Unsigned ) && ( y.format == basic_data::Signed || y.format == basic_data::Unsigned );
+				if ( integers ) return x.format == y.format && x.integer == y.integer;
+
+				if ( isNaN( x.number ) || isNaN( y.number ) ) return isNaN( x.number ) && isNaN( y.number ) && a._string == b._string;
+
+				return x.number == y.number;
+			}
+
+			struct smaller
+			{
+				template < class T >
+				bool operator()( const T &lhs, const T &rhs ) const { return lhs < rhs; }
+			};
+
+			struct larger
+			{
+				template < class T >
+				bool operator()( const T &lhs, const T &rhs ) const { return lhs > rhs; }
+			};
+
+			template < class Compare >
+			number_type extreme( Compare compare ) const
+			{
+				if ( empty() || type != Array ) return std::numeric_limits< number_type >::quiet_NaN();
+
+				if ( const double *values = doubles() )
+				{
+					double result = values[ 0 ];
+					for ( size_t i = 1, count = size(); i < count; ++i ) result = compare( values[ i ], result ) ? values[ i ] : result;
+					return result;
+				}
+
+				if ( const long long *values = integers() )
+				{
+					long long result = values[ 0 ];
+					for ( size_t i = 1, count = size(); i < count; ++i ) result = compare( values[ i ], result ) ? values[ i ] : result;
+					return result;
+				}
+
+				number_type result = begin()->value.toNumber();
+				for ( const_iterator i = begin(); i != end(); ++i )
+				{
+					const number_type value = i->value.toNumber();
+					if ( compare( value, result ) ) result = value;
+				}
+				return result;
+			}
+
+			const array_type& elements() const
+			{
+				return _data->elements();
+			}
+
+			/* element index of an Array or Object, packed numbers are read in place */
+			basic_var element( size_t index ) const
+			{
+				const basic_data &data = *_data.operator->();
+
+				if ( data.packed() && data._numbers )
+				{
+					const packed_numbers &numbers = *data._numbers;
+					return numbers.doubles.empty() ? basic_var( numbers.integers[ index ] ) : basic_var( numbers.doubles[ index ] );
+				}
+
+				return elements()[ index ].value;
+			}
+
+			/* element index for equals(), elements of a packed layout are read into held */
+			const basic_var* element( size_t index, std::deque< basic_var > &held ) const
+			{
+				const basic_data &data = *_data.operator->();
+
+				if ( !data.packed() ) return &elements()[ index ].value;
+
+				held.push_back( data._columns ? data.record( index ) : element( index ) );
+				return &held.back();
+			}
+
+			/* hash of element index of a packed layout, the same as the hash of that element */
+			size_t element_hash( size_t index ) const
+			{
+				const basic_data &data = *_data.operator->();
+
+				if ( data._columns ) return data.record( index ).hash();
+
+				return hash_combine( static_cast< size_t >( Number ), hash_number( ( *data._numbers )[ index ] ) );
+			}
+
+			/* packed numbers compare like the Number elements they stand for */
+			static bool same_numbers( const packed_numbers &a, const packed_numbers &b )
+			{
+				if ( a.doubles.empty() && b.doubles.empty() ) return a.integers == b.integers;
+
+				for ( size_t i = 0, count = a.size(); i < count; ++i )
+				{
+					if ( a[ i ] != b[ i ] ) return false;
+				}
+
+				return true;
+			}
+
+			/* write access to the elements, packed layouts are turned into plain elements first */
+			array_type& array()
+			{
+				basic_data &data = *_data.operator->();
+				data.unpack();
+				return data._array;
+			}
+
+			/*
+			 * array() for elements that are handed out to the caller, who may
+			 * write to one long after: that write doesn't reach this container,
+			 * so from then on its caches are checked against the elements before
+			 * they are used, see lent_check()
+			 */
+			array_type& lend()
+			{
+				basic_data &data = *_data.operator->();
+				data.unpack();
+				data._lent = true;
+				return data._array;
+			}
+
+			bool pack( const basic_var &value )
+			{
+				const basic_data &number = *value._data.operator->();
+
+				if ( number._raw ) return false;
+
+				switch ( number._format )
+				{
+					case basic_data::Signed:
+						return pack( static_cast< long long >( number._integer ) );
+					case basic_data::Floating:
+						return pack( number._number );
+					default:
+						return false;
+				}
+			}
+
+			/* appends number to the packed numbers of an array that holds nothing else */
+			template < class Number >
+			bool pack( Number number )
+			{
+				const basic_var &inspect = *this;
+
+				if ( type == Array && ( inspect._data->_columns || inspect._data->_fragment || !inspect._data->_array.empty() ) ) return false;
+
+				if ( type != Array )
+				{
+					const_cast< Types& >( type ) = Array;
+					_data->clear_elements();
+				}
+
+				basic_data &data = *_data.operator->();
+
+				if ( !data._numbers )
+				{
+					data._numbers.reset( new packed_numbers() );
+				}
+				else if ( !data._numbers.unique() )
+				{
+					data._numbers.reset( new packed_numbers( *data._numbers ) );
+				}
+
+				return data._numbers->add( number );
+			}
+
+			typedef serialized_form< Char > form_type;
+
+			/* a container whose form is being built and the next element to add */
+			struct form_frame
+			{
+				form_frame( const basic_var &container, unsigned int markup, unsigned int level ) :
+					node( &container ),
+					form( new form_type( markup, level ) ),
+					index( 0 ) { }
+
+				form_frame( const form_frame &rhs ) :
+					node( rhs.node ),
+					form( rhs.form ),
+					index( rhs.index ) { }
+
+				form_frame& operator = ( const form_frame &rhs )
+				{
+					node = rhs.node;
+					form = rhs.form;
+					index = rhs.index;
+					return *this;
+				}
+
+				const basic_var *node;
+				std::tr1::shared_ptr< form_type > form;
+				size_t index;
+			};
+
+			/* containers whose elements are plain vars, packed ones and fragments are written as they are */
+			bool cacheable() const
+			{
+				return ( type == Array || type == Object ) && !_data->_fragment && !_data->packed();
+			}
+
+			/* the form cached for markup and level, like cached_hash() */
+			std::tr1::shared_ptr< const form_type > cached_form( unsigned int markup, unsigned int level ) const
+			{
+				size_t lent = 0;
+				std::tr1::shared_ptr< const form_type > form = _data->cached_form( lent );
+
+				if ( form && ( form->markup != markup || form->level != level || ( _data->_lent && lent != lent_check() ) ) ) form.reset();
+
+				return form;
+			}
+
+			/* the form of this container, built for the containers inside it that have none */
+			std::tr1::shared_ptr< const form_type > serialized( unsigned int markup, unsigned int level ) const
+			{
+				if ( const std::tr1::shared_ptr< const form_type > form = cached_form( markup, level ) ) return form;
+
+				const bool human = ( markup & HumanReadable ) != 0, count = human && ( markup & CountArrayValues );
+
+				std::vector< form_frame > frames( 1, form_frame( *this, markup, level ) );
+				frames.back().form->pieces.back().text.push_back( type == Array ? '[' : '{' );
+
+				for ( ;; )
+				{
+					form_frame &frame = frames.back();
+					const array_type &elements = frame.node->elements();
+					const unsigned int depth = frame.form->level;
+
+					string_type &text = frame.form->pieces.back().text;
+					string_sink< string_type > sink( text );
+
+					if ( frame.index == elements.size() )
+					{
+						if ( human ) newline( sink, depth );
+						sink.push_back( frame.node->type == Array ? ']' : '}' );
+
+						const std::tr1::shared_ptr< const form_type > done( frame.form );
+						frame.node->_data->cache_form( done, frame.node->_data->_lent ? frame.node->lent_check() : 0 );
+						frames.pop_back();
+
+						if ( frames.empty() ) return done;
+
+						frames.back().form->pieces.back().nested = done;
+						frames.back().form->pieces.push_back( typename form_type::piece() );
+						continue;
+					}
+
+					const size_t index = frame.index++;
+
+					if ( index ) sink.push_back( ',' );
+					if ( human ) newline( sink, depth + 1 );
+
+					if ( frame.node->type != Array ) write_key( sink, elements[ index ].key );
+					else if ( count ) append( append( sink, integer_to_string< Char >( index, false ) ), convert_string< Char >( " => " ) );
+
+					const basic_var &value = elements[ index ].value;
+					const unsigned int nested = human ? depth + 1 : 0;
+
+					if ( !value.cacheable() )
+					{
+						value.write( sink, markup, nested );
+					}
+					else if ( const std::tr1::shared_ptr< const form_type > form = value.cached_form( markup, nested ) )
+					{
+						frame.form->pieces.back().nested = form;
+						frame.form->pieces.push_back( typename form_type::piece() );
+					}
+					else
+					{
+						frames.push_back( form_frame( value, markup, nested ) );
+						frames.back().form->pieces.back().text.push_back( value.type == Array ? '[' : '{' );
+					}
+				}
+			}
+
+			template < class Sink >
+			static void write_form( Sink &sink, const form_type &form )
+			{
+				std::vector< std::pair< const form_type*, size_t > > pending( 1, std::make_pair( &form, static_cast< size_t >( 0 ) ) );
+
+				while ( !pending.empty() )
+				{
+					if ( pending.back().second == pending.back().first->pieces.size() )
+					{
+						pending.pop_back();
+						continue;
+					}
+
+					const typename form_type::piece &piece = pending.back().first->pieces[ pending.back().second++ ];
+					append( sink, piece.text );
+					if ( piece.nested ) pending.push_back( std::make_pair( piece.nested.get(), static_cast< size_t >( 0 ) ) );
+				}
+			}
+
+			/* the container being written and the next element to write, or a row of a column wise array */
+			struct write_frame
+			{
+				explicit write_frame( const basic_var &container ) :
+					node( &container ),
+					columns( 0 ),
+					row( 0 ),
+					index( 0 ),
+					count( container._data->size() ),
+					close( true ) { }
+
+				write_frame( const typename basic_data::columns_type &c, size_t r ) :
+					node( &c.prototype ),
+					columns( &c ),
+					row( r ),
+					index( 0 ),
+					count( c.prototype._data->size() ),
+					close( true ) { }
+
+				const basic_var *node;
+				const typename basic_data::columns_type *columns;
+				size_t row, index, count;
+				bool close;
+			};
+
+			/* writes value, then what is left of the containers on frames */
+			template < class Sink >
+			static void write_values( Sink &sink, const basic_var *value, std::vector< write_frame > &frames, unsigned int markup, unsigned int level )
+			{
+				const bool human = ( markup & HumanReadable ) != 0, count = human && ( markup & CountArrayValues );
+
+				for ( ;; )
+				{
+					while ( !value && !frames.empty() )
+					{
+						write_frame &frame = frames.back();
+						const unsigned int depth = level + static_cast< unsigned int >( frames.size() );
+
+						if ( frame.index == frame.count )
+						{
+							if ( frame.close )
+							{
+								if ( human ) newline( sink, depth - 1 );
+								sink.push_back( frame.node->type == Array && !frame.columns ? ']' : '}' );
+							}
+							frames.pop_back();
+							continue;
+						}
+
+						const size_t index = frame.index++;
+
+						if ( index ) sink.push_back( ',' );
+						if ( human ) newline( sink, depth );
+
+						const basic_data &data = *frame.node->_data.operator->();
+
+						if ( frame.columns )
+						{
+							write_key( sink, data._array[ index ].key );
+
+							/* cells are read where they are, threads may write the same columns, see parallel.h */
+							const basic_var &column = frame.columns->columns[ index ];
+							if ( !write_packed( sink, *column._data.operator->(), frame.row ) ) value = &column.elements()[ frame.row ].value;
+						}
+						else if ( frame.node->type != Array )
+						{
+							write_key( sink, data._array[ index ].key );
+							value = &data._array[ index ].value;
+						}
+						else
+						{
+							if ( count ) append( append( sink, integer_to_string< Char >( index, false ) ), convert_string< Char >( " => " ) );
+
+							if ( !data.packed() )
+							{
+								value = &data._array[ index ].value;
+							}
+							else if ( data._columns )
+							{
+								/* a record of a column wise array, written as the object it stands for */
+								sink.push_back( '{' );
+								frames.push_back( write_frame( *data._columns, index ) );
+							}
+							else
+							{
+								write_packed( sink, data, index );
+							}
+						}
+					}
+
+					if ( !value ) return;
+
+					if ( value->_data->_fragment )
+					{
+						append( sink, value->_data->_string );
+					}
+					else if ( value->type == Array || value->type == Object || value->type == TypeCount )
+					{
+						sink.push_back( value->type == Array ? '[' : '{' );
+						frames.push_back( write_frame( *value ) );
+					}
+					else
+					{
+						value->write_scalar( sink );
+					}
+
+					value = 0;
+				}
+			}
+
+			/* writes element index of packed numbers, false for any other layout */
+			template < class Sink >
+			static bool write_packed( Sink &sink, const basic_data &data, size_t index )
+			{
+				if ( !data.packed() || !data._numbers ) return false;
+
+				if ( !data._numbers->integers.empty() )
+				{
+					const long long number = data._numbers->integers[ index ];
+					append( sink, integer_to_string< Char >( number < 0 ? 0 - static_cast< unsigned long long >( number ) : number, number < 0 ) );
+				}
+				else
+				{
+					append( sink, number_to_string< Char >( data._numbers->doubles[ index ] ) );
+				}
+
+				return true;
+			}
+
+			template < class Sink >
+			void write_scalar( Sink &sink ) const
+			{
+				switch ( type )
+				{
+					case Number:
+					case Bool:
+						append( sink, toString() );
+						break;
+					case String:
+						sink.push_back( '\"' );
+						if ( _data->_binary )
+						{
+							write_bytes( sink );
+						}
+						else
+						{
+							utf8Escape( _data->_string.begin(), _data->_string.end(), sink );
+						}
+						sink.push_back( '\"' );
+						break;
+					default:
+						append( sink, convert_string< Char >( "null" ) );
+						break;
+				}
+			}
+
+			/* the base64 of the bytes of a binary String */
+			template < class Sink >
+			void write_bytes( Sink &sink ) const
+			{
+				basic_base64< Char >::encode( _data->_string.data(), _data->_string.size(), sink );
+			}
+
+			string_type encoded() const
+			{
+				string_type result;
+				result.reserve( basic_base64< Char >::encoded_size( _data->_string.size() ) );
+
+				string_sink< string_type > sink( result );
+				write_bytes( sink );
+
+				return result;
+			}
+
+			template < class Sink >
+			static void write_key( Sink &sink, const key_type &key )
+			{
+				sink.push_back( '\"' );
+				utf8Escape( key.begin(), key.end(), sink );
+				sink.push_back( '\"' );
+				sink.push_back( ':' );
+			}
+
+			template < class Sink >
+			static Sink& append( Sink &sink, const string_type &text )
+			{
+				sink.append( text.data(), text.size() );
+				return sink;
+			}
+
+			template < class Sink >
+			static void indent( Sink &sink, unsigned int level )
+			{
+				for ( unsigned int i = 0; i < level; ++i ) sink.push_back( '\t' );
+			}
+
+			template < class Sink >
+			static void newline( Sink &sink, unsigned int level )
+			{
+				sink.push_back( '\n' );
+				indent( sink, level );
+			}
+
+			/* a value whose hash is being computed and the next element to include */
+			struct hash_frame
+			{
+				/* packed layouts are hashed in place, see element_hash() */
+				explicit hash_frame( const basic_var &value ) :
+					node( &value ),
+					elements( value._data->packed() ? 0 : &value.elements() ),
+					count( elements ? elements->size() : value._data->size() ),
+					index( 0 ),
+					result( 0 ),
+					members( 0 )
+				{
+					const basic_data &data = *value._data.operator->();
+
+					result = hash_combine( static_cast< size_t >( value.type ), hash_number( data.number().number ) );
+
+					/* raw numbers and fragments keep their text in _string, which must not tell 1.0 from 1 */
+					if ( value.type != Number && value.type != Bool ) result = hash_combine( result, std::tr1::hash< string_type >()( value.type != String ? string_type() : data._binary ? value.encoded() : data._string ) );
+				}
+
+				void add( const key_type &key, size_t hash )
+				{
+					if ( node->type == Object )
+					{
+						members += hash_combine( key.hash(), hash );
+					}
+					else
+					{
+						result = hash_combine( result, hash );
+					}
+
+					++index;
+				}
+
+				/* returns the hash of node and caches it, see cached_hash() */
+				size_t finish()
+				{
+					if ( node->type == Object ) result = hash_combine( result, members );
+
+					if ( node->type == String || node->type == Array || node->type == Object )
+					{
+						node->_data->cache_hash( result, node->_data->_lent ? node->lent_check() : 0 );
+					}
+
+					return result;
+				}
+
+				const basic_var *node;
+				const array_type *elements;
+				size_t count, index, result, members;
+			};
+
+			/*
+			 * the hash cached for this value: numbers are quicker to hash again, and
+			 * a container that lent its elements only has one when check is set and
+			 * they are the same as when it was stored
+			 */
+			bool cached_hash( size_t &result, bool check ) const
+			{
+				if ( type != String && type != Array && type != Object ) return false;
+
+				size_t stored = 0, lent = 0;
+				if ( !_data->cached_hash( stored, lent ) ) return false;
+				if ( _data->_lent && ( !check || lent != lent_check() ) ) return false;
+
+				result = stored;
+				return true;
+			}
+
+			/*
+			 * sums up the elements a write through a lent element could change: those
+			 * of this container and, for each of them that lent its elements too,
+			 * theirs. Such a write changes the version of one of them, see
+			 * basic_data::version(), so caches stored with this value are only kept
+			 * while it stays the same.
+			 */
+			size_t lent_check() const
+			{
+				size_t result = 0;
+				std::vector< const basic_var* > pending( 1, this );
+
+				while ( !pending.empty() )
+				{
+					const array_type &elements = pending.back()->_data->_array;
+					pending.pop_back();
+
+					for ( typename array_type::const_iterator i = elements.begin(); i != elements.end(); ++i )
+					{
+						result = hash_combine( hash_combine( result, static_cast< size_t >( i->value.type ) ), static_cast< size_t >( i->value._data->version() ) );
+						if ( i->value._data->_lent ) pending.push_back( &i->value );
+					}
+				}
+
+				return result;
+			}
+
+			static size_t hash_number( long double number )
+			{
+				if ( isNaN( number ) ) return 0x7ff8;
+
+				const double value = static_cast< double >( number );
+
+				return value == 0 ? 0 : std::tr1::hash< double >()( value );
+			}
+
+			template < class Key >
+			basic_var& member( const Key &key )
+			{
+				if ( type != Object )
+				{
+					const_cast< Types& >( type ) = Object;
+					_data->clear_elements();
+				}
+				array_type &members = lend();
+				iterator i = std::find( members.begin(), members.end(), key );
+				if ( i == members.end() )
+				{
+					members.push_back( value_type( key_type( key ), Undefined ) );
+
+					return members.back().value;
+				}
+				return i->value;
+			}
+
+			template < class Key >
+			const basic_var& member( const Key &key ) const
+			{
+				const array_type &members = elements();
+				const_iterator i = std::find( members.begin(), members.end(), key );
+				if ( i == members.end() )
+				{
+					static basic_var undefined( Undefined );
+					return undefined;
+				}
+				return i->value;
+			}
+
+			/* pairs every member with the member of rhs that has the same key, false when one is missing */
+			bool pair_members( const basic_var &rhs, std::vector< std::pair< const basic_var*, const basic_var* > > &pending ) const
+			{
+				if ( size() <= 8 )
+				{
+					for ( const_iterator i = begin(); i != end(); ++i )
+					{
+						const_iterator j = rhs.find_key( i->key );
+						if ( j == rhs.end() ) return false;
+						pending.push_back( std::make_pair( &i->value, &j->value ) );
+					}
+
+					return true;
+				}
+
+				std::tr1::unordered_map< key_type, const basic_var* > members;
+				for ( const_iterator j = rhs.begin(); j != rhs.end(); ++j ) members[ j->key ] = &j->value;
+
+				for ( const_iterator i = begin(); i != end(); ++i )
+				{
+					typename std::tr1::unordered_map< key_type, const basic_var* >::const_iterator j = members.find( i->key );
+					if ( j == members.end() ) return false;
+					pending.push_back( std::make_pair( &i->value, j->second ) );
+				}
+
+				return true;
+			}
+
+			/*
+			 * called when the last var sharing a container goes away: moves the
+			 * elements of every container only reachable from here onto a list
+			 * and destroys them from there, so destroying a deeply nested value
+			 * doesn't recurse once per level
+			 */
+			void release()
+			{
+				const basic_data &data = *static_cast< const data_pointer& >( _data ).operator->();
+
+				bool nested = data._columns.get() != 0;
+				for ( const_iterator i = data._array.begin(); i != data._array.end() && !nested; ++i )
+				{
+					nested = i->value.type == Array || i->value.type == Object;
+				}
+
+				if ( !nested ) return;
+
+				std::deque< array_type > pending;
+
+				detach( *this, pending );
+
+				while ( !pending.empty() )
+				{
+					array_type elements;
+					elements.swap( pending.back() );
+					pending.pop_back();
+
+					for ( iterator i = elements.begin(); i != elements.end(); ++i ) detach( i->value, pending );
+				}
+			}
+
+			static void detach( basic_var &value, std::deque< array_type > &pending )
+			{
+				if ( ( value.type != Array && value.type != Object ) || !value._data.unique() ) return;
+
+				basic_data &data = *value._data.operator->();
+
+				if ( !data._array.empty() )
+				{
+					pending.push_back( array_type() );
+					pending.back().swap( data._array );
+				}
+
+				if ( data._columns && data._columns.unique() )
+				{
+					typename basic_data::columns_type &columns = const_cast< typename basic_data::columns_type& >( *data._columns );
+
+					detach( columns.prototype, pending );
+					for ( typename std::vector< basic_var >::iterator i = columns.columns.begin(); i != columns.columns.end(); ++i ) detach( *i, pending );
+				}
+			}
+
+			data_pointer _data;
+	};
+
+	template < template< class > class A, class B, class C >
+	bool operator == ( const basic_var< A, B > &lhs, const C &rhs )
 	{
 		return lhs == basic_var< A, B >( rhs );
 	}
@@ -575,4 +1840,31 @@ namespace json
 
 	typedef basic_var< CopyOnWrite, char > var;
 	typedef basic_var< CopyOnWrite, wchar_t > wvar;
+	typedef basic_var< PooledCopyOnWrite, char > pooled_var;
+}
+
+namespace std
+{
+	namespace tr1
+	{
+		template < template< class > class A, class B >
+		struct hash< json::basic_var< A, B > >
+		{
+			size_t operator()( const json::basic_var< A, B > &value ) const
+			{
+				return value.hash();
+			}
+		};
+	}
+
+#if __cplusplus >= 201103L
+	template < template< class > class A, class B >
+	struct hash< json::basic_var< A, B > >
+	{
+		size_t operator()( const json::basic_var< A, B > &value ) const
+		{
+			return value.hash();
+		}
+	};
+#endif
 }
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <type_traits>
+#else
+#include <tr1/type_traits>
+#endif
+
+#include <jsonpp/var.h>
+#include <jsonpp/reader.h>
+#include <jsonpp/sink.h>
+#include <jsonpp/unicode.h>
+
+namespace json
+{
+	/*
+	 * writes a document straight into a sink without building a basic_var:
+	 *
+	 *	writer.begin_object().key( "ids" ).begin_array().value( 1 ).value( 2 ).end_array().end_object();
+	 *
+	 * Separators, escaping, number formatting and Compact / HumanReadable /
+	 * CountArrayValues markup match basic_var::serialize, and an existing
+	 * basic_var can be written anywhere a value can. Only the nesting is kept
+	 * in memory, calls that would produce invalid JSON throw json::exception.
+	 */
+	template < class Char, class Sink >
+	class basic_writer
+	{
+		public:
+
+			typedef std::basic_string< Char > string_type;
+
+			explicit basic_writer( Sink &sink, unsigned int markup = Compact ) :
+				_sink( sink ),
+				_markup( markup ),
+				_scopes(),
+				_complete( false ) { }
+
+			basic_writer& begin_object()
+			{
+				open( '{', true );
+				return *this;
+			}
+
+			basic_writer& end_object()
+			{
+				close( '}', true );
+				return *this;
+			}
+
+			basic_writer& begin_array()
+			{
+				open( '[', false );
+				return *this;
+			}
+
+			basic_writer& end_array()
+			{
+				close( ']', false );
+				return *this;
+			}
+
+			/* the characters of the key are in [ start, end ) */
+			template < class I >
+			basic_writer& key( I start, const I &end )
+			{
+				if ( _scopes.empty() || !_scopes.back().object || _scopes.back().keyed ) throw exception( "key outside of an object or directly after another key" );
+
+				scope &current = _scopes.back();
+				if ( current.count++ ) _sink.push_back( ',' );
+				if ( _markup & HumanReadable ) newline( _scopes.size() );
+
+				quoted( start, end );
+				_sink.push_back( ':' );
+
+				current.keyed = true;
+				return *this;
+			}
+
+			basic_writer& key( const string_type &name )
+			{
+				return key( name.begin(), name.end() );
+			}
+
+			basic_writer& key( const Char *name )
+			{
+				return key( name, name + std::char_traits< Char >::length( name ) );
+			}
+
+			/* a String value made of the characters in [ start, end ) */
+			template < class I >
+			basic_writer& value( I start, const I &end )
+			{
+				element();
+				quoted( start, end );
+				return *this;
+			}
+
+			basic_writer& value( const string_type &string )
+			{
+				return value( string.begin(), string.end() );
+			}
+
+			basic_writer& value( const Char *string )
+			{
+				return value( string, string + std::char_traits< Char >::length( string ) );
+			}
+
+			basic_writer& value( bool boolean )
+			{
+				element();
+				write( convert_string< Char >( boolean ? "true" : "false" ) );
+				return *this;
+			}
+
+			basic_writer& value( long double number )
+			{
+				element();
+				write( number_to_string< Char >( number ) );
+				return *this;
+			}
+
+			basic_writer& value( double number )
+			{
+				return value( static_cast< long double >( number ) );
+			}
+
+			template < class N >
+			typename enable_if< std::tr1::is_integral< N >::value, basic_writer& >::type value( N number )
+			{
+				element();
+				integer( static_cast< typename widest_integer< std::tr1::is_signed< N >::value >::type >( number ) );
+				return *this;
+			}
+
+			/* writes the subtree as serialize would at this depth */
+			template < template< class > class CopyBehaviour >
+			basic_writer& value( const basic_var< CopyBehaviour, Char > &subtree )
+			{
+				element();
+				subtree.write( _sink, _markup & ~IndentFirstItem, static_cast< unsigned int >( _scopes.size() ) );
+				return *this;
+			}
+
+			/* writes the source of a number, the characters in [ start, end ), as they are */
+			template < class I >
+			basic_writer& number( I start, const I &end )
+			{
+				element();
+				for ( ; start != end; ++start ) _sink.push_back( *start );
+				return *this;
+			}
+
+			basic_writer& number( const string_type &text )
+			{
+				element();
+				write( text );
+				return *this;
+			}
+
+			basic_writer& null()
+			{
+				element();
+				write( convert_string< Char >( "null" ) );
+				return *this;
+			}
+
+			/* true once one whole value has been written at the top level */
+			bool complete() const
+			{
+				return _complete;
+			}
+
+			size_t depth() const
+			{
+				return _scopes.size();
+			}
+
+		private:
+
+			struct scope
+			{
+				scope( bool o ) :
+					object( o ),
+					keyed( false ),
+					count( 0 ) { }
+
+				bool object;
+				bool keyed;
+				size_t count;
+			};
+
+			basic_writer( const basic_writer& );
+			basic_writer& operator = ( const basic_writer& );
+
+			/* separator and indentation in front of a value, or the check that it belongs to a key */
+			void element()
+			{
+				if ( _scopes.empty() )
+				{
+					if ( _complete ) throw exception( "writer already holds a complete document" );
+					_complete = true;
+					return;
+				}
+
+				scope &current = _scopes.back();
+
+				if ( current.object )
+				{
+					if ( !current.keyed ) throw exception( "object member written without a key" );
+					current.keyed = false;
+					return;
+				}
+
+				if ( current.count ) _sink.push_back( ',' );
+
+				if ( _markup & HumanReadable )
+				{
+					newline( _scopes.size() );
+
+					if ( _markup & CountArrayValues )
+					{
+						write( integer_to_string< Char >( current.count, false ) );
+						write( convert_string< Char >( " => " ) );
+					}
+				}
+
+				++current.count;
+			}
+
+			void open( Char bracket, bool object )
+			{
+				element();
+				_complete = false;
+				_sink.push_back( bracket );
+				_scopes.push_back( scope( object ) );
+			}
+
+			void close( Char bracket, bool object )
+			{
+				if ( _scopes.empty() || _scopes.back().object != object ) throw exception( "closing" ) << static_cast< char >( bracket ) << "does not match the open scope";
+				if ( _scopes.back().keyed ) throw exception( "object closed after a key without a value" );
+
+				_scopes.pop_back();
+
+				if ( _markup & HumanReadable ) newline( _scopes.size() );
+				_sink.push_back( bracket );
+
+				if ( _scopes.empty() ) _complete = true;
+			}
+
+			void integer( long long number )
+			{
+				write( integer_to_string< Char >( number < 0 ? 0 - static_cast< unsigned long long >( number ) : number, number < 0 ) );
+			}
+
+			void integer( unsigned long long number )
+			{
+				write( integer_to_string< Char >( number, false ) );
+			}
+
+			template < class I >
+			void quoted( I start, const I &end )
+			{
+				_sink.push_back( '\"' );
+				utf8Escape( start, end, _sink );
+				_sink.push_back( '\"' );
+			}
+
+			void newline( size_t level )
+			{
+				_sink.push_back( '\n' );
+				for ( size_t i = 0; i < level; ++i ) _sink.push_back( '\t' );
+			}
+
+			void write( const string_type &text )
+			{
+				_sink.append( text.data(), text.size() );
+			}
+
+			Sink &_sink;
+			const unsigned int _markup;
+			std::vector< scope > _scopes;
+			bool _complete;
+	};
+
+	/*
+	 * writes the value that starts at the current token of reader without
+	 * building it, numbers keep their source text. Leaves the reader on the
+	 * last token of the value and throws when the input ends inside it.
+	 */
+	template < class Char, class I, class Sink >
+	void transcode( basic_reader< Char, I > &reader, basic_writer< Char, Sink > &writer )
+	{
+		const size_t level = writer.depth();
+
+		for ( tokens::Token token = reader.token(); ; token = reader.next() )
+		{
+			switch ( token )
+			{
+				case tokens::End:
+				case tokens::TokenCount:
+					throw exception( "input ended inside a value" );
+				case tokens::BeginObject:
+					writer.begin_object();
+					break;
+				case tokens::EndObject:
+					writer.end_object();
+					break;
+				case tokens::BeginArray:
+					writer.begin_array();
+					break;
+				case tokens::EndArray:
+					writer.end_array();
+					break;
+				case tokens::Key:
+					writer.key( reader.value().begin(), reader.value().end() );
+					continue;
+				case tokens::String:
+					writer.value( reader.value().begin(), reader.value().end() );
+					break;
+				case tokens::Number:
+					writer.number( reader.value().begin(), reader.value().end() );
+					break;
+				case tokens::True:
+					writer.value( true );
+					break;
+				case tokens::False:
+					writer.value( false );
+					break;
+				case tokens::Null:
+					writer.null();
+					break;
+			}
+
+			if ( writer.depth() == level ) return;
+		}
+	}
+}
@@ -0,0 +1,200 @@
+#include <json++>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#ifndef _MSC_VER
+#include <pthread.h>
+#endif
+
+/*
+ * index [--lines] [--pointer /path] [--threads n] file
+ * index --update [--threads n] file
+ * index --get n [--get m ...] file
+ *
+ * scans file once and writes the byte offsets of the elements of its top
+ * level array, the array at --pointer or, with --lines, of every line of
+ * newline delimited JSON to file.index. --update indexes what was appended
+ * to a newline delimited file since, --get parses just the given elements
+ * and prints them, one per line.
+ */
+namespace
+{
+	/* lines that start in [ begin, end ), scanned on a thread of its own */
+	struct chunk
+	{
+		chunk() :
+			data( 0 ),
+			size( 0 ),
+			begin( 0 ),
+			end( 0 ),
+			entries(),
+			error() { }
+
+		chunk( const chunk &rhs ) :
+			data( rhs.data ),
+			size( rhs.size ),
+			begin( rhs.begin ),
+			end( rhs.end ),
+			entries( rhs.entries ),
+			error( rhs.error ) { }
+
+		chunk& operator = ( const chunk &rhs )
+		{
+			data = rhs.data;
+			size = rhs.size;
+			begin = rhs.begin;
+			end = rhs.end;
+			entries = rhs.entries;
+			error = rhs.error;
+			return *this;
+		}
+
+		const char *data;
+		size_t size, begin, end;
+		std::vector< json::index_entry > entries;
+		std::string error;
+	};
+
+	void* scan( void *argument )
+	{
+		chunk &work = *static_cast< chunk* >( argument );
+
+		try
+		{
+			json::structural::lines( work.data, work.size, work.begin, work.end, work.entries );
+		}
+		catch ( const json::exception &e )
+		{
+			work.error = e.what();
+		}
+
+		return 0;
+	}
+
+	/* the lines from index.pending() on, split over threads */
+	void update( json::offset_index &index, const json::mapped_file &file, unsigned int threads )
+	{
+		const size_t begin = index.pending(), size = file.size();
+		const size_t step = ( size - begin ) / threads + 1;
+
+		std::vector< chunk > chunks( threads );
+		for ( unsigned int i = 0; i < threads; ++i )
+		{
+			chunks[ i ].data = file.data();
+			chunks[ i ].size = size;
+			chunks[ i ].begin = std::min( size, begin + i * step );
+			chunks[ i ].end = std::min( size, begin + ( i + 1 ) * step );
+		}
+
+#ifndef _MSC_VER
+		std::vector< pthread_t > running;
+		for ( unsigned int i = 1; i < threads; ++i )
+		{
+			pthread_t thread;
+			if ( pthread_create( &thread, 0, scan, &chunks[ i ] ) != 0 ) throw json::exception( "can't start a thread" );
+			running.push_back( thread );
+		}
+		scan( &chunks[ 0 ] );
+		for ( std::vector< pthread_t >::const_iterator i = running.begin(); i != running.end(); ++i ) pthread_join( *i, 0 );
+#else
+		for ( unsigned int i = 0; i < threads; ++i ) scan( &chunks[ i ] );
+#endif
+
+		std::vector< json::index_entry > found;
+		for ( std::vector< chunk >::const_iterator i = chunks.begin(); i != chunks.end(); ++i )
+		{
+			if ( !i->error.empty() ) throw json::exception( i->error );
+			found.insert( found.end(), i->entries.begin(), i->entries.end() );
+		}
+
+		index.commit( file.data(), size, found );
+	}
+
+	void save( const json::offset_index &index, const std::string &path )
+	{
+		std::ofstream stream( path.c_str(), std::ios::binary | std::ios::trunc );
+		if ( !stream ) throw json::exception( "can't write" ) << path;
+
+		json::stream_sink< char > sink( stream );
+		index.save( sink );
+		sink.flush();
+
+		if ( !stream ) throw json::exception( "can't write" ) << path;
+	}
+}
+
+int main( int argc, char *argv[] )
+{
+	bool lines = false, refresh = false;
+	unsigned int threads = 1;
+	std::string pointer;
+	std::vector< size_t > wanted;
+	const char *path = 0;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( !std::strcmp( argv[ i ], "--lines" ) ) lines = true;
+		else if ( !std::strcmp( argv[ i ], "--update" ) ) refresh = true;
+		else if ( !std::strcmp( argv[ i ], "--pointer" ) && i + 1 < argc ) pointer = argv[ ++i ];
+		else if ( !std::strcmp( argv[ i ], "--threads" ) && i + 1 < argc ) threads = std::max( 1, std::atoi( argv[ ++i ] ) );
+		else if ( !std::strcmp( argv[ i ], "--get" ) && i + 1 < argc ) wanted.push_back( std::strtoul( argv[ ++i ], 0, 10 ) );
+		else if ( argv[ i ][ 0 ] != '-' && !path ) path = argv[ i ];
+		else
+		{
+			path = 0;
+			break;
+		}
+	}
+
+	if ( !path )
+	{
+		std::cerr << "usage: " << argv[ 0 ] << " [--lines] [--pointer /path] [--update] [--threads n] [--get n ...] file" << std::endl;
+		return 2;
+	}
+
+	const std::string sidecar = std::string( path ) + ".index";
+
+	try
+	{
+		const json::mapped_file file( path );
+
+		if ( !wanted.empty() )
+		{
+			const json::mapped_file stored( sidecar.c_str() );
+			const json::offset_index index = json::offset_index::load( stored.data(), stored.size() );
+			if ( !index.matches( file.data(), file.size() ) ) throw json::exception( "index does not belong to" ) << path;
+
+			for ( std::vector< size_t >::const_iterator i = wanted.begin(); i != wanted.end(); ++i )
+			{
+				if ( *i >= index.size() ) throw json::exception( "no element" ) << *i;
+				std::cout << index.element( file.data(), *i ).serialize() << '\n';
+			}
+			return 0;
+		}
+
+		if ( refresh )
+		{
+			const json::mapped_file stored( sidecar.c_str() );
+			json::offset_index index = json::offset_index::load( stored.data(), stored.size() );
+			update( index, file, threads );
+			save( index, sidecar );
+			std::cerr << index.size() << " entries" << std::endl;
+			return 0;
+		}
+
+		json::offset_index index( json::offset_index::Lines );
+		if ( lines ) update( index, file, threads );
+		else index = json::offset_index::elements( file.data(), file.size(), pointer );
+
+		save( index, sidecar );
+		std::cerr << index.size() << " entries" << std::endl;
+	}
+	catch ( const json::exception &e )
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -41,6 +41,14 @@ void Test2( const A &value, const json::var &input, const B &original, unsigned
 	}
 }
 
+size_t characters = 0;
+
+const json::var& CountCharacters( json::parse_options::Events event, const json::var &value )
+{
+	if ( event == json::parse_options::NextCharacter ) ++characters;
+	return value;
+}
+
 void Assert( bool input, unsigned int line )
 {
 	if ( !input )
@@ -58,6 +66,73 @@ struct PODstruct
 	}
 };
 
+struct Address
+{
+	Address() :
+		city(),
+		zip( 0 ) { }
+
+	std::string city;
+	int zip;
+};
+
+struct Person
+{
+	Person() :
+		name(),
+		age( 0 ),
+		active( false ),
+		scores(),
+		places(),
+		extra()
+#if __cplusplus >= 201703L
+		, nickname()
+#endif
+	{ }
+
+	std::string name;
+	double age;
+	bool active;
+	std::vector< int > scores;
+	std::map< std::string, Address > places;
+	json::var extra;
+#if __cplusplus >= 201703L
+	std::optional< std::string > nickname;
+#endif
+};
+
+namespace json
+{
+	template <>
+	struct register_struct< Address >
+	{
+		template < class Fields >
+		static void fields( Fields &f )
+		{
+			f( "city", &Address::city );
+			f( "zip", &Address::zip );
+		}
+	};
+
+	template <>
+	struct register_struct< Person >
+	{
+		template < class Fields >
+		static void fields( Fields &f )
+		{
+			f( "name", &Person::name );
+			f( "age", &Person::age );
+			f( "active", &Person::active );
+			f( "scores", &Person::scores );
+			f( "places", &Person::places );
+			f( "extra", &Person::extra );
+#if __cplusplus >= 201703L
+			f( "nickname", &Person::nickname );
+#endif
+		}
+	};
+}
+
 int main( int, char *[] )
 {
 	json::var tak( 'a' );
@@ -346,6 +421,731 @@ int main( int, char *[] )
 		const PODstruct in = { 1.234e13, 11 };
 		const PODstruct out = json::base64::decode< PODstruct >( json::base64::encode( in ) );
 		Assert( in == out, __LINE__ );
+
+		std::vector< char > bytes;
+		for ( int i = 0; i < 1000; ++i ) bytes.push_back( static_cast< char >( i * 7 ) );
+		json::var binary( bytes );
+		Assert( binary.type == json::String && binary.binary() && binary.size() == 1336 && binary.toString() == json::base64::encode( &bytes[ 0 ], bytes.size() ), __LINE__ );
+		Assert( binary.to< std::vector< char > >() == bytes && binary == json::var( binary.toString() ) && binary.hash() == json::var( binary.toString() ).hash(), __LINE__ );
+
+		json::var carrier;
+		carrier[ "blob" ] = json::var::raw_bytes( "\xff\x00" "A", 3 );
+		Assert( carrier.serialize() == "{\"blob\":\"/wBB\"}" && carrier[ "blob" ].bytes().size() == 3, __LINE__ );
+		const json::var parsed = json::parser( carrier.serialize() );
+		Assert( !parsed[ "blob" ].binary() && parsed[ "blob" ].bytes() == carrier[ "blob" ].bytes() && !parsed[ "blob" ].binary() && parsed == carrier, __LINE__ );
+		const json::var loose( "QUJDRA" );
+		Assert( !loose.bytes().empty() && !loose.binary() && loose.toString() == "QUJDRA", __LINE__ );
+		json::var decoded = json::parser( carrier.serialize() ), unpadded( loose );
+		Assert( decoded[ "blob" ].to_bytes() && decoded[ "blob" ].binary() && decoded == carrier && !unpadded.to_bytes() && unpadded.toString() == "QUJDRA", __LINE__ );
+		json::wvar wide( json::wvar::raw_bytes( "ABCD", 4 ) );
+		Assert( wide.toString() == L"QUJDRA==" && wide.bytes().size() == 4 && wide.bytes()[ 3 ] == 'D', __LINE__ );
+
+		// typed structs
+		const Person person = json::read< Person >( "{ \"name\":\"piet\", \"unknown\":[ 1, { \"a\":2 } ], \"age\":42.5, \"active\":true,"
+			"\"scores\":[ 1, 2, 3 ], \"places\":{ \"home\":{ \"city\":\"Delft\", \"zip\":2611 } }, \"extra\":{ \"x\":[ null ] } }" );
+		Assert( person.name == "piet" && person.age == 42.5 && person.active, __LINE__ );
+		Assert( person.scores.size() == 3 && person.scores[ 2 ] == 3, __LINE__ );
+		Assert( person.places.find( "home" ) != person.places.end() && person.places.find( "home" )->second.zip == 2611, __LINE__ );
+		Assert( person.extra[ "x" ][ 0 ].type == json::Null, __LINE__ );
+#if __cplusplus >= 201703L
+		Assert( !person.nickname, __LINE__ );
+#endif
+		expected = json::parser( json::write( person ) );
+		Test( json::write( person ), expected, __LINE__, RoundTrip );
+		Assert( expected[ "places" ][ "home" ][ "city" ] == "Delft" && !expected.has_key( "nickname" ), __LINE__ );
+		Assert( json::write( json::read< Person >( json::write( person ) ) ) == json::write( person ), __LINE__ );
+		Assert( json::read< Address >( "{ \"zip\":-2611 }" ).zip == -2611 && json::read< Address >( "{ \"zip\":2.611e3 }" ).zip == 2611, __LINE__ );
+		const char *inexact[] = { "{ \"zip\":1.5 }", "{ \"zip\":2147483648 }", "{ \"zip\":-2147483649 }", "{ \"zip\":1e10 }", "{ \"zip\":99999999999999999999 }" };
+		for ( size_t i = 0; i < sizeof( inexact ) / sizeof( *inexact ); ++i )
+		{
+			try
+			{
+				json::read< Address >( inexact[ i ] );
+				Assert( false, __LINE__ );
+			}
+			catch ( const json::exception& )
+			{
+			}
+		}
+
+#if __cplusplus >= 201103L
+		// schema validation
+		const json::schema schema( json::parser( "{ \"type\":\"object\", \"required\":[ \"id\", \"tags\" ], \"additionalProperties\":false,"
+			"\"properties\":{ \"id\":{ \"$ref\":\"#/$defs/id\" }, \"tags\":{ \"type\":\"array\", \"items\":{ \"type\":\"string\", \"pattern\":\"^[a-z]+$\" }, \"uniqueItems\":true },"
+			"\"kind\":{ \"enum\":[ \"a\", \"b\" ] }, \"size\":{ \"anyOf\":[ { \"type\":\"integer\", \"minimum\":0 }, { \"type\":\"null\" } ] } },"
+			"\"$defs\":{ \"id\":{ \"type\":\"integer\", \"exclusiveMinimum\":0 } } }" ) );
+		const std::string valid = "{ \"id\":7, \"tags\":[ \"x\", \"y\" ], \"kind\":\"b\", \"size\":null }";
+		Assert( schema.validate( json::parser( valid ) ) && schema.validate( valid.begin(), valid.end() ), __LINE__ );
+		const char *invalid[] = {
+			"{ \"id\":0, \"tags\":[] }",
+			"{ \"id\":1.5, \"tags\":[] }",
+			"{ \"id\":1 }",
+			"{ \"id\":1, \"tags\":[ \"X\" ] }",
+			"{ \"id\":1, \"tags\":[ \"x\", \"x\" ] }",
+			"{ \"id\":1, \"tags\":[], \"kind\":\"c\" }",
+			"{ \"id\":1, \"tags\":[], \"size\":-1 }",
+			"{ \"id\":1, \"tags\":[], \"other\":1 }",
+			"[ 1 ]"
+		};
+		for ( unsigned int i = 0; i < sizeof( invalid ) / sizeof( invalid[ 0 ] ); ++i )
+		{
+			const std::string document( invalid[ i ] );
+			Assert( !schema.validate( json::parser( document ) ) && !schema.validate( document.begin(), document.end() ), __LINE__ );
+		}
+		try
+		{
+			schema.check( json::parser( invalid[ 3 ] ) );
+			Assert( false, __LINE__ );
+		}
+		catch ( const json::exception &e )
+		{
+			Assert( std::string( e.what() ) == "schema violation: pattern at /tags/0", __LINE__ );
+		}
+		const json::schema members( json::parser( "{ \"uniqueItems\":true, \"items\":{ \"enum\":[ { \"a\":1, \"b\":2 }, 3 ] }, \"const\":[ { \"b\":2, \"a\":1 } ] }" ) );
+		Assert( members.validate( json::parser( "[ { \"b\":2, \"a\":1 } ]" ) ) && !members.validate( json::parser( "[ { \"a\":1, \"b\":2 }, { \"b\":2, \"a\":1 } ]" ) ), __LINE__ );
+		const json::schema patterns( json::parser( "{ \"patternProperties\":{ \"a\":true, \"b\":true, \"c\":true, \"d\":true,"
+			"\"e\":true, \"f\":true, \"g\":true, \"h\":true, \"i\":true, \"j\":{ \"type\":\"string\" } } }" ) );
+		const std::string many = "{ \"abcdefghij\":1 }";
+		Assert( !patterns.validate( json::parser( many ) ) && !patterns.validate( many.begin(), many.end() ), __LINE__ );
+		const char *cycles[] = { "{ \"$ref\":\"#\" }", "{ \"$defs\":{ \"a\":{ \"allOf\":[ { \"$ref\":\"#/$defs/b\" } ] }, \"b\":{ \"$ref\":\"#/$defs/a\" } }, \"$ref\":\"#/$defs/a\" }" };
+		for ( size_t i = 0; i < sizeof( cycles ) / sizeof( *cycles ); ++i )
+		{
+			try
+			{
+				const json::schema cycle( json::parser( cycles[ i ] ) );
+				Assert( false, __LINE__ );
+			}
+			catch ( const json::exception & )
+			{
+			}
+		}
+		const json::schema nested( json::parser( "{ \"items\":{ \"$ref\":\"#\" } }" ) );
+		Assert( nested.validate( json::parser( "[ [ [] ] ]" ) ), __LINE__ );
+#endif
+
+		// merge patch
+		json::var target = json::parser( "{ \"a\":\"b\", \"c\":{ \"d\":\"e\", \"f\":\"g\" } }" );
+		json::merge_patch( target, json::parser( "{ \"a\":\"z\", \"c\":{ \"f\":null }, \"n\":{ \"x\":null, \"y\":1 } }" ) );
+		Test( "{ \"a\":\"z\", \"c\":{ \"d\":\"e\" }, \"n\":{ \"y\":1 } }", target, __LINE__, RoundTrip );
+
+		// json patch
+		json::var document = json::parser( "{ \"foo\":[ \"bar\", \"baz\" ], \"q\":{ \"a/b\":1 } }" );
+		const json::var original( document );
+		json::apply_patch( document, json::parser( "[ { \"op\":\"add\", \"path\":\"/foo/1\", \"value\":\"qux\" },"
+			"{ \"op\":\"remove\", \"path\":\"/foo/2\" }, { \"op\":\"replace\", \"path\":\"/q/a~1b\", \"value\":2 },"
+			"{ \"op\":\"copy\", \"from\":\"/foo\", \"path\":\"/copy\" }, { \"op\":\"move\", \"from\":\"/q\", \"path\":\"/foo/-\" },"
+			"{ \"op\":\"test\", \"path\":\"/foo/2/a~1b\", \"value\":2 } ]" ) );
+		Test( "{ \"foo\":[ \"bar\", \"qux\", { \"a/b\":2 } ], \"copy\":[ \"bar\", \"qux\" ] }", document, __LINE__, RoundTrip );
+		Test( "{ \"foo\":[ \"bar\", \"baz\" ], \"q\":{ \"a/b\":1 } }", original, __LINE__, NoRoundTrip );
+		const json::var before( document );
+		try
+		{
+			json::apply_patch( document, json::parser( "[ { \"op\":\"remove\", \"path\":\"/copy\" }, { \"op\":\"test\", \"path\":\"/foo/0\", \"value\":1 } ]" ) );
+			Assert( false, __LINE__ );
+		}
+		catch ( const json::exception & )
+		{
+			Assert( document == before, __LINE__ );
+		}
+		json::var unordered = json::parser( "{ \"o\":{ \"x\":1, \"y\":2 } }" );
+		json::apply_patch( unordered, json::parser( "[ { \"op\":\"test\", \"path\":\"/o\", \"value\":{ \"y\":2, \"x\":1 } } ]" ) );
+		Assert( unordered[ "o" ][ "y" ] == 2, __LINE__ );
+
+		// diff
+		const json::var from = json::parser( "{ \"a\":[ 1, 2, 3, 4 ], \"b\":{ \"c\":1, \"d\":2 }, \"e\":1 }" );
+		const json::var to = json::parser( "{ \"a\":[ 1, 9, 4, 5, 6 ], \"b\":{ \"d\":2, \"c\":1, \"x\":[] }, \"f\":1 }" );
+		json::var patched( from );
+		json::apply_patch( patched, json::diff( from, to ) );
+		Assert( json::diff( patched, to ).empty(), __LINE__ );
+		Assert( json::diff( from, from ).empty() && json::diff( from, to ).size() == 7, __LINE__ );
+
+		// hashing and equality
+		json::var ordered = json::parser( "{ \"a\":1, \"b\":[ 1, 2 ], \"c\":{ \"x\":\"y\", \"z\":null } }" );
+		const json::var reordered = json::parser( "{ \"c\":{ \"z\":null, \"x\":\"y\" }, \"b\":[ 1, 2 ], \"a\":1 }" );
+		Assert( ordered != reordered && ordered.equals( reordered ) && !ordered.equals( reordered, json::OrderedKeys ), __LINE__ );
+		Assert( ordered.hash() == reordered.hash() && ordered.hash() != json::var( 1 ).hash(), __LINE__ );
+		const size_t cached = ordered.hash();
+		ordered[ "b" ][ 0 ] = 3;
+		Assert( ordered.hash() != cached && !ordered.equals( reordered ), __LINE__ );
+		json::var held = json::parser( "{ \"x\":1, \"y\":{ \"z\":[ 1 ] } }" );
+		const json::var edited_held = json::parser( "{ \"x\":2, \"y\":{ \"z\":[ 2 ] } }" );
+		json::var &x = held[ "x" ], &z = held[ "y" ][ "z" ][ 0 ];
+		const size_t unchanged = held.hash();
+		x = 2;
+		z = 2;
+		Assert( held == edited_held && held.hash() == edited_held.hash() && held.hash() != unchanged, __LINE__ );
+		std::tr1::unordered_map< json::var, int > counts;
+		++counts[ reordered ];
+		++counts[ json::parser( reordered.serialize() ) ];
+		++counts[ ordered ];
+		Assert( counts.size() == 2 && counts[ reordered ] == 2, __LINE__ );
+
+		// canonical json
+		const json::var numbers = json::parser( "[ 333333333.33333329, 1E30, 4.50, 2e-3, 0.000001, 1e-7, -0, 1e21, 123456789012, -1.5e-300 ]" );
+		Assert( json::canonical( numbers ) == "[333333333.3333333,1e+30,4.5,0.002,0.000001,1e-7,0,1e+21,123456789012,-1.5e-300]", __LINE__ );
+		const json::var keys = json::parser( "{ \"\\u20ac\":\"Euro Sign\", \"\\r\":\"Carriage Return\", \"\\ufb33\":\"Hebrew Letter Dalet With Dagesh\","
+			"\"1\":\"One\", \"\\ud83d\\ude00\":\"Emoji: Grinning Face\", \"\\u0080\":\"Control\\u007f\", \"\\u00f6\":\"Latin Small Letter O With Diaeresis\" }" );
+		Assert( json::canonical( keys ) == "{\"\\r\":\"Carriage Return\",\"1\":\"One\",\"\xc2\x80\":\"Control\x7f\",\"\xc3\xb6\":\"Latin Small Letter O With Diaeresis\","
+			"\"\xe2\x82\xac\":\"Euro Sign\",\"\xf0\x9f\x98\x80\":\"Emoji: Grinning Face\",\"\xef\xac\xb3\":\"Hebrew Letter Dalet With Dagesh\"}", __LINE__ );
+		Assert( json::parser( "[ \"\\ud800\\u0041\", \"\\udc00x\", \"\\ud83d\\ud83d\\ude00\", \"\\ud800\" ]" ).serialize() == "[\"\xed\xa0\x80" "A\",\"\xed\xb0\x80x\",\"\xed\xa0\xbd\xf0\x9f\x98\x80\",\"\xed\xa0\x80\"]", __LINE__ );
+		const std::string relaxed = "{ a:'b', \"c\":[ 1, 2 ] }";
+		characters = 0;
+		Assert( json::parser( relaxed, CountCharacters ) == json::parser( relaxed ) && characters == relaxed.size(), __LINE__ );
+		try
+		{
+			json::parser( relaxed, json::parse_options::strict );
+			Assert( false, __LINE__ );
+		}
+		catch ( const json::exception & )
+		{
+		}
+		json::fnv1a_hasher streamed, whole;
+		const std::string canonical_text = json::canonical( reordered );
+		whole.update( canonical_text.data(), canonical_text.size() );
+		Assert( json::canonical_hash( reordered, streamed ).value() == whole.value(), __LINE__ );
+		json::fnv1a_hasher first, second;
+		Assert( json::canonical_hash( reordered, first ).value() == json::canonical_hash( json::parser( "{ \"a\":1.0, \"b\":[ 1, 2 ], \"c\":{ \"x\":\"y\", \"z\":null } }" ), second ).value(), __LINE__ );
+
+		const json::var records = json::parser( "[ { \"identifier\":1, \"a_rather_long_member_name\":\"red\" }, { \"identifier\":2, \"a_rather_long_member_name\":\"red\" } ]" );
+		Assert( sizeof( json::var::key_type ) == 2 * sizeof( void* ), __LINE__ );
+		Assert( records[ 0 ].begin()->key == std::string( "identifier" ), __LINE__ );
+		Assert( ( records[ 0 ].begin() + 1 )->key.data() == ( records[ 1 ].begin() + 1 )->key.data(), __LINE__ );
+		Assert( ( records[ 0 ].begin() + 1 )->key == json::var::key_type( "a_rather_long_member_name" ), __LINE__ );
+		Assert( records[ 1 ][ "a_rather_long_member_name" ] == "red", __LINE__ );
+		json::string_table< char > table( 1 );
+		Assert( table.intern( "short" ).size() == 5 && table.size() == 0, __LINE__ );
+		Assert( table.intern( "a_rather_long_member_name" ).data() == table.intern( std::string( "a_rather_long_member_name" ) ).data(), __LINE__ );
+		Assert( table.intern( "another_long_member_name" ).data() != table.intern( "another_long_member_name" ).data() && table.size() == 1, __LINE__ );
+		json::var edited = records[ 0 ];
+		edited[ "a_rather_long_member_name" ] = "blue";
+		Assert( records[ 0 ][ "a_rather_long_member_name" ] == "red" && records[ 1 ][ "a_rather_long_member_name" ] == "red", __LINE__ );
+
+		const std::string rows = "{ \"points\":[ { \"x\":1, \"y\":\"a\" }, { \"x\":2, \"y\":[ true ] }, { \"x\":3, \"y\":null } ], \"mixed\":[ { \"x\":1 }, { \"y\":2 } ] }";
+		const json::var generic = json::parser( rows );
+		const json::var columns = json::parser( rows, json::parse_options::columns() );
+		Assert( columns[ "points" ].columnar() && !columns[ "mixed" ].columnar() && !generic[ "points" ].columnar(), __LINE__ );
+		Assert( columns.serialize() == generic.serialize(), __LINE__ );
+		Assert( columns.serialize( json::HumanReadable | json::CountArrayValues ) == generic.serialize( json::HumanReadable | json::CountArrayValues ), __LINE__ );
+		Assert( columns[ "points" ].size() == 3 && columns[ "points" ].column( "x" ).serialize() == "[1,2,3]", __LINE__ );
+		Assert( generic[ "points" ].column( "y" ) == columns[ "points" ].column( "y" ), __LINE__ );
+		Assert( columns[ "points" ][ 1 ][ "y" ][ 0 ] == true && columns == generic && columns.hash() == generic.hash(), __LINE__ );
+		json::var points = columns[ "points" ];
+		points[ 2 ][ "x" ] = 4;
+		Assert( !points.columnar() && points.column( "x" ).serialize() == "[1,2,4]" && columns[ "points" ][ 2 ][ "x" ] == 3, __LINE__ );
+		Assert( points.to_columns() && points.columnar() && points.serialize() == "[{\"x\":1,\"y\":\"a\"},{\"x\":2,\"y\":[true]},{\"x\":4,\"y\":null}]", __LINE__ );
+
+		json::var series = json::parser( "[ 3, -1, 4, 1, -5, 9, 2, 6 ]" );
+		Assert( series.integers() && !series.doubles() && series.integers()[ 5 ] == 9, __LINE__ );
+		Assert( series.sum() == 19 && series.minimum() == -5 && series.maximum() == 9, __LINE__ );
+		series.push( 0.5 );
+		Assert( series.doubles() && !series.integers() && series.doubles()[ 8 ] == 0.5 && series.sum() == 19.5, __LINE__ );
+		const json::var &view = series;
+		Assert( series.serialize() == "[3,-1,4,1,-5,9,2,6,0.5]" && view[ 4 ] == -5 && series.size() == 9, __LINE__ );
+		json::var plain = series;
+		plain.begin();
+		Assert( !plain.doubles() && view == plain && plain == view && view.hash() == plain.hash() && view.back() == 0.5 && view.doubles(), __LINE__ );
+		json::var copy = series;
+		copy.push( "seven" );
+		Assert( !copy.doubles() && copy.size() == 10 && copy[ 9 ] == "seven" && series.doubles() && series.size() == 9, __LINE__ );
+		const json::var decimals = json::parser( "[ 1, 0.1 ]" );
+		Assert( !decimals.doubles() && !decimals.integers() && decimals.sum() == 1 + strtold( "0.1", 0 ), __LINE__ );
+		Assert( json::parser( "[ -0, 1e300 ]" ).serialize() == "[-0,1e+300]" && json::parser( "[]" ).minimum() != json::parser( "[]" ).minimum(), __LINE__ );
+		const char *exact[] = { "0.1", "123456789.987654321", "-2.5e-7", "1e27", "9007199254740993", "0.000001", "1234567890123456789", "12345678901234567890", "3.14159265358979323846", "1e-400" };
+		for ( size_t i = 0; i < sizeof( exact ) / sizeof( *exact ); ++i )
+		{
+			Assert( json::parser( std::string( "[" ) + exact[ i ] + "]" )[ 0 ].toNumber() == strtold( exact[ i ], 0 ), __LINE__ );
+		}
+		const json::var big = json::parser( "[ 9223372036854775807, -9223372036854775808, 18446744073709551615, 12345678901234567 ]" );
+		Assert( big.serialize() == "[9223372036854775807,-9223372036854775808,18446744073709551615,12345678901234567]", __LINE__ );
+		Assert( big[ 0 ].toInteger() == 9223372036854775807LL && big[ 2 ].toUnsigned() == 18446744073709551615ULL, __LINE__ );
+		json::var counter( 9007199254740993LL );
+		counter += 1;
+		Assert( counter.serialize() == "9007199254740994" && json::var( 1 ) == json::var( 1.0 ) && json::var( 1 ).hash() == json::var( 1.0 ).hash(), __LINE__ );
+		json::basic_parser< json::CopyOnWrite, char > raw;
+		raw.raw_numbers( true );
+		const std::string text( "[ 1.50, 1e2, -0, 12345678901234567890123 ]" );
+		const json::var source = raw.parse( text.begin(), text.end(), json::parse_options::standard );
+		Assert( source.serialize() == "[1.50,1e2,-0,12345678901234567890123]" && source[ 0 ] == 1.5 && source[ 1 ] == 100 && source[ 1 ].hash() == json::var( 100 ).hash(), __LINE__ );
+		Assert( json::var::raw_number( "007" ).serialize() == "007" && json::var::raw_number( "42" ).toInteger() == 42, __LINE__ );
+
+		const json::var embedded = json::parser( "{ \"tags\":[ \"a\", \"b/c\" ], \"n\":{} }" );
+		const json::var report = json::parser( "{ \"id\":-12, \"name\":\"x\\\"y\", \"ok\":true, \"rows\":[ 1.5, null, [], { \"tags\":[ \"a\", \"b/c\" ], \"n\":{} } ] }" );
+		const unsigned int markups[] = { json::Compact, json::HumanReadable, json::HumanReadable | json::CountArrayValues };
+		for ( size_t i = 0; i < sizeof( markups ) / sizeof( *markups ); ++i )
+		{
+			std::string out;
+			json::string_sink< std::string > sink( out );
+			json::basic_writer< char, json::string_sink< std::string > > writer( sink, markups[ i ] );
+			writer.begin_object().key( "id" ).value( -12 ).key( "name" ).value( "x\"y" ).key( "ok" ).value( true );
+			writer.key( "rows" ).begin_array().value( 1.5 ).null().begin_array().end_array().value( embedded ).end_array().end_object();
+			Assert( writer.complete() && out == report.serialize( markups[ i ] ), __LINE__ );
+		}
+		{
+			const std::string source( "{ 'name' : \"d\\u00e9j\\u00e0 vu\", \"list\": [ 1.50, -2e3, true, false, null, [ ], { \"k/\":\"\\n\" } ] }" );
+			json::basic_reader< char, std::string::const_iterator > reader( source.begin(), source.end() );
+			reader.next();
+			std::string out;
+			json::string_sink< std::string > sink( out );
+			json::basic_writer< char, json::string_sink< std::string > > writer( sink );
+			json::transcode( reader, writer );
+			Assert( writer.complete() && out == "{\"name\":\"d\xc3\xa9j\xc3\xa0 vu\",\"list\":[1.50,-2e3,true,false,null,[],{\"k\\/\":\"\\n\"}]}" && json::parser( out ) == json::parser( source ), __LINE__ );
+		}
+		{
+			const size_t depth = 100000;
+			std::string nested;
+			for ( size_t i = 0; i < depth; ++i ) nested += i % 2 ? "[" : "{\"a\":";
+			nested += "1";
+			for ( size_t i = depth; i--; ) nested += i % 2 ? "]" : "}";
+			const json::var deep = json::parser( nested ), same = json::parser( nested );
+			Assert( deep.serialize() == nested && deep == same && deep.hash() == same.hash(), __LINE__ );
+			json::var merged;
+			merged.merge( deep );
+			merged.merge( merged );
+			const json::var copy = deep.clone();
+			Assert( merged == deep && copy.equals( deep, json::UnorderedKeys ) && copy[ "a" ][ 0 ].size() == 1, __LINE__ );
+			const json::var random = json::generate< json::CopyOnWrite, char >( depth, 4, 1 );
+			Assert( random.clone() == random, __LINE__ );
+		}
+		{
+			json::parse_limits limits;
+			limits.depth = 3;
+			limits.string = 8;
+			limits.elements = 4;
+			limits.nodes = 12;
+			limits.bytes = 64;
+			const char *inputs[] = { "[[[1]]]", "[[[[1]]]]", "{\"abcdefgh\":1}", "{\"abcdefghi\":1}", "[\"\\n\\n\\n\\n\\n\\n\\n\\n\\n\"]", "[1,2,3,4,5]", "[[1,2,3],[4,5,6],[7,8,9]]", "[                                                                  ]" };
+			const int expected[] = { -1, json::limit_error::Depth, -1, json::limit_error::String, json::limit_error::String, json::limit_error::Elements, json::limit_error::Nodes, json::limit_error::Bytes };
+			for ( size_t i = 0; i < sizeof( inputs ) / sizeof( *inputs ); ++i )
+			{
+				const std::string input( inputs[ i ] );
+				json::basic_parser< json::CopyOnWrite, char > bounded;
+				bounded.limits( limits );
+				int limit = -1;
+				try
+				{
+					Assert( bounded.parse( input.begin(), input.end(), json::parse_options::standard ) == json::parser( input ), __LINE__ );
+				}
+				catch ( const json::limit_error &e )
+				{
+					limit = e.limit();
+					Assert( e.offset() <= input.size() && std::string( e.what() ).find( "at offset" ) != std::string::npos, __LINE__ );
+				}
+				Assert( limit == expected[ i ], __LINE__ );
+			}
+		}
+		{
+			json::basic_parser< json::CopyOnWrite, char > reused;
+			json::var document;
+			const char *inputs[] = { "{\"a\":[1,2,3],\"b\":\"x\",\"c\":{\"d\":true}}", "{\"a\":[4,5],\"b\":\"y\",\"c\":{\"d\":null,\"e\":1}}", "{\"c\":[],\"a\":{\"z\":1.5}}", "{\"a\":1,\"a\":2,\"b\":[{\"k\":1},\"s\"]}", "[1,{\"q\":[true]},\"long string, not shared with anything\"]", "7", "{'single':1,unquoted:2}", "" };
+			for ( size_t i = 0; i < sizeof( inputs ) / sizeof( *inputs ); ++i )
+			{
+				const std::string input( inputs[ i ] );
+				const json::var alias = document;
+				reused.parse_into( document, input.begin(), input.end(), json::parse_options::standard );
+				const json::var fresh = json::basic_parser< json::CopyOnWrite, char >().parse( input.begin(), input.end(), json::parse_options::standard );
+				Assert( document == fresh && document.serialize() == fresh.serialize(), __LINE__ );
+				Assert( i == 0 || alias.serialize() == json::parser( std::string( inputs[ i - 1 ] ) ).serialize(), __LINE__ );
+			}
+			const std::string longer( "[1,2,3,4,5,6,7,8]" ), shorter( "[9,10]" );
+			reused.parse_into( document, longer );
+			const long long *storage = document.integers();
+			reused.parse_into( document, shorter );
+			Assert( storage && document.integers() == storage && document.size() == 2 && document[ 1 ] == 10, __LINE__ );
+		}
+		{
+			const std::string input( "{\"state\":[1,2,{\"a\":\"b\"}],\"counter\":3,\"name\":\"a string longer than the inline buffer\"}" );
+			json::pooled_var state = json::basic_parser< json::PooledCopyOnWrite, char >().parse( input.begin(), input.end(), json::parse_options::passthrough() );
+			Assert( state.serialize() == json::parser( input ).serialize(), __LINE__ );
+			for ( int i = 0; i < 1000; ++i )
+			{
+				json::pooled_var shared = state;
+				state[ "counter" ] = i;
+				state[ "state" ].push( i );
+				state[ "state" ].splice( 2, 1 );
+				Assert( shared[ "counter" ] == ( i ? i - 1 : 3 ), __LINE__ );
+			}
+			Assert( state[ "counter" ] == 999 && state[ "state" ].size() == 3 && state[ "state" ][ 2 ] == 999, __LINE__ );
+			void *block = json::node_pool::allocate( 40 );
+			json::node_pool::deallocate( block, 40 );
+			Assert( json::node_pool::allocate( 33 ) == block, __LINE__ );
+			json::node_pool::deallocate( block, 48 );
+			json::node_pool::release();
+			Assert( json::node_pool::retained() == 0, __LINE__ );
+		}
+		{
+			json::var base( json::Object );
+			for ( int i = 0; i < 5000; ++i ) base[ "member" + json::var( i ).toString() ] = i;
+			base[ "list" ] = json::parser( "[1,2,3]" );
+
+			const json::persistent first( base );
+			const json::persistent second = first.set( "member42", "changed" ).set( "added", true ).erase( "member7" );
+			const json::persistent third = second.set_pointer( "/list/-", 4 ).set_pointer( "/list/0", json::var( json::Null ) );
+			Assert( first.var() == base && first[ "member42" ].var() == 42, __LINE__ );
+			Assert( second.size() == 5001 && second[ "member42" ].var() == "changed" && !second.has_key( "member7" ) && second.has_key( "added" ), __LINE__ );
+			Assert( second[ "list" ].var() == json::parser( "[1,2,3]" ) && third[ "list" ].var() == json::parser( "[null,2,3,4]" ), __LINE__ );
+
+			json::var expected = base;
+			expected[ "member42" ] = "changed";
+			expected[ "added" ] = true;
+			expected.erase( "member7" );
+			expected[ "list" ] = json::parser( "[null,2,3,4]" );
+			Assert( third.var().serialize() == expected.serialize(), __LINE__ );
+
+			json::persistent elements( json::var( json::Array ) );
+			std::vector< json::persistent > versions;
+			for ( size_t i = 0; i < 1100; ++i )
+			{
+				elements = elements.push( json::var( static_cast< int >( i ) ) );
+				versions.push_back( elements );
+			}
+			elements = elements.set( 1050, "x" ).set( 1102, false );
+			Assert( elements.size() == 1103 && elements[ 1050 ].var() == "x" && elements[ 1101 ].type() == json::Undefined && versions[ 1099 ][ 1050 ].var() == 1050, __LINE__ );
+			Assert( versions[ 31 ].size() == 32 && versions[ 32 ][ 32 ].var() == 32 && versions[ 1023 ].var().size() == 1024 && versions[ 1024 ].var()[ 1024 ] == 1024, __LINE__ );
+
+			try
+			{
+				third.set_pointer( "/missing/key", 1 );
+				Assert( false, __LINE__ );
+			}
+			catch ( const json::exception& )
+			{
+			}
+		}
+		{
+			json::var document = json::parser( "{\"name\":\"reference\",\"list\":[1,-2,18446744073709551615,2.5,true,null,\"\"],\"nested\":{\"a\":{\"b\":[{}]}}}" );
+			for ( int i = 0; i < 100; ++i ) document[ "wide" ][ "key" + json::var( i ).toString() ] = i;
+
+			const std::string bytes = json::image( document );
+			const json::view root = json::view::open( bytes.data(), bytes.size() );
+			Assert( root.type() == json::Object && root.size() == 4 && root[ "name" ].toString() == "reference" && root[ "missing" ].type() == json::Undefined, __LINE__ );
+			Assert( root[ "list" ].size() == 7 && root[ "list" ][ 1 ].toInteger() == -2 && root[ "list" ][ 2 ].toUnsigned() == 18446744073709551615ULL && root[ "list" ][ 3 ].toNumber() == 2.5, __LINE__ );
+			Assert( root[ "list" ][ 4 ].toBool() && root[ "list" ][ 5 ].type() == json::Null && root[ "list" ][ 6 ].empty() && root[ "nested" ][ "a" ][ "b" ][ 0 ].type() == json::Object, __LINE__ );
+			Assert( root[ "wide" ].size() == 100 && root[ "wide" ][ "key73" ].toInteger() == 73 && !root[ "wide" ].has_key( "key100" ), __LINE__ );
+
+			std::string keys;
+			for ( json::view::const_iterator i = root.begin(); i != root.end(); ++i ) keys += i->key.toString();
+			Assert( keys == "namelistnestedwide" && root.var< json::CopyOnWrite >() == document && root.var< json::CopyOnWrite >().serialize() == document.serialize(), __LINE__ );
+
+			try
+			{
+				json::view::open( bytes.data(), bytes.size() - 1 );
+				Assert( false, __LINE__ );
+			}
+			catch ( const json::exception& )
+			{
+			}
+		}
+		{
+			const std::string text( "{\"meta\":{\"a\\\"]\":[1,{\"}\":\"[\"}]},\"re\\u0063ords\":[ {\"id\":1,\"s\":\"x\\\\\"} , [2,[3]],\"]\" ,-4.5e3 ,null ]}" );
+			const json::offset_index index = json::offset_index::elements( text.data(), text.size(), "/records" );
+			Assert( index.size() == 5 && index.element( text.data(), 0 ) == json::parser( "{\"id\":1,\"s\":\"x\\\\\"}" ) && index.element( text.data(), 1 ) == json::parser( "[2,[3]]" ), __LINE__ );
+			Assert( index.element( text.data(), 2 ) == json::var( "]" ) && index.element( text.data(), 3 ) == -4500 && index.element( text.data(), 4 ).type == json::Null, __LINE__ );
+			Assert( json::offset_index::elements( text.data(), text.size(), "/meta/a\"]" ).size() == 2, __LINE__ );
+
+			std::string lines( "{\"n\":0}\n\n[1]\n{\"n\":" );
+			json::offset_index appended;
+			appended.update( lines.data(), lines.size() );
+			Assert( appended.size() == 3 && appended.pending() == 13, __LINE__ );
+			lines += "2}\n\"tail\"";
+			appended.update( lines.data(), lines.size() );
+			Assert( appended.size() == 4 && appended.element( lines.data(), 2 )[ "n" ] == 2 && appended.element( lines.data(), 3 ) == json::var( "tail" ), __LINE__ );
+
+			std::vector< json::index_entry > chunked;
+			for ( size_t begin = 0; begin < lines.size(); begin += 5 ) json::structural::lines( lines.data(), lines.size(), begin, begin + 5, chunked );
+			Assert( chunked.size() == 4 && chunked[ 3 ].offset == appended[ 3 ].offset && chunked[ 1 ].length == 3, __LINE__ );
+
+			std::string saved;
+			json::string_sink< std::string > sink( saved );
+			appended.save( sink );
+			const json::offset_index loaded = json::offset_index::load( saved.data(), saved.size() );
+			Assert( loaded.size() == 4 && loaded[ 2 ].offset == appended[ 2 ].offset && loaded.matches( lines.data(), lines.size() ) && !loaded.matches( text.data(), text.size() ), __LINE__ );
+		}
+		{
+			const std::string text( "{\"name\":\"tape\",\"list\":[1,-2,18446744073709551615,2.5,true,null,\"\",[[]],{}],\"nested\":{\"a\":{\"b\":[{\"c\":\"x\\u0041\"}]}},\"last\":-0}" );
+			const json::tape document( text );
+			const json::tape_view root = document.root();
+			Assert( root.type() == json::Object && root.size() == 4 && root[ "name" ].toString() == "tape" && root[ "missing" ].type() == json::Undefined && root[ 0 ].type() == json::Undefined, __LINE__ );
+			Assert( root[ "list" ].size() == 9 && root[ "list" ][ 1 ].toInteger() == -2 && root[ "list" ][ 2 ].toUnsigned() == 18446744073709551615ULL && root[ "list" ][ 3 ].toNumber() == 2.5, __LINE__ );
+			Assert( root[ "list" ][ 4 ].toBool() && root[ "list" ][ 5 ].type() == json::Null && root[ "list" ][ 6 ].empty() && root[ "list" ][ 7 ][ 0 ].type() == json::Array && root[ "list" ][ 8 ].type() == json::Object, __LINE__ );
+			Assert( root[ "nested" ][ "a" ][ "b" ][ 0 ][ "c" ].toString() == "xA" && std::string( root[ "nested" ][ "a" ][ "b" ][ 0 ][ "c" ].data() ) == "xA" && root[ "list" ][ 9 ].type() == json::Undefined, __LINE__ );
+
+			std::string keys;
+			for ( json::tape_view::const_iterator i = root.begin(); i != root.end(); ++i ) keys += i->key.toString();
+			Assert( keys == "namelistnestedlast" && root.var< json::CopyOnWrite >() == json::parser( text ) && root[ "nested" ].var< json::CopyOnWrite >().serialize() == json::parser( text )[ "nested" ].serialize(), __LINE__ );
+
+			int elements = 0;
+			for ( json::tape_view::const_iterator i = root[ "list" ].begin(); i != root[ "list" ].end(); ++i ) elements += i->key.type() == json::Undefined;
+			Assert( elements == 9 && root[ "name" ].begin() == root[ "name" ].end() && json::tape_view().begin() == json::tape_view().end(), __LINE__ );
+
+			json::tape reused;
+			reused.parse( std::string( "[1,{\"a\":[2" ) );
+			Assert( reused.root().size() == 2 && reused.root()[ 1 ][ "a" ][ 0 ].toInteger() == 2 && reused.words().size() == 15, __LINE__ );
+			reused.parse( std::string( "{\"k\"}" ) );
+			Assert( reused.root()[ "k" ].type() == json::Null && reused.strings() == std::string( "k", 2 ), __LINE__ );
+
+			try
+			{
+				reused.parse( std::string( "{[1]:2}" ) );
+				Assert( false, __LINE__ );
+			}
+			catch ( const json::exception& )
+			{
+				Assert( reused.root().type() == json::Undefined, __LINE__ );
+			}
+		}
+		{
+			json::basic_parser< json::CopyOnWrite, char > proxy;
+			proxy.capture( "/payload" );
+			proxy.capture( "/items/1" );
+
+			json::var document;
+			proxy.parse_into( document, std::string( "{\"id\":7,\"payload\":{ \"a\" : [1, 2.50, 'x\\n', true, null, {}], b : {\"c\":\"\\u00e9\"} },\"items\":[[1],[2,{\"k\"}],[3]]}" ) );
+			Assert( document[ "payload" ].type == json::Object && document[ "payload" ].fragment() && document[ "items" ][ 1 ].fragment() && !document[ "items" ][ 0 ].fragment(), __LINE__ );
+			Assert( document.serialize() == "{\"id\":7,\"payload\":{\"a\":[1,2.50,\"x\\n\",true,null,{}],\"b\":{\"c\":\"\xc3\xa9\"}},\"items\":[[1],[2,{\"k\":null}],[3]]}", __LINE__ );
+
+			const json::var copy( document );
+			Assert( copy[ "payload" ][ "a" ][ 2 ] == "x\n" && copy[ "payload" ][ "b" ][ "c" ].toString().size() == 2 && document[ "payload" ].fragment(), __LINE__ );
+			Assert( document[ "items" ][ 1 ].size() == 2 && document == json::parser( document.serialize() ) && document.hash() == json::parser( document.serialize() ).hash(), __LINE__ );
+
+			json::var forwarded = json::var::raw_fragment( " [1,{\"x\":[]}]" );
+			Assert( forwarded.type == json::Array && forwarded.serialize() == " [1,{\"x\":[]}]" && forwarded == json::var::raw_fragment( " [1,{\"x\":[]}]" ) && forwarded.size() == 2 && forwarded.fragment(), __LINE__ );
+			forwarded.push( 3 );
+			Assert( forwarded.size() == 3 && forwarded.serialize() == "[1,{\"x\":[]},3]", __LINE__ );
+			forwarded = json::var::raw_fragment( "{\"a\":1}" );
+			forwarded[ 0 ] = true;
+			Assert( forwarded.type == json::Array && forwarded.serialize() == "[true]", __LINE__ );
+
+			proxy.parse_into( document, std::string( "{\"payload\":[1,2" ) );
+			Assert( document.size() == 1 && document[ "payload" ].fragment() && document.serialize() == "{\"payload\":[1,2]}", __LINE__ );
+
+			try
+			{
+				json::var::raw_fragment( "12" );
+				Assert( false, __LINE__ );
+			}
+			catch ( const json::exception& )
+			{
+			}
+		}
+		{
+			json::var document = json::parser( "{\"users\":[{\"name\":\"a\",\"tags\":[1,2]},{\"name\":\"b\",\"tags\":[]}],\"config\":{\"deep\":{\"deeper\":[true,null,\"x\"]}},\"empty\":{}}" );
+			document[ "packed" ].push_integer( 4 );
+			document[ "records" ] = json::parser( "[{\"k\":1},{\"k\":2}]" );
+			document[ "records" ].to_columns();
+			document[ "raw" ] = json::var::raw_fragment( "[ 1 ]" );
+
+			const unsigned int markups[] = { json::Compact, json::HumanReadable, json::HumanReadable | json::CountArrayValues };
+			for ( int round = 0; round < 3; ++round )
+			{
+				for ( size_t m = 0; m < sizeof( markups ) / sizeof( markups[ 0 ] ); ++m )
+				{
+					Assert( document.serialize( markups[ m ] | json::Cached ) == document.serialize( markups[ m ] ), __LINE__ );
+					Assert( document.serialize( markups[ m ] | json::Cached ) == document.serialize( markups[ m ] ) && document[ "config" ].serialize( markups[ m ] | json::Cached, 2 ) == document[ "config" ].serialize( markups[ m ], 2 ), __LINE__ );
+				}
+
+				if ( round == 0 ) document[ "config" ][ "deep" ][ "deeper" ][ 1 ] = 5;
+				if ( round == 1 ) document[ "users" ][ 1 ][ "tags" ].push( "new" );
+			}
+
+			const json::var shared( document );
+			document[ "users" ][ 0 ][ "name" ] = "changed";
+			Assert( shared[ "users" ][ 0 ][ "name" ] == "a" && shared.serialize( json::Cached ).find( "changed" ) == std::string::npos && document.serialize( json::Cached ).find( "changed" ) != std::string::npos, __LINE__ );
+			Assert( document.serialize( json::Cached ) == document.serialize() && json::var( 1 ).serialize( json::Cached ) == "1", __LINE__ );
+		}
+		{
+			json::var held = json::parser( "{\"x\":{\"n\":1},\"y\":[true]}" );
+			json::var &n = held[ "x" ][ "n" ];
+			Assert( held.serialize( json::Cached ) == "{\"x\":{\"n\":1},\"y\":[true]}", __LINE__ );
+			n = 5;
+			Assert( held.serialize( json::Cached ) == "{\"x\":{\"n\":5},\"y\":[true]}" && held[ "x" ].serialize( json::Cached ) == "{\"n\":5}", __LINE__ );
+		}
+		{
+			json::var document = json::parser( "{\"a\":{\"b\":1,\"c\":[\"x\"]},\"d\":{\"e\":{\"f\":true}}}" );
+			document[ "a" ][ "b" ] = 7;
+			const json::var &view = document;
+			Assert( document.serialize( json::Cached ) == "{\"a\":{\"b\":7,\"c\":[\"x\"]},\"d\":{\"e\":{\"f\":true}}}" && view.cached() && view[ "a" ].cached() && view[ "d" ].cached(), __LINE__ );
+			const size_t before = view.hash();
+			json::var &b = document[ "a" ][ "b" ];
+			Assert( !view.cached() && view[ "a" ][ "c" ].cached() && view[ "d" ].cached() && view[ "d" ][ "e" ].cached(), __LINE__ );
+			Assert( document.serialize( json::Cached ) == "{\"a\":{\"b\":7,\"c\":[\"x\"]},\"d\":{\"e\":{\"f\":true}}}" && view.cached() && view.hash() == before, __LINE__ );
+			b = 8;
+			Assert( !view.cached() && view[ "d" ].cached() && view.hash() != before && view.hash() == json::parser( view.serialize() ).hash(), __LINE__ );
+			Assert( document.serialize( json::Cached ) == "{\"a\":{\"b\":8,\"c\":[\"x\"]},\"d\":{\"e\":{\"f\":true}}}" && view.cached() && view.cached( json::HumanReadable ) == false, __LINE__ );
+		}
+		{
+			json::var document = json::parser( "{\"config\":{\"a\":{\"b\":{\"c\":{\"d\":{\"e\":[1,[2,[3]]]}}}}},\"empty\":[],\"none\":{},\"x\":1}" );
+			for ( int i = 0; i < 40; ++i )
+			{
+				document[ "users" ][ i ][ "name" ] = "user";
+				document[ "users" ][ i ][ "tags" ][ 0 ] = i;
+				document[ "packed" ].push_integer( i );
+			}
+			document[ "records" ] = json::parser( "[{\"k\":1,\"v\":\"a\"},{\"k\":2,\"v\":\"b\"},{\"k\":3,\"v\":\"c\"},{\"k\":4,\"v\":\"d\"},{\"k\":5,\"v\":\"e\"},{\"k\":6,\"v\":\"f\"},{\"k\":7,\"v\":\"g\"}]" );
+			document[ "records" ].to_columns();
+			document[ "raw" ] = json::var::raw_fragment( "[ 1, {} ]" );
+			document[ "blob" ] = json::var::raw_bytes( "\x01\x02\x03", 3 );
+
+			const unsigned int markups[] = { json::Compact, json::HumanReadable, json::HumanReadable | json::CountArrayValues, json::HumanReadable | json::IndentFirstItem, json::Cached };
+			for ( size_t m = 0; m < sizeof( markups ) / sizeof( markups[ 0 ] ); ++m )
+			{
+				for ( unsigned int threads = 1; threads <= 4; ++threads )
+				{
+					const json::parallel_writer writer( threads, 1 );
+					Assert( writer.serialize( document, markups[ m ] ) == document.serialize( markups[ m ] ), __LINE__ );
+					Assert( writer.serialize( document, markups[ m ], 2 ) == document.serialize( markups[ m ], 2 ), __LINE__ );
+					Assert( writer.serialize( document[ "users" ], markups[ m ] ) == document[ "users" ].serialize( markups[ m ] ), __LINE__ );
+				}
+			}
+
+			std::string pieces;
+			json::string_sink< std::string > sink( pieces );
+			document[ "packed" ].write_elements( sink, 0, 7, json::HumanReadable, 1 );
+			document[ "packed" ].write_elements( sink, 7, 100, json::HumanReadable, 1 );
+			Assert( "[" + pieces + "\n\t]" == document[ "packed" ].serialize( json::HumanReadable, 1 ), __LINE__ );
+			Assert( json::parallel_writer( 4 ).serialize( document ) == document.serialize() && json::parallel_writer( 4, 1 ).serialize( json::var( "a" ) ) == "\"a\"", __LINE__ );
+
+			json::var records( json::Array );
+			for ( int i = 0; i < 2000; ++i )
+			{
+				json::var record;
+				record[ "id" ] = i;
+				record[ "score" ] = i + 0.5;
+				record[ "name" ] = std::string( i % 2 ? "odd" : "even" );
+				records.push( record );
+			}
+			json::var wrapped;
+			wrapped[ "records" ] = records;
+			const std::string text = wrapped.serialize();
+			const json::var threaded = json::parser( text, json::parse_options::columns() ), sequential = json::parser( text, json::parse_options::columns() );
+			Assert( threaded[ "records" ].columnar() && json::parallel_writer( 4, 1 ).serialize( threaded ) == sequential.serialize() && sequential.serialize() == text, __LINE__ );
+		}
+		{
+			const char *inputs[] =
+			{
+				"{\"users\":[{\"name\":\"a\\\"b\",\"id\":12345,\"x\":-1.5e3},{'q':'it\"s',v:s1 s2 , w : 7}],\"u\":\"\\ud83d\\ude00\",\"e\":[],\"t\":[true,false,null]}",
+				"[ 1 , 22 ,333 ]",
+				"\"text\"",
+				"12345",
+				"{'X':'s",
+				"[a\\,b,{}]"
+			};
+			const size_t chunks[] = { 1, 2, 3, 7, 1000 };
+
+			for ( size_t i = 0; i < sizeof( inputs ) / sizeof( inputs[ 0 ] ); ++i )
+			{
+				const std::string text( inputs[ i ] );
+
+				for ( size_t c = 0; c < sizeof( chunks ) / sizeof( chunks[ 0 ] ); ++c )
+				{
+					json::async_parser parser;
+					size_t position = 0, rounds = 0;
+
+					for ( json::async_parser::State state; ( state = parser.resume( 2 ) ) != json::async_parser::Complete && rounds < 10000; ++rounds )
+					{
+						if ( state != json::async_parser::NeedInput ) continue;
+
+						const size_t count = std::min( chunks[ c ], text.size() - position );
+						if ( !count ) parser.finish();
+						else parser.feed( text.data() + position, count );
+						position += count;
+					}
+
+					Assert( parser.result() == json::parser( text ) && parser.state() == json::async_parser::Complete, __LINE__ );
+				}
+			}
+
+			json::async_parser lines;
+			lines.feed( std::string( "{\"a\":1}\n{\"a\":" ) );
+			Assert( lines.resume() == json::async_parser::Complete && lines.result()[ "a" ] == 1, __LINE__ );
+			lines.restart();
+			Assert( lines.resume() == json::async_parser::NeedInput, __LINE__ );
+			lines.feed( std::string( "2}\n" ) );
+			Assert( lines.resume() == json::async_parser::Complete && lines.result()[ "a" ] == 2, __LINE__ );
+
+			std::string large( "[" );
+			for ( int i = 0; i < 100; ++i ) large += i ? ",\"value\"" : "\"value\"";
+			large += "]";
+
+			json::async_parser budgeted;
+			budgeted.feed( large );
+			budgeted.finish();
+			size_t suspended = 0;
+			while ( budgeted.resume( 10 ) == json::async_parser::Suspended ) ++suspended;
+			Assert( suspended == 10 && budgeted.result().size() == 100, __LINE__ );
+		}
+#if defined( JSONPP_HAVE_ZLIB ) && !defined( _MSC_VER )
+		{
+			json::var document;
+			for ( int i = 0; i < 20000; ++i ) document[ "rows" ][ i ] = json::parser( "{\"id\":1,\"name\":\"row\",\"values\":[1.5,true,null]}" );
+
+			std::FILE *file = std::tmpfile();
+			const int descriptor = fileno( file );
+			{
+				json::compressing_sink< json::gzip_encoder > sink( descriptor, 1, 2 );
+				document.write( sink, json::HumanReadable );
+				sink.close();
+			}
+			const off_t size = ::lseek( descriptor, 0, SEEK_CUR );
+			Assert( size > 0 && static_cast< size_t >( size ) < document.serialize( json::HumanReadable ).size() / 10, __LINE__ );
+
+			::lseek( descriptor, 0, SEEK_SET );
+			{
+				json::decompressing_source< json::gzip_decoder > source( descriptor, 2 );
+				Assert( json::basic_parser< json::CopyOnWrite, char >().parse( source.begin(), source.end(), json::parse_options::standard ) == document, __LINE__ );
+			}
+
+			Assert( ::ftruncate( descriptor, size / 2 ) == 0, __LINE__ );
+			::lseek( descriptor, 0, SEEK_SET );
+			try
+			{
+				json::decompressing_source< json::gzip_decoder > source( descriptor );
+				json::basic_parser< json::CopyOnWrite, char >().parse( source.begin(), source.end(), json::parse_options::standard );
+				Assert( false, __LINE__ );
+			}
+			catch ( const json::exception& )
+			{
+			}
+
+			/* gzip members in a row read as one stream */
+			Assert( ::ftruncate( descriptor, 0 ) == 0, __LINE__ );
+			::lseek( descriptor, 0, SEEK_SET );
+			{
+				json::compressing_sink< json::gzip_encoder > first( descriptor );
+				first.append( "[1,", 3 );
+			}
+			{
+				json::compressing_sink< json::gzip_encoder > second( descriptor );
+				second.append( "2]", 2 );
+			}
+			::lseek( descriptor, 0, SEEK_SET );
+			{
+				json::decompressing_source< json::gzip_decoder > source( descriptor );
+				Assert( json::basic_parser< json::CopyOnWrite, char >().parse( source.begin(), source.end(), json::parse_options::standard ).serialize() == "[1,2]", __LINE__ );
+			}
+
+			std::fclose( file );
+		}
+#endif
+		std::ostringstream exported;
+		{
+			json::stream_sink< char > sink( exported );
+			json::basic_writer< char, json::stream_sink< char > > writer( sink );
+			writer.begin_array();
+			for ( int i = 0; i < 100000; ++i ) writer.value( i );
+			writer.end_array();
+		}
+		Assert( exported.str().size() == 588891 && json::parser( exported.str() ).size() == 100000, __LINE__ );
+		try
+		{
+			std::string out;
+			json::string_sink< std::string > sink( out );
+			json::basic_writer< char, json::string_sink< std::string > > writer( sink );
+			writer.begin_object().value( 1 );
+			Assert( false, __LINE__ );
+		}
+		catch ( const json::exception& )
+		{
+		}
 	}
 	catch( const json::exception &e )
 	{
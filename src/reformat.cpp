@@ -0,0 +1,202 @@
+#include <json++>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ * reformat [--pretty|--minify] [--count] [--to-array|--to-ndjson] [file]
+ *
+ * rewrites JSON from file, or stdin, to stdout token by token without
+ * building a tree. --to-array turns newline delimited documents into one
+ * top level array, --to-ndjson writes every element of a top level array
+ * on a line of its own.
+ */
+namespace
+{
+	enum Layout
+	{
+		Same,
+		ToArray,
+		ToLines
+	};
+
+	typedef json::basic_reader< char, const char* > reader_type;
+
+	typedef json::basic_writer< char, json::descriptor_sink > writer_type;
+
+	/* the whole input, mapped when it is a regular file and read in blocks otherwise */
+	class input
+	{
+		public:
+
+			explicit input( const char *path ) :
+				_data(),
+				_mapped( 0 ),
+				_size( 0 )
+			{
+#ifndef _MSC_VER
+				const int descriptor = path ? ::open( path, O_RDONLY ) : 0;
+				if ( descriptor < 0 ) throw json::exception( "can't open" ) << path;
+
+				struct stat status;
+				if ( path && ::fstat( descriptor, &status ) == 0 && S_ISREG( status.st_mode ) && status.st_size > 0 )
+				{
+					void *mapped = ::mmap( 0, static_cast< size_t >( status.st_size ), PROT_READ, MAP_PRIVATE, descriptor, 0 );
+					if ( mapped != MAP_FAILED )
+					{
+						::madvise( mapped, static_cast< size_t >( status.st_size ), MADV_SEQUENTIAL );
+						_mapped = static_cast< const char* >( mapped );
+						_size = static_cast< size_t >( status.st_size );
+						::close( descriptor );
+						return;
+					}
+				}
+
+				char block[ 1 << 16 ];
+				for ( ssize_t count; ( count = ::read( descriptor, block, sizeof( block ) ) ) != 0; )
+				{
+					if ( count < 0 ) throw json::exception( "read failed" );
+					_data.insert( _data.end(), block, block + count );
+				}
+
+				if ( path ) ::close( descriptor );
+#else
+				std::FILE *file = path ? std::fopen( path, "rb" ) : stdin;
+				if ( !file ) throw json::exception( "can't open" ) << path;
+
+				char block[ 1 << 16 ];
+				for ( size_t count; ( count = std::fread( block, 1, sizeof( block ), file ) ) != 0; )
+				{
+					_data.insert( _data.end(), block, block + count );
+				}
+
+				if ( path ) std::fclose( file );
+#endif
+				_size = _data.size();
+			}
+
+			~input()
+			{
+#ifndef _MSC_VER
+				if ( _mapped ) ::munmap( const_cast< char* >( _mapped ), _size );
+#endif
+			}
+
+			const char* begin() const { return _mapped ? _mapped : ( _data.empty() ? 0 : &_data[ 0 ] ); }
+
+			const char* end() const { return begin() + _size; }
+
+		private:
+
+			input( const input& );
+			input& operator = ( const input& );
+
+			std::vector< char > _data;
+			const char *_mapped;
+			size_t _size;
+	};
+
+	bool blank( const char *start, const char *end )
+	{
+		for ( ; start != end; ++start )
+		{
+			if ( *start != ' ' && *start != '\t' && *start != '\r' && *start != '\n' ) return false;
+		}
+		return true;
+	}
+
+	/* every top level document in the input, one after the other */
+	void documents( const input &source, writer_type &writer )
+	{
+		for ( const char *position = source.begin(); !blank( position, source.end() ); )
+		{
+			reader_type reader( position, source.end() );
+			reader.next();
+			json::transcode( reader, writer );
+			position = reader.position();
+		}
+	}
+
+	void lines( const input &source, json::descriptor_sink &sink )
+	{
+		reader_type reader( source.begin(), source.end() );
+
+		if ( reader.next() != json::tokens::BeginArray ) throw json::exception( "--to-ndjson needs a top level array" );
+
+		while ( reader.next() != json::tokens::EndArray )
+		{
+			if ( reader.token() == json::tokens::End ) throw json::exception( "input ended inside the top level array" );
+
+			writer_type writer( sink );
+			json::transcode( reader, writer );
+			sink.push_back( '\n' );
+		}
+	}
+}
+
+int main( int argc, char *argv[] )
+{
+	unsigned int markup = json::Compact;
+	Layout layout = Same;
+	const char *path = 0;
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( !std::strcmp( argv[ i ], "--pretty" ) ) markup = ( markup & json::CountArrayValues ) | json::HumanReadable;
+		else if ( !std::strcmp( argv[ i ], "--minify" ) ) markup = json::Compact;
+		else if ( !std::strcmp( argv[ i ], "--count" ) ) markup |= json::CountArrayValues;
+		else if ( !std::strcmp( argv[ i ], "--to-array" ) ) layout = ToArray;
+		else if ( !std::strcmp( argv[ i ], "--to-ndjson" ) ) layout = ToLines;
+		else if ( argv[ i ][ 0 ] != '-' && !path ) path = argv[ i ];
+		else
+		{
+			std::cerr << "usage: " << argv[ 0 ] << " [--pretty|--minify] [--count] [--to-array|--to-ndjson] [file]" << std::endl;
+			return 2;
+		}
+	}
+
+	try
+	{
+		const input source( path );
+		json::descriptor_sink sink( 1 );
+
+		switch ( layout )
+		{
+			case Same:
+			{
+				writer_type writer( sink, markup );
+				reader_type reader( source.begin(), source.end() );
+				if ( reader.next() != json::tokens::End ) json::transcode( reader, writer );
+				sink.push_back( '\n' );
+				break;
+			}
+			case ToArray:
+			{
+				writer_type writer( sink, markup );
+				writer.begin_array();
+				documents( source, writer );
+				writer.end_array();
+				sink.push_back( '\n' );
+				break;
+			}
+			case ToLines:
+				lines( source, sink );
+				break;
+		}
+
+		sink.flush();
+	}
+	catch ( const json::exception &e )
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}